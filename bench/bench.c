@@ -0,0 +1,859 @@
+/**
+ * @file bench.c
+ * @author Tobias Heukäufer
+ * @brief Tobylog benchmarks.
+ * 
+ * Prints one JSON object per benchmark and line:
+ * - name: benchmark name
+ * - iterations: number of timed operations
+ * - ns_per_op: nanoseconds per operation
+ * - bytes_per_op: input bytes processed per operation
+ * - output_bytes_per_frame: bytes sent to the (headless) terminal per frame, only for benchmarks drawing frames
+ * 
+ * Usage: tobylog_bench [--filter=SUBSTRING] [--max-bytes=N]
+ * 
+ * Exits with failure if a benchmarked widget ends up with the wrong content.
+ */
+
+#include "../include/tobylog.h"
+#include "../include/label.h"
+#include "../include/list.h"
+#include "../include/text.h"
+#include "../include/textarea.h"
+#include "../include/tail.h"
+#include "../include/headless.h"
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include <apr_general.h>
+
+#include "../src/utf8.h"
+
+/** @brief Minimum time to run a benchmark for in nanoseconds. */
+#define MIN_BENCH_NS 200000000ull
+
+/** @brief Headless screen width. */
+#define SCREEN_WIDTH 80
+/** @brief Headless screen height. */
+#define SCREEN_HEIGHT 24
+
+/** @brief A benchmark operation, returns the number of input bytes it processed. */
+typedef size_t (*Bench_Op) (void* baton);
+
+/** @brief Only run benchmarks whose name contains this, or all if NULL. */
+static const char* filter = NULL;
+/** @brief Largest text to benchmark with. */
+static size_t maxBytes = 100 * 1024 * 1024;
+
+/** @brief Headless backend. */
+static TLog_Headless* headless = NULL;
+
+/** @brief Exit status, failure once a check fails. */
+static int status = EXIT_SUCCESS;
+
+/** @brief State of the pseudo random generator. */
+static uint64_t randomState = 0x9e3779b97f4a7c15ull;
+
+/** @brief Returns a pseudo random number (xorshift64). */
+static uint64_t nextRandom(void) {
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 7;
+    randomState ^= randomState << 17;
+    return randomState;
+}
+
+/** @brief Returns monotonic time in nanoseconds. */
+static uint64_t now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+/**
+ * @brief Runs a benchmark and prints its result.
+ * 
+ * Repeats the operation until it ran for at least @ref MIN_BENCH_NS.
+ * 
+ * @param name Benchmark name
+ * @param op The operation
+ * @param baton Operation's argument
+ */
+static void bench(const char* name, Bench_Op op, void* baton) {
+    if (filter && !strstr(name, filter)) {
+        return;
+    }
+
+    size_t startFrames, startOutput;
+    TLog_GetOutputStats(&startFrames, NULL, &startOutput);
+
+    uint64_t iterations = 0;
+    uint64_t bytes = 0;
+    uint64_t start = now();
+    uint64_t elapsed;
+    do {
+        bytes += op(baton);
+        ++iterations;
+        elapsed = now() - start;
+    } while (elapsed < MIN_BENCH_NS);
+
+    size_t frames, output;
+    TLog_GetOutputStats(&frames, NULL, &output);
+
+    printf("{\"name\": \"%s\", \"iterations\": %llu, \"ns_per_op\": %.1f, \"bytes_per_op\": %.1f",
+            name, (unsigned long long) iterations, (double) elapsed / iterations, (double) bytes / iterations);
+    if (frames > startFrames) {
+        printf(", \"output_bytes_per_frame\": %.1f", (double) (output - startOutput) / (frames - startFrames));
+    }
+    printf("}\n");
+    fflush(stdout);
+}
+
+/************** Corpora **************/
+
+/** @brief Corpus kinds. */
+typedef enum bench_corpus {
+    BENCH_CORPUS_ASCII,
+    BENCH_CORPUS_CJK,
+    BENCH_CORPUS_MIXED
+} Bench_Corpus;
+
+/** @brief Corpus names. */
+static const char* CORPUS_NAMES[] = { "ascii", "cjk", "mixed" };
+
+/**
+ * @brief Generates text of words and lines.
+ * 
+ * @param pool Memory pool
+ * @param corpus Kind of characters
+ * @param len Length in bytes
+ * @return NUL-terminated text
+ */
+static char* makeText(apr_pool_t* pool, Bench_Corpus corpus, size_t len) {
+    static const char* MIXED[] = { "e", "\xc3\xa9", "\xe6\x97\xa5", "\xf0\x9f\x98\x80" };
+
+    char* text = apr_palloc(pool, len + 1);
+    size_t i = 0;
+    size_t lineLen = 0;
+    while (i < len) {
+        const char* ch;
+        char ascii[2] = { 0, 0 };
+        uint64_t r = nextRandom();
+
+        if (lineLen > 60 + r % 40) {
+            ch = "\n";
+            lineLen = 0;
+        } else if (r % 7 == 0) {
+            ch = " ";
+        } else if (corpus == BENCH_CORPUS_ASCII || (corpus == BENCH_CORPUS_MIXED && r % 3 != 0)) {
+            ascii[0] = 'a' + (r >> 8) % 26;
+            ch = ascii;
+        } else if (corpus == BENCH_CORPUS_CJK) {
+            ch = MIXED[2];
+        } else {
+            ch = MIXED[(r >> 8) % 4];
+        }
+
+        size_t chLen = strlen(ch);
+        if (i + chLen > len) {
+            ch = " ";
+            chLen = 1;
+        }
+        memcpy(&text[i], ch, chLen);
+        i += chLen;
+        ++lineLen;
+    }
+    text[len] = 0;
+    return text;
+}
+
+/************** UTF-8 **************/
+
+/** @brief A text to scan. */
+typedef struct bench_text {
+    const char* text;
+    size_t len;
+} Bench_Text;
+
+static size_t opNextChar(void* baton) {
+    Bench_Text* text = baton;
+    size_t count = 0;
+    for (char* ch = (char*) text->text; *ch != 0; ch = TLog_UTF8_NextChar(ch)) {
+        ++count;
+    }
+    return text->len + (count & 0);
+}
+
+static size_t opCount(void* baton) {
+    Bench_Text* text = baton;
+    volatile size_t count = TLog_UTF8_Count(text->text, text->text + text->len);
+    (void) count;
+    return text->len;
+}
+
+static size_t opNewlines(void* baton) {
+    Bench_Text* text = baton;
+    const char* end = text->text + text->len;
+    volatile size_t total = 0;
+    for (const char* ch = text->text; ch < end; ++ch) {
+        size_t count;
+        ch = TLog_UTF8_FindNewline(ch, end, &count);
+        total += count;
+    }
+    return text->len;
+}
+
+static size_t opSeek(void* baton) {
+    Bench_Text* text = baton;
+    volatile const char* ch = TLog_UTF8_Seek(text->text, text->text + text->len, SIZE_MAX);
+    (void) ch;
+    return text->len;
+}
+
+static size_t opValidate(void* baton) {
+    Bench_Text* text = baton;
+    volatile bool valid = TLog_UTF8_Validate(text->text, text->text + text->len);
+    (void) valid;
+    return text->len;
+}
+
+static size_t opWidth(void* baton) {
+    Bench_Text* text = baton;
+    volatile size_t width = TLog_UTF8_Width(text->text, text->text + text->len);
+    (void) width;
+    return text->len;
+}
+
+static void benchUTF8(apr_pool_t* pool) {
+    size_t len = 1024 * 1024 < maxBytes ? 1024 * 1024 : maxBytes;
+    char name[128];
+
+    for (int corpus = BENCH_CORPUS_ASCII; corpus <= BENCH_CORPUS_MIXED; ++corpus) {
+        Bench_Text text = { makeText(pool, corpus, len), len };
+
+        snprintf(name, sizeof(name), "utf8/nextchar/%s/%zu", CORPUS_NAMES[corpus], len);
+        bench(name, opNextChar, &text);
+        snprintf(name, sizeof(name), "utf8/count/%s/%zu", CORPUS_NAMES[corpus], len);
+        bench(name, opCount, &text);
+        snprintf(name, sizeof(name), "utf8/newlines/%s/%zu", CORPUS_NAMES[corpus], len);
+        bench(name, opNewlines, &text);
+        snprintf(name, sizeof(name), "utf8/seek/%s/%zu", CORPUS_NAMES[corpus], len);
+        bench(name, opSeek, &text);
+        snprintf(name, sizeof(name), "utf8/validate/%s/%zu", CORPUS_NAMES[corpus], len);
+        bench(name, opValidate, &text);
+        snprintf(name, sizeof(name), "utf8/width/%s/%zu", CORPUS_NAMES[corpus], len);
+        bench(name, opWidth, &text);
+    }
+}
+
+/************** Label **************/
+
+/** @brief A label to lay out. */
+typedef struct bench_label {
+    TLog_Label* label;
+    char* text;
+    size_t len;
+    uint32_t width;
+} Bench_Label;
+
+static size_t opLabelCold(void* baton) {
+    Bench_Label* bl = baton;
+    TLog_Widget* widget = (TLog_Widget*) bl->label;
+
+    /* Setting the text drops the label's caches */
+    TLog_Label_SetText(bl->label, bl->text);
+    widget->data->getPreferedWidth(widget);
+    widget->data->setMaximumWidth(widget, bl->width, UINT32_MAX);
+
+    return bl->len;
+}
+
+static size_t opLabelCached(void* baton) {
+    Bench_Label* bl = baton;
+    TLog_Widget* widget = (TLog_Widget*) bl->label;
+
+    widget->data->getPreferedWidth(widget);
+    widget->data->setMaximumWidth(widget, bl->width, UINT32_MAX);
+
+    return bl->len;
+}
+
+static size_t opLabelRewrap(void* baton) {
+    Bench_Label* bl = baton;
+    TLog_Widget* widget = (TLog_Widget*) bl->label;
+
+    /* Cycle through more widths than a label keeps layouts for, like a terminal being resized */
+    bl->width = bl->width < 120 ? bl->width + 1 : 40;
+    widget->data->setMaximumWidth(widget, bl->width, UINT32_MAX);
+
+    return bl->len;
+}
+
+static void benchLabel(apr_pool_t* pool) {
+    static const uint32_t WIDTHS[] = { 20, 80, 200 };
+    char name[128];
+
+    for (size_t len = 1024; len <= maxBytes;) {
+        /* Each size gets its own pool, as labels copy their text */
+        apr_pool_t* sizePool;
+        apr_pool_create(&sizePool, pool);
+
+        Bench_Label bl;
+        bl.text = makeText(sizePool, BENCH_CORPUS_MIXED, len);
+        bl.len = len;
+        bl.label = TLog_Label_Create(sizePool, "");
+
+        for (size_t i = 0; i < sizeof(WIDTHS) / sizeof(WIDTHS[0]); ++i) {
+            bl.width = WIDTHS[i];
+            snprintf(name, sizeof(name), "label/layout-cold/%zu/w%u", len, bl.width);
+            bench(name, opLabelCold, &bl);
+            snprintf(name, sizeof(name), "label/layout-cached/%zu/w%u", len, bl.width);
+            bench(name, opLabelCached, &bl);
+        }
+
+        TLog_Label_SetWordWrap(bl.label, true);
+        for (size_t i = 0; i < sizeof(WIDTHS) / sizeof(WIDTHS[0]); ++i) {
+            bl.width = WIDTHS[i];
+            snprintf(name, sizeof(name), "label/wrap-cold/%zu/w%u", len, bl.width);
+            bench(name, opLabelCold, &bl);
+        }
+        snprintf(name, sizeof(name), "label/rewrap/%zu", len);
+        bench(name, opLabelRewrap, &bl);
+
+        apr_pool_destroy(sizePool);
+
+        if (len == maxBytes) {
+            break;
+        }
+        /* Make sure the largest size gets benchmarked, once */
+        len = len * 100 < maxBytes ? len * 100 : maxBytes;
+    }
+}
+
+/************** Text Field **************/
+
+/** @brief A text field to type into. */
+typedef struct bench_typing {
+    TLog_Text* text;
+    size_t chars;
+    char* paste;
+} Bench_Typing;
+
+static size_t opKeystroke(void* baton) {
+    Bench_Typing* bt = baton;
+    TLog_Widget* widget = (TLog_Widget*) bt->text;
+    uint32_t cursorX, cursorY, dirtyStart, dirtyEnd;
+
+    if (bt->chars == 100000) {
+        TLog_Text_SetText(bt->text, "");
+        bt->chars = 0;
+    }
+    widget->data->putChar(widget, 'a' + bt->chars % 26, &cursorX, &cursorY, &dirtyStart, &dirtyEnd);
+    ++bt->chars;
+
+    return 1;
+}
+
+static size_t opKeystrokeMiddle(void* baton) {
+    Bench_Typing* bt = baton;
+    TLog_Widget* widget = (TLog_Widget*) bt->text;
+    uint32_t cursorX, cursorY, dirtyStart, dirtyEnd;
+
+    /* Type and delete in the middle of a large text, moving the cursor each time */
+    widget->data->putAction(widget, TLOG_WIDGET_ACTION_LEFT, &cursorX, &cursorY, &dirtyStart, &dirtyEnd);
+    widget->data->putChar(widget, 'x', &cursorX, &cursorY, &dirtyStart, &dirtyEnd);
+    widget->data->putAction(widget, TLOG_WIDGET_ACTION_BACKSPACE, &cursorX, &cursorY, &dirtyStart, &dirtyEnd);
+
+    return 1;
+}
+
+static size_t opTypingRun(void* baton) {
+    Bench_Typing* bt = baton;
+    TLog_Widget* widgets[] = { (TLog_Widget*) bt->text, NULL };
+
+    TLog_Text_SetText(bt->text, "");
+    for (size_t i = 0; i < bt->chars; i += 64) {
+        TLog_Headless_PushChars(headless, "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789..");
+    }
+    TLog_Headless_PushChars(headless, "\n");
+    TLog_Run(widgets);
+
+    return bt->chars;
+}
+
+static size_t opPasteRun(void* baton) {
+    Bench_Typing* bt = baton;
+    TLog_Widget* widgets[] = { (TLog_Widget*) bt->text, NULL };
+
+    TLog_Text_SetText(bt->text, "");
+    TLog_Headless_PushPaste(headless, bt->paste);
+    TLog_Headless_PushChars(headless, "\n");
+    TLog_Run(widgets);
+
+    return bt->chars;
+}
+
+static void benchText(apr_pool_t* pool) {
+    Bench_Typing bt;
+
+    bt.text = TLog_Text_Create(pool, 1000000);
+    bt.chars = 0;
+    TLog_Widget* widget = (TLog_Widget*) bt.text;
+    widget->data->getPreferedWidth(widget);
+    widget->data->setMaximumWidth(widget, SCREEN_WIDTH - 1, SCREEN_HEIGHT);
+    bench("text/keystroke/append", opKeystroke, &bt);
+
+    char* large = makeText(pool, BENCH_CORPUS_ASCII, 100000);
+    for (char* ch = large; *ch; ++ch) {
+        *ch = *ch == '\n' ? ' ' : *ch;
+    }
+    TLog_Text_SetText(bt.text, large);
+    bench("text/keystroke/middle-100000", opKeystrokeMiddle, &bt);
+
+    bt.chars = 4096;
+    bench("text/run/keystrokes-4096", opTypingRun, &bt);
+
+    bt.paste = apr_palloc(pool, bt.chars + 1);
+    for (size_t i = 0; i < bt.chars; ++i) {
+        bt.paste[i] = 'a' + i % 26;
+    }
+    bt.paste[bt.chars] = 0;
+    bench("text/run/paste-4096", opPasteRun, &bt);
+}
+
+/************** Tail **************/
+
+static size_t opTailIngest(void* baton) {
+    TLog_Tail* tail = baton;
+    TLog_Widget* widget = (TLog_Widget*) tail;
+    uint64_t before = TLog_Tail_GetBytesRead(tail);
+
+    uint32_t dirtyStart, dirtyEnd;
+    widget->data->update(widget, &dirtyStart, &dirtyEnd);
+
+    return TLog_Tail_GetBytesRead(tail) - before;
+}
+
+static void benchTail(apr_pool_t* pool) {
+    if (filter && !strstr("tail/ingest", filter)) {
+        return;
+    }
+
+    int fds[2];
+    if (pipe(fds) < 0) {
+        return;
+    }
+
+    /* A producer writing lines as fast as it can */
+    pid_t producer = fork();
+    if (producer == 0) {
+        close(fds[0]);
+        size_t len = 64 * 1024;
+        char* block = makeText(pool, BENCH_CORPUS_ASCII, len);
+        while (write(fds[1], block, len) > 0);
+        _exit(0);
+    }
+    close(fds[1]);
+
+    TLog_Tail* tail = TLog_Tail_Create(pool, fds[0], SCREEN_HEIGHT / 2, 1024 * 1024);
+    if (producer > 0 && tail) {
+        bench("tail/ingest", opTailIngest, tail);
+    }
+
+    if (producer > 0) {
+        kill(producer, SIGTERM);
+        waitpid(producer, NULL, 0);
+    }
+    close(fds[0]);
+}
+
+/************** List **************/
+
+/** @brief A list's item texts, made up as they are drawn. */
+typedef struct bench_items {
+    char text[64];
+} Bench_Items;
+
+static const char* getBenchItem(uint64_t index, size_t* len, void* baton) {
+    Bench_Items* items = baton;
+    *len = snprintf(items->text, sizeof(items->text), "Item %llu", (unsigned long long) index);
+    return items->text;
+}
+
+static size_t opListScroll(void* baton) {
+    TLog_Widget** widgets = baton;
+
+    /* Step through the first items, then page and jump to the last one */
+    for (int i = 0; i < 50; ++i) {
+        TLog_Headless_PushAction(headless, TLOG_WIDGET_ACTION_DOWN);
+    }
+    for (int i = 0; i < 10; ++i) {
+        TLog_Headless_PushAction(headless, TLOG_WIDGET_ACTION_PAGE_DOWN);
+    }
+    TLog_Headless_PushAction(headless, TLOG_WIDGET_ACTION_END);
+    TLog_Headless_PushAction(headless, TLOG_WIDGET_ACTION_HOME);
+    TLog_Run(widgets);
+
+    return 0;
+}
+
+static size_t opListFilter(void* baton) {
+    TLog_Widget** widgets = baton;
+
+    /* Narrow down key by key, then widen again */
+    TLog_Headless_PushChars(headless, "i");
+    TLog_Headless_PushChars(headless, "t");
+    TLog_Headless_PushChars(headless, "e");
+    TLog_Headless_PushChars(headless, "m");
+    TLog_Headless_PushChars(headless, " ");
+    TLog_Headless_PushChars(headless, "9");
+    for (int i = 0; i < 6; ++i) {
+        TLog_Headless_PushAction(headless, TLOG_WIDGET_ACTION_BACKSPACE);
+    }
+    TLog_Run(widgets);
+
+    return 0;
+}
+
+static void benchList(apr_pool_t* pool) {
+    char name[128];
+    Bench_Items items;
+
+    /* Scrolling should take as long for any number of items */
+    for (uint64_t count = 100; count <= 10000000; count *= 10) {
+        TLog_List* list = TLog_List_Create(pool, getBenchItem, &items, count, SCREEN_HEIGHT / 2, 0);
+        TLog_Widget* widgets[] = { (TLog_Widget*) list, NULL };
+
+        snprintf(name, sizeof(name), "list/scroll/%llu", (unsigned long long) count);
+        bench(name, opListScroll, widgets);
+    }
+
+    /* Typing into a filtering list matches a bounded part of the items per key */
+    for (uint64_t count = 10000; count <= 1000000; count *= 100) {
+        TLog_List* list = TLog_List_Create(pool, getBenchItem, &items, count, SCREEN_HEIGHT / 2, 0);
+        TLog_Widget* widgets[] = { (TLog_Widget*) list, NULL };
+        if (!TLog_List_SetFilter(list, TLOG_LIST_MATCH_SUBSTRING)) {
+            continue;
+        }
+
+        snprintf(name, sizeof(name), "list/filter/%llu", (unsigned long long) count);
+        bench(name, opListFilter, widgets);
+    }
+}
+
+/************** Text Area **************/
+
+static size_t opTextAreaEdit(void* baton) {
+    TLog_Widget** widgets = baton;
+    TLog_TextArea* area = (TLog_TextArea*) widgets[0];
+
+    /* Jump to the middle, type a line and take it back, then move on */
+    TLog_TextArea_GoToLine(area, TLog_TextArea_GetLineCount(area) / 2);
+    TLog_Headless_PushChars(headless, "the quick brown fox");
+    TLog_Headless_PushAction(headless, TLOG_WIDGET_ACTION_RETURN);
+    for (int i = 0; i < 20; ++i) {
+        TLog_Headless_PushAction(headless, TLOG_WIDGET_ACTION_BACKSPACE);
+    }
+    for (int i = 0; i < 10; ++i) {
+        TLog_Headless_PushAction(headless, TLOG_WIDGET_ACTION_DOWN);
+    }
+    TLog_Headless_PushAction(headless, TLOG_WIDGET_ACTION_PAGE_DOWN);
+    TLog_Run(widgets);
+
+    return 20;
+}
+
+/** @brief A text area to paste into. */
+typedef struct bench_paste {
+    TLog_TextArea* area;
+    const char* text;
+    size_t len;
+} Bench_Paste;
+
+static size_t opTextAreaPaste(void* baton) {
+    Bench_Paste* bp = baton;
+    TLog_Widget* widgets[] = { (TLog_Widget*) bp->area, NULL };
+
+    TLog_TextArea_SetText(bp->area, "", 0);
+    TLog_Headless_PushPaste(headless, bp->text);
+    TLog_Run(widgets);
+
+    return bp->len;
+}
+
+static void benchTextArea(apr_pool_t* pool) {
+    char name[128];
+
+    /* Pasting a config must keep its line breaks and tabs */
+    for (uint64_t count = 1000; count <= 10000 && count * 32 <= maxBytes; count *= 10) {
+        apr_pool_t* areaPool;
+        apr_pool_create(&areaPool, pool);
+
+        char* text = apr_palloc(areaPool, count * 32);
+        size_t len = 0;
+        for (uint64_t i = 0; i < count; ++i) {
+            len += snprintf(text + len, 32, "key%llu =\tvalue %llu\n", (unsigned long long) i, (unsigned long long) i);
+        }
+
+        Bench_Paste bp;
+        bp.area = TLog_TextArea_Create(areaPool, SCREEN_HEIGHT / 2, 0);
+        bp.text = text;
+        bp.len = len;
+
+        snprintf(name, sizeof(name), "textarea/paste/%llu", (unsigned long long) count);
+        if (bp.area) {
+            opTextAreaPaste(&bp);
+            char* pasted = TLog_TextArea_GetText(bp.area, areaPool);
+            if (!pasted || strcmp(pasted, text) != 0 || TLog_TextArea_GetLineCount(bp.area) != count + 1) {
+                fprintf(stderr, "%s: the text area's text differs from the pasted text\n", name);
+                status = EXIT_FAILURE;
+            }
+            bench(name, opTextAreaPaste, &bp);
+        }
+
+        apr_pool_destroy(areaPool);
+    }
+
+    /* Editing should take as long for any number of lines */
+    for (uint64_t count = 1000; count <= 1000000 && count * 16 <= maxBytes; count *= 10) {
+        apr_pool_t* areaPool;
+        apr_pool_create(&areaPool, pool);
+
+        char* text = apr_palloc(areaPool, count * 16);
+        size_t len = 0;
+        for (uint64_t i = 0; i < count; ++i) {
+            len += snprintf(text + len, 16, "line %llu\n", (unsigned long long) i);
+        }
+
+        TLog_TextArea* area = TLog_TextArea_Create(areaPool, SCREEN_HEIGHT / 2, 0);
+        if (area && TLog_TextArea_SetText(area, text, len)) {
+            TLog_Widget* widgets[] = { (TLog_Widget*) area, NULL };
+
+            snprintf(name, sizeof(name), "textarea/edit/%llu", (unsigned long long) count);
+            bench(name, opTextAreaEdit, widgets);
+        }
+
+        apr_pool_destroy(areaPool);
+    }
+}
+
+/************** Frames **************/
+
+/** @brief A form to draw. */
+typedef struct bench_form {
+    TLog_Widget** widgets;
+    size_t count;
+} Bench_Form;
+
+static size_t opInitialDraw(void* baton) {
+    Bench_Form* form = baton;
+
+    /* The run ends at the end of input after the initial draw */
+    TLog_Run(form->widgets);
+
+    return 0;
+}
+
+static size_t opScroll(void* baton) {
+    Bench_Form* form = baton;
+
+    /* Move down through the whole form, scrolling it by */
+    for (size_t i = 0; i < form->count; ++i) {
+        TLog_Headless_PushAction(headless, TLOG_WIDGET_ACTION_DOWN);
+    }
+    TLog_Run(form->widgets);
+
+    return 0;
+}
+
+static size_t opResize(void* baton) {
+    Bench_Form* form = baton;
+
+    /* Drag the window narrower and back, Tab draws a frame after each resize */
+    for (uint32_t width = SCREEN_WIDTH - 8; width <= SCREEN_WIDTH; ++width) {
+        TLog_Headless_PushResize(headless, width, SCREEN_HEIGHT);
+        TLog_Headless_PushAction(headless, TLOG_WIDGET_ACTION_TAB);
+    }
+    TLog_Run(form->widgets);
+
+    return 0;
+}
+
+/** @brief Large labels to lay out before a first frame. */
+typedef struct bench_first_frame {
+    apr_pool_t* pool;
+    const char* text;
+    size_t len;
+    size_t count;
+} Bench_First_Frame;
+
+static size_t opFirstFrame(void* baton) {
+    Bench_First_Frame* ff = baton;
+
+    /* New labels have no layouts cached, the text is shared as it's only read */
+    apr_pool_t* formPool;
+    apr_pool_create(&formPool, ff->pool);
+    TLog_Widget** widgets = apr_palloc(formPool, sizeof(TLog_Widget*) * (ff->count + 1));
+    for (size_t i = 0; i < ff->count; ++i) {
+        widgets[i] = (TLog_Widget*) TLog_Label_CreateStatic(formPool, ff->text, ff->len);
+    }
+    widgets[ff->count] = NULL;
+
+    TLog_Run(widgets);
+    apr_pool_destroy(formPool);
+
+    return ff->len * ff->count;
+}
+
+/** @brief A large file's label above a text field, typed into at once. */
+typedef struct bench_first_key {
+    apr_pool_t* pool;
+    const char* path;
+    size_t len;
+    bool async;
+} Bench_First_Key;
+
+static size_t opFirstKey(void* baton) {
+    Bench_First_Key* fk = baton;
+
+    /* A new label has no layout cached, the run ends once the key is shown */
+    apr_pool_t* formPool;
+    apr_pool_create(&formPool, fk->pool);
+    TLog_Label* label = fk->async
+            ? TLog_Label_CreateFromFileAsync(formPool, fk->path)
+            : TLog_Label_CreateFromFile(formPool, fk->path);
+    TLog_Widget* widgets[] = {
+        (TLog_Widget*) label,
+        (TLog_Widget*) TLog_Text_Create(formPool, 40),
+        NULL
+    };
+
+    TLog_Headless_PushChars(headless, "x");
+    TLog_Run(widgets);
+    apr_pool_destroy(formPool);
+
+    return fk->len;
+}
+
+static void benchFrames(apr_pool_t* pool) {
+    char name[128];
+
+    for (size_t count = 10; count <= 100000; count *= 10) {
+        apr_pool_t* formPool;
+        apr_pool_create(&formPool, pool);
+
+        Bench_Form form;
+        form.widgets = apr_palloc(formPool, sizeof(TLog_Widget*) * (count + 1));
+        for (size_t i = 0; i < count; ++i) {
+            form.widgets[i] = i % 2 == 0
+                    ? (TLog_Widget*) TLog_Label_Create(formPool, "Some field's label:")
+                    : (TLog_Widget*) TLog_Text_Create(formPool, 40);
+        }
+        form.widgets[count] = NULL;
+        form.count = count;
+
+        snprintf(name, sizeof(name), "frame/initial-draw/%zu", count);
+        bench(name, opInitialDraw, &form);
+
+        if (count <= 1000) {
+            snprintf(name, sizeof(name), "frame/scroll/%zu", count);
+            bench(name, opScroll, &form);
+        }
+
+        apr_pool_destroy(formPool);
+    }
+
+    /* Large labels around a text field, laid out again at every resize */
+    size_t len = maxBytes < 10 * 1024 * 1024 ? maxBytes : 10 * 1024 * 1024;
+    apr_pool_t* formPool;
+    apr_pool_create(&formPool, pool);
+
+    Bench_Form form;
+    TLog_Widget* widgets[] = {
+        (TLog_Widget*) TLog_Label_CreateStatic(formPool, makeText(formPool, BENCH_CORPUS_MIXED, len), len),
+        (TLog_Widget*) TLog_Text_Create(formPool, 40),
+        (TLog_Widget*) TLog_Label_CreateStatic(formPool, makeText(formPool, BENCH_CORPUS_ASCII, len), len),
+        NULL
+    };
+    form.widgets = widgets;
+    form.count = 3;
+
+    snprintf(name, sizeof(name), "frame/resize/%zu", len);
+    bench(name, opResize, &form);
+
+    /* Many large labels before the first frame, laid out on one thread and on all processors */
+    Bench_First_Frame ff;
+    ff.pool = formPool;
+    ff.len = len / 4;
+    ff.text = makeText(formPool, BENCH_CORPUS_MIXED, ff.len);
+    ff.count = 24;
+    static const unsigned int THREADS[] = { 1, 0 };
+    for (size_t i = 0; i < sizeof(THREADS) / sizeof(THREADS[0]); ++i) {
+        TLog_SetLayoutThreads(THREADS[i]);
+        snprintf(name, sizeof(name), "frame/first-frame/%zux%zu/%s", ff.count, ff.len, THREADS[i] ? "t1" : "tall");
+        bench(name, opFirstFrame, &ff);
+    }
+    TLog_SetLayoutThreads(1);
+
+    /* Time to the first key typed shown, waiting for a large file's label or not */
+    char path[] = "/tmp/tobylog_bench_XXXXXX";
+    int fd = mkstemp(path);
+    if (fd >= 0) {
+        Bench_First_Key fk;
+        fk.pool = formPool;
+        fk.path = path;
+        fk.len = write(fd, makeText(formPool, BENCH_CORPUS_MIXED, len), len) == (ssize_t) len ? len : 0;
+        close(fd);
+        for (int async = 0; async < 2 && fk.len > 0; ++async) {
+            fk.async = async;
+            snprintf(name, sizeof(name), "frame/first-key/%zu/%s", fk.len, async ? "async" : "sync");
+            bench(name, opFirstKey, &fk);
+        }
+        unlink(path);
+    }
+
+    apr_pool_destroy(formPool);
+}
+
+int main(int argc, const char *const *argv) {
+    apr_app_initialize(&argc, &argv, NULL);
+
+    for (int i = 1; i < argc; ++i) {
+        if (strncmp(argv[i], "--filter=", 9) == 0) {
+            filter = argv[i] + 9;
+        } else if (strncmp(argv[i], "--max-bytes=", 12) == 0) {
+            maxBytes = strtoull(argv[i] + 12, NULL, 10);
+        } else {
+            fprintf(stderr, "Usage: %s [--filter=SUBSTRING] [--max-bytes=N]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    apr_pool_t* pool;
+    apr_pool_create(&pool, NULL);
+
+    headless = TLog_Headless_Create(pool, SCREEN_WIDTH, SCREEN_HEIGHT);
+    if (!headless || TLog_InitWithBackend(pool, (TLog_Backend*) headless) != TLOG_RESULT_OK) {
+        fprintf(stderr, "Failed to initialize Tobylog\n");
+        return 1;
+    }
+
+    benchUTF8(pool);
+    benchLabel(pool);
+    benchText(pool);
+    benchTail(pool);
+    benchList(pool);
+    benchTextArea(pool);
+    benchFrames(pool);
+
+    apr_pool_destroy(pool);
+
+    apr_terminate();
+
+    return status;
+}
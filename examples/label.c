@@ -14,10 +14,17 @@ int main(int argc, const char *const *argv) {
 
     TLog_Init(pool);
 
+    /* Shows a file given as argument without copying it */
     TLog_Widget* widgets[] =  {
-        (TLog_Widget*) TLog_Label_Create(pool, "This is a label! This is such a very beautiful label!\nI agree!"),
+        argc > 1
+            ? (TLog_Widget*) TLog_Label_CreateFromFile(pool, argv[1])
+            : (TLog_Widget*) TLog_Label_Create(pool, "This is a label! This is such a very beautiful label!\nI agree!"),
         NULL
     };
+    if (!widgets[0]) {
+        apr_terminate();
+        return 1;
+    }
     TLog_Run(widgets);
 
     sleep(3);
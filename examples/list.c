@@ -0,0 +1,53 @@
+#include "../include/tobylog.h"
+#include "../include/label.h"
+#include "../include/list.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include <apr.h>
+
+typedef struct items {
+    char text[64];
+} Items;
+
+static const char* getItem(uint64_t index, size_t* len, void* baton) {
+    Items* items = baton;
+
+    /* Items are made up as they are drawn, so there can be any number of them */
+    *len = snprintf(items->text, sizeof(items->text), "Item %llu", (unsigned long long) index + 1);
+    return items->text;
+}
+
+int main(int argc, const char *const *argv) {
+    apr_app_initialize(&argc, &argv, NULL);
+
+    apr_pool_t* pool;
+    apr_pool_create(&pool, NULL);
+
+    uint64_t count = argc > 1 ? strtoull(argv[1], NULL, 10) : 10000000;
+
+    TLog_Init(pool);
+
+    Items items;
+    TLog_List* list = TLog_List_Create(pool, getItem, &items, count, 10, 30);
+
+    TLog_Widget* widgets[] = {
+        (TLog_Widget*) TLog_Label_Create(pool, "Pick an item (Return to finish, Esc to cancel):"),
+        (TLog_Widget*) list,
+        NULL
+    };
+
+    TLog_Result result = TLog_Run(widgets);
+    uint64_t selected = TLog_List_GetSelected(list);
+
+    if (result == TLOG_RESULT_OK) {
+        fprintf(stderr, "Picked item %llu\n", (unsigned long long) selected + 1);
+    } else {
+        fprintf(stderr, "Cancelled\n");
+    }
+
+    apr_terminate();
+
+    return 0;
+}
@@ -0,0 +1,61 @@
+#include "../include/tobylog.h"
+#include "../include/headless.h"
+#include "../include/label.h"
+#include "../include/text.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <sys/resource.h>
+
+#include <apr.h>
+
+#define RUNS 100000
+#define REPORT_INTERVAL 10000
+#define FIELDS 50
+
+/* Shows dialogs over and over, like a daemon would, printing the peak memory use as it goes */
+int main(int argc, const char *const *argv) {
+    apr_app_initialize(&argc, &argv, NULL);
+
+    apr_pool_t* pool;
+    apr_pool_create(&pool, NULL);
+
+    TLog_Headless* headless = TLog_Headless_Create(pool, 80, 24);
+    if (!headless || TLog_InitWithBackend(pool, (TLog_Backend*) headless) != TLOG_RESULT_OK) {
+        return 1;
+    }
+
+    TLog_Widget* widgets[2 * FIELDS + 1];
+    TLog_Label* labels[FIELDS];
+    for (int i = 0; i < FIELDS; ++i) {
+        labels[i] = TLog_Label_Create(pool, "");
+        widgets[2 * i] = (TLog_Widget*) labels[i];
+        widgets[2 * i + 1] = (TLog_Widget*) TLog_Text_Create(pool, 40);
+    }
+
+    char text[128];
+    for (int run = 1; run <= RUNS; ++run) {
+        /* Every dialog shows other texts and a different number of fields */
+        int fields = 1 + run % FIELDS;
+        for (int i = 0; i < fields; ++i) {
+            snprintf(text, sizeof(text), "Run %d, field %d:%s", run, i, run % 3 == 0 ? " (a longer caption)" : "");
+            TLog_Label_SetText(labels[i], text);
+        }
+        TLog_Widget* end = widgets[2 * fields];
+        widgets[2 * fields] = NULL;
+
+        TLog_Headless_PushChars(headless, "typed\n");
+        TLog_Run(widgets);
+        widgets[2 * fields] = end;
+
+        if (run % REPORT_INTERVAL == 0) {
+            struct rusage usage;
+            getrusage(RUSAGE_SELF, &usage);
+            printf("%d runs, peak memory %ld KiB\n", run, usage.ru_maxrss);
+        }
+    }
+
+    apr_terminate();
+
+    return 0;
+}
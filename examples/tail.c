@@ -0,0 +1,92 @@
+#include "../include/tobylog.h"
+#include "../include/label.h"
+#include "../include/tail.h"
+#include "../include/text.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include <apr.h>
+#include <apr_strings.h>
+
+typedef struct status {
+    TLog_Loop* loop;
+    TLog_Tail* tail;
+    TLog_Label* label;
+    TLog_Loop_Timer* timer;
+    unsigned seconds;
+    char text[64];
+} Status;
+
+static void showStatus(Status* status) {
+    bool finished = TLog_Tail_IsFinished(status->tail);
+    snprintf(status->text, sizeof(status->text), finished ? "Finished after %us" : "Running for %us",
+            status->seconds);
+    TLog_Label_SetText(status->label, status->text);
+    TLog_Invalidate((TLog_Widget*) status->label);
+}
+
+static void onSecond(TLog_Loop_Timer* timer, void* baton) {
+    Status* status = baton;
+    (void) timer;
+
+    ++status->seconds;
+    showStatus(status);
+}
+
+static void onOutput(int fd, void* baton) {
+    Status* status = baton;
+
+    /* The tail reads the output itself, an ended pipe would just keep waking the loop up */
+    if (TLog_Tail_IsFinished(status->tail)) {
+        TLog_Loop_RemoveFd(status->loop, fd);
+        TLog_Loop_CancelTimer(status->timer);
+        showStatus(status);
+    }
+}
+
+int main(int argc, const char *const *argv) {
+    apr_app_initialize(&argc, &argv, NULL);
+
+    apr_pool_t* pool;
+    apr_pool_create(&pool, NULL);
+
+    /* Error output would garble the screen, so it goes to the tail too */
+    const char* command = argc > 1 ? argv[1] : "ping -c 30 localhost";
+    FILE* output = popen(apr_pstrcat(pool, command, " 2>&1", NULL), "r");
+    if (!output) {
+        return 1;
+    }
+
+    TLog_Init(pool);
+
+    Status status;
+    status.loop = TLog_Loop_Create(pool);
+    status.tail = TLog_Tail_Create(pool, fileno(output), 10, 64 * 1024);
+    status.label = TLog_Label_Create(pool, "Running for 0s");
+    status.seconds = 0;
+
+    /* Sleep until there's output, a second passed or a key was pressed */
+    status.timer = TLog_Loop_AddTimer(status.loop, 1000, 1000, onSecond, &status);
+    TLog_Loop_AddFd(status.loop, fileno(output), onOutput, &status);
+
+    TLog_Widget* widgets[] = {
+        (TLog_Widget*) TLog_Label_Create(pool, apr_pstrcat(pool, "Output of ", command, ":", NULL)),
+        (TLog_Widget*) status.tail,
+        (TLog_Widget*) status.label,
+        (TLog_Widget*) TLog_Label_Create(pool, "Comment (Return to finish, Esc to cancel):"),
+        (TLog_Widget*) TLog_Text_Create(pool, 50),
+        NULL
+    };
+
+    TLog_Result result = TLog_RunLoop(widgets, status.loop);
+
+    char* comment = TLog_Text_GetText((TLog_Text*) widgets[4], pool);
+
+    pclose(output);
+    fprintf(stderr, result == TLOG_RESULT_OK ? "Finished: %s\n" : "Cancelled\n", comment);
+
+    apr_terminate();
+
+    return 0;
+}
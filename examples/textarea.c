@@ -0,0 +1,59 @@
+#include "../include/tobylog.h"
+#include "../include/label.h"
+#include "../include/textarea.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include <apr.h>
+#include <apr_file_io.h>
+
+int main(int argc, const char *const *argv) {
+    apr_app_initialize(&argc, &argv, NULL);
+
+    apr_pool_t* pool;
+    apr_pool_create(&pool, NULL);
+
+    TLog_Init(pool);
+
+    TLog_TextArea* area = TLog_TextArea_Create(pool, 10, 60);
+
+    /* Edit a file if one is given, or else some generated lines */
+    char* text = NULL;
+    apr_size_t len = 0;
+    apr_file_t* file;
+    if (argc > 1 && apr_file_open(&file, argv[1], APR_FOPEN_READ, APR_OS_DEFAULT, pool) == APR_SUCCESS) {
+        apr_finfo_t info;
+        if (apr_file_info_get(&info, APR_FINFO_SIZE, file) == APR_SUCCESS) {
+            len = info.size;
+            text = apr_palloc(pool, len + 1);
+            if (apr_file_read_full(file, text, len, &len) != APR_SUCCESS) {
+                len = 0;
+            }
+        }
+        apr_file_close(file);
+    } else {
+        text = apr_palloc(pool, 1000 * 16);
+        for (int i = 1; i <= 1000; ++i) {
+            len += sprintf(text + len, "Line %d\n", i);
+        }
+    }
+
+    if (!TLog_TextArea_SetText(area, text, len)) {
+        fprintf(stderr, "Can't edit malformed UTF-8\n");
+    }
+
+    TLog_Widget* widgets[] = {
+        (TLog_Widget*) TLog_Label_Create(pool, "Edit the text (Esc to finish):"),
+        (TLog_Widget*) area,
+        NULL
+    };
+
+    TLog_Run(widgets);
+
+    fprintf(stderr, "%llu lines\n", (unsigned long long) TLog_TextArea_GetLineCount(area));
+
+    apr_terminate();
+
+    return 0;
+}
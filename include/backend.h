@@ -0,0 +1,204 @@
+/**
+ * @file backend.h
+ * @author Tobias Heukäufer
+ * @brief Render backends.
+ * 
+ * A backend takes Tobylog's output and provides its input. By default Tobylog runs on ncurses,
+ * see @ref TLog_InitWithBackend() to run on another one (e.g. headless.h).
+ */
+
+#ifndef TLOG_INCLUDE_BACKEND_H
+#define TLOG_INCLUDE_BACKEND_H
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "draw.h"
+#include "widget.h"
+
+/** @brief Input kinds. */
+typedef enum tlog_input_type {
+    /** @brief A printable ASCII character */
+    TLOG_INPUT_CHAR,
+    /** @brief An action value */
+    TLOG_INPUT_ACTION,
+    /** @brief Something not of interest to Tobylog */
+    TLOG_INPUT_OTHER,
+    /** @brief The end of input, handled like Esc */
+    TLOG_INPUT_END,
+    /** @brief No input pending (only when not waiting for input, or not long enough) */
+    TLOG_INPUT_NONE,
+    /** @brief Start of pasted text, following characters are text even if they look like actions */
+    TLOG_INPUT_PASTE_START,
+    /** @brief End of pasted text */
+    TLOG_INPUT_PASTE_END,
+    /** @brief The screen was resized, the backend reports the new size from now on */
+    TLOG_INPUT_RESIZE
+} TLog_Input_Type;
+
+/** @brief An input. */
+typedef struct tlog_input {
+    /** @brief Kind of input. */
+    TLog_Input_Type type;
+    /** @brief Character if @ref TLog_Input_Type::TLOG_INPUT_CHAR. */
+    char ch;
+    /** @brief Action value if @ref TLog_Input_Type::TLOG_INPUT_ACTION. */
+    TLog_Widget_Action action;
+} TLog_Input;
+
+/** @brief General backend. */
+typedef struct tlog_backend TLog_Backend;
+
+/**
+ * @brief Starts a backend.
+ * 
+ * @param backend The backend
+ * @return TRUE on success, or FALSE else
+ */
+typedef bool (*TLog_Backend_Start) (TLog_Backend* backend);
+
+/**
+ * @brief Stops a backend.
+ * 
+ * @param backend The backend
+ */
+typedef void (*TLog_Backend_Stop) (TLog_Backend* backend);
+
+/**
+ * @brief Returns a backend's screen size.
+ * 
+ * @param backend The backend
+ * @param width Where to store the width
+ * @param height Where to store the height
+ */
+typedef void (*TLog_Backend_GetSize) (TLog_Backend* backend, uint32_t* width, uint32_t* height);
+
+/**
+ * @brief Moves a backend's cursor.
+ * 
+ * @param backend The backend
+ * @param y Row
+ * @param x Column
+ */
+typedef void (*TLog_Backend_Move) (TLog_Backend* backend, uint32_t y, uint32_t x);
+
+/**
+ * @brief Writes text at a backend's cursor and moves the cursor behind it.
+ * 
+ * @param backend The backend
+ * @param text UTF-8 text (not NUL-terminated)
+ * @param len Text's length in bytes
+ */
+typedef void (*TLog_Backend_AddText) (TLog_Backend* backend, const char* text, size_t len);
+
+/**
+ * @brief Sets the attribute for following text.
+ * 
+ * @param backend The backend
+ * @param attribute The attribute
+ */
+typedef void (*TLog_Backend_SetAttribute) (TLog_Backend* backend, TLog_Attribute attribute);
+
+/**
+ * @brief Clears from a backend's cursor to the end of its row.
+ * 
+ * @param backend The backend
+ */
+typedef void (*TLog_Backend_ClearToEol) (TLog_Backend* backend);
+
+/**
+ * @brief Clears a backend's screen.
+ * 
+ * @param backend The backend
+ */
+typedef void (*TLog_Backend_Clear) (TLog_Backend* backend);
+
+/**
+ * @brief Scrolls a backend's screen.
+ * 
+ * Rows scrolled in are blank.
+ * 
+ * @param backend The backend
+ * @param lines Number of rows to scroll up (positive) or down (negative)
+ */
+typedef void (*TLog_Backend_Scroll) (TLog_Backend* backend, int lines);
+
+/**
+ * @brief Makes everything written so far visible.
+ * 
+ * @param backend The backend
+ */
+typedef void (*TLog_Backend_Flush) (TLog_Backend* backend);
+
+/**
+ * @brief Returns the number of bytes a backend has sent to its terminal so far.
+ * 
+ * @param backend The backend
+ * @return Number of bytes sent
+ */
+typedef size_t (*TLog_Backend_GetBytesWritten) (TLog_Backend* backend);
+
+/**
+ * @brief Returns a backend's next input.
+ * 
+ * @param backend The backend
+ * @param timeout Milliseconds to wait for input at most, or -1 to wait until there is input;
+ *                @ref TLog_Input_Type::TLOG_INPUT_NONE is returned if none came in time (at once if 0)
+ * @param input Where to store the input
+ */
+typedef void (*TLog_Backend_GetInput) (TLog_Backend* backend, int timeout, TLog_Input* input);
+
+/**
+ * @brief Returns the file descriptor a backend reads input from, to wait for it along with others.
+ * 
+ * @param backend The backend
+ * @return The file descriptor, or -1 if there is none
+ */
+typedef int (*TLog_Backend_GetFd) (TLog_Backend* backend);
+
+/** @brief Common backend data. */
+typedef struct tlog_backend_data {
+    /** @brief @copybrief TLog_Backend_Start */
+    TLog_Backend_Start start;
+    /** @brief @copybrief TLog_Backend_Stop */
+    TLog_Backend_Stop stop;
+    /** @brief @copybrief TLog_Backend_GetSize */
+    TLog_Backend_GetSize getSize;
+    /** @brief @copybrief TLog_Backend_Move */
+    TLog_Backend_Move move;
+    /** @brief @copybrief TLog_Backend_AddText */
+    TLog_Backend_AddText addText;
+    /** @brief @copybrief TLog_Backend_SetAttribute */
+    TLog_Backend_SetAttribute setAttribute;
+    /** @brief @copybrief TLog_Backend_ClearToEol */
+    TLog_Backend_ClearToEol clearToEol;
+    /** @brief @copybrief TLog_Backend_Clear */
+    TLog_Backend_Clear clear;
+    /** @brief @copybrief TLog_Backend_Scroll */
+    TLog_Backend_Scroll scroll;
+    /** @brief @copybrief TLog_Backend_Flush */
+    TLog_Backend_Flush flush;
+    /**
+     * @brief @copybrief TLog_Backend_GetBytesWritten
+     * 
+     * Set NULL if unknown.
+     */
+    TLog_Backend_GetBytesWritten getBytesWritten;
+    /** @brief @copybrief TLog_Backend_GetInput */
+    TLog_Backend_GetInput getInput;
+    /**
+     * @brief @copybrief TLog_Backend_GetFd
+     * 
+     * Set NULL if input can't be waited for with poll(2).
+     */
+    TLog_Backend_GetFd getFd;
+} TLog_Backend_Data;
+
+/** @brief General backend. */
+struct tlog_backend {
+    /** @brief @copybrief TLog_Backend_Data */
+    const TLog_Backend_Data* data;
+};
+
+#endif
@@ -0,0 +1,47 @@
+/**
+ * @file draw.h
+ * @author Tobias Heukäufer
+ * @brief Drawing for widgets.
+ * 
+ * These functions draw to the backend Tobylog runs with and are meant to be called
+ * from @ref TLog_Widget_DrawLine only.
+ */
+
+#ifndef TLOG_INCLUDE_DRAW_H
+#define TLOG_INCLUDE_DRAW_H
+
+#include <stdlib.h>
+#include <stdint.h>
+
+/** @brief Display attributes. */
+typedef enum tlog_attribute {
+    /** @brief Normal text */
+    TLOG_ATTRIBUTE_NORMAL,
+    /** @brief Reversed foreground and background */
+    TLOG_ATTRIBUTE_REVERSE
+} TLog_Attribute;
+
+/**
+ * @brief Draws text at the cursor and moves the cursor behind it.
+ * 
+ * @param text UTF-8 text (doesn't need to be NUL-terminated)
+ * @param len Text's length in bytes
+ */
+void TLog_Draw_Text(const char* text, size_t len);
+
+/**
+ * @brief Draws an ASCII character repeatedly at the cursor and moves the cursor behind it.
+ * 
+ * @param ch The character
+ * @param count Number of times to draw the character
+ */
+void TLog_Draw_Fill(char ch, uint32_t count);
+
+/**
+ * @brief Sets the attribute for following drawing.
+ * 
+ * @param attribute The attribute
+ */
+void TLog_Draw_SetAttribute(TLog_Attribute attribute);
+
+#endif
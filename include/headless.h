@@ -0,0 +1,118 @@
+/**
+ * @file headless.h
+ * @author Tobias Heukäufer
+ * @brief A backend drawing to memory.
+ * 
+ * The headless backend holds its screen as a grid of cells and takes its input from a queue,
+ * so Tobylog can run without a terminal (e.g. in tests and profilers). The bytes it reports as written
+ * are those a VT100 compatible terminal would have been sent for the same calls.
+ */
+
+#ifndef TLOG_INCLUDE_HEADLESS_H
+#define TLOG_INCLUDE_HEADLESS_H
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <apr_pools.h>
+
+#include "backend.h"
+
+/** @brief A headless backend. */
+typedef struct tlog_headless TLog_Headless;
+
+/**
+ * @brief Creates a headless backend.
+ * 
+ * @param pool Memory pool
+ * @param width Screen width
+ * @param height Screen height
+ * @return A new headless backend, or NULL on error
+ */
+TLog_Headless* TLog_Headless_Create(apr_pool_t* pool, uint32_t width, uint32_t height);
+
+/**
+ * @brief Queues characters as input.
+ * 
+ * Printable ASCII characters are queued as characters, '\\n' as Return, '\\t' as Tab and '\\x1b' as Esc,
+ * everything else is ignored. Once the queue runs empty, the backend reports the end of input.
+ * 
+ * @param headless The headless backend
+ * @param chars NUL-terminated characters
+ * @return TRUE on success, or FALSE on error
+ */
+bool TLog_Headless_PushChars(TLog_Headless* headless, const char* chars);
+
+/**
+ * @brief Queues characters as pasted input.
+ * 
+ * Like @ref TLog_Headless_PushChars(), but the characters are enclosed in paste start and end,
+ * as a terminal in bracketed paste mode would send them.
+ * 
+ * @param headless The headless backend
+ * @param chars NUL-terminated characters
+ * @return TRUE on success, or FALSE on error
+ */
+bool TLog_Headless_PushPaste(TLog_Headless* headless, const char* chars);
+
+/**
+ * @brief Queues an action value as input.
+ * 
+ * @param headless The headless backend
+ * @param action The action value
+ * @return TRUE on success, or FALSE on error
+ */
+bool TLog_Headless_PushAction(TLog_Headless* headless, TLog_Widget_Action action);
+
+/**
+ * @brief Queues a resize of the screen as input.
+ * 
+ * The screen takes the new size when the input is taken, keeping what fits of its content,
+ * like a terminal window being resized.
+ * 
+ * @param headless The headless backend
+ * @param width New screen width
+ * @param height New screen height
+ * @return TRUE on success, or FALSE on error
+ */
+bool TLog_Headless_PushResize(TLog_Headless* headless, uint32_t width, uint32_t height);
+
+/**
+ * @brief Returns a screen row's text.
+ * 
+ * @param headless The headless backend
+ * @param y The row
+ * @param pool Memory pool for the text
+ * @return The row's text including trailing blanks, or NULL on error
+ */
+char* TLog_Headless_GetRow(TLog_Headless* headless, uint32_t y, apr_pool_t* pool);
+
+/**
+ * @brief Returns a screen cell's attribute.
+ * 
+ * @param headless The headless backend
+ * @param x The cell's column
+ * @param y The cell's row
+ * @return The cell's attribute
+ */
+TLog_Attribute TLog_Headless_GetAttribute(TLog_Headless* headless, uint32_t x, uint32_t y);
+
+/**
+ * @brief Returns the cursor's position.
+ * 
+ * @param headless The headless backend
+ * @param x Where to store the cursor's column
+ * @param y Where to store the cursor's row
+ */
+void TLog_Headless_GetCursor(TLog_Headless* headless, uint32_t* x, uint32_t* y);
+
+/**
+ * @brief Returns how often the screen was flushed.
+ * 
+ * @param headless The headless backend
+ * @return Number of flushes
+ */
+size_t TLog_Headless_GetFlushCount(TLog_Headless* headless);
+
+#endif
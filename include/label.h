@@ -7,6 +7,9 @@
 #ifndef TLOG_INCLUDE_LABEL_H
 #define TLOG_INCLUDE_LABEL_H
 
+#include <stdbool.h>
+#include <stddef.h>
+
 #include <apr_pools.h>
 
 #include "widget.h"
@@ -23,4 +26,91 @@ typedef struct tlog_label TLog_Label;
  */
 TLog_Label* TLog_Label_Create(apr_pool_t* pool, char* text);
 
+/**
+ * @brief Creates a label showing text it doesn't copy.
+ * 
+ * The text needn't be NUL-terminated, but must stay unchanged as long as the label is used.
+ * 
+ * @param pool Pool to handle the label
+ * @param text Label's text
+ * @param len Length of the text in bytes
+ * @return A new label, or NULL on error
+ */
+TLog_Label* TLog_Label_CreateStatic(apr_pool_t* pool, const char* text, size_t len);
+
+/**
+ * @brief Creates a label showing a file's content.
+ * 
+ * The file is mapped into memory rather than read, so even big files are shown without being copied.
+ * The mapping is removed with the pool. Changing the file (especially truncating it) while the label
+ * is used has undefined results.
+ * 
+ * @param pool Pool to handle the label and the mapping
+ * @param path Path of the file, which must hold UTF-8 text
+ * @return A new label, or NULL on error
+ */
+TLog_Label* TLog_Label_CreateFromFile(apr_pool_t* pool, const char* path);
+
+/**
+ * @brief Creates a label showing a file's content, laid out on a worker thread.
+ * 
+ * Like @ref TLog_Label_CreateFromFile() followed by @ref TLog_Label_SetAsync(), but the file isn't read
+ * before the run either: checking it's UTF-8 is left to the worker as well. If it isn't, the label shows
+ * a line saying so.
+ * 
+ * @param pool Pool to handle the label and the mapping
+ * @param path Path of the file, which should hold UTF-8 text
+ * @return A new label, or NULL on error
+ */
+TLog_Label* TLog_Label_CreateFromFileAsync(apr_pool_t* pool, const char* path);
+
+/**
+ * @brief Sets a label's text.
+ * 
+ * Drops the label's cached layouts. The text is copied into a buffer the label reuses for later texts,
+ * so setting texts again and again doesn't grow the label's pool.
+ * 
+ * @param label The label
+ * @param text The new text
+ * @return TRUE on success, or FALSE on error
+ */
+bool TLog_Label_SetText(TLog_Label* label, char* text);
+
+/**
+ * @brief Sets wether a label's lines break between words.
+ * 
+ * Lines break at spaces, after hyphens and around wide characters. Words wider than a line
+ * break where the line ends. Otherwise, and by default, lines break where they end.
+ * 
+ * @param label The label
+ * @param wordWrap TRUE to break lines between words, or FALSE to break them anywhere
+ */
+void TLog_Label_SetWordWrap(TLog_Label* label, bool wordWrap);
+
+/**
+ * @brief Sets wether a label lays out large texts on a worker thread.
+ * 
+ * A run then doesn't wait for the label's layout: until the worker is done, the label takes one line
+ * saying how far it got, and the other widgets can be used. Then the label takes its height and is drawn.
+ * Closing the dialog stops the worker, and a layout the worker finished is kept for later runs.
+ * As measuring its text would take as long, the label asks for the whole screen's width. Small texts
+ * are laid out at once, as are cached layouts. By default, the label is laid out before the run goes on.
+ * 
+ * @param label The label
+ * @param async TRUE to lay out large texts on a worker thread, or FALSE to lay out before the run goes on
+ */
+void TLog_Label_SetAsync(TLog_Label* label, bool async);
+
+/**
+ * @brief Returns how often a label could reuse cached layout calculations.
+ * 
+ * A label caches its prefered width and the lines of the recently used maximum widths,
+ * so repeated runs of the same dialog won't lay it out again.
+ * 
+ * @param label The label
+ * @param hits Where to store the number of calculations answered by cache, or NULL
+ * @param misses Where to store the number of calculations done, or NULL
+ */
+void TLog_Label_GetCacheStats(TLog_Label* label, size_t* hits, size_t* misses);
+
 #endif
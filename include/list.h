@@ -0,0 +1,119 @@
+/**
+ * @file list.h
+ * @author Tobias Heukäufer
+ * @brief A widget to select one of many items.
+ */
+
+#ifndef TLOG_INCLUDE_LIST_H
+#define TLOG_INCLUDE_LIST_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <apr_pools.h>
+
+#include "widget.h"
+
+/** @brief A list. */
+typedef struct tlog_list TLog_List;
+
+/**
+ * @brief Returns a list item's text.
+ * 
+ * Called for the items on screen whenever they are drawn, and for all items by @ref TLog_List_SetFilter().
+ * The text must stay valid until the next call.
+ * 
+ * @param index Index of the item
+ * @param len Where to store the text's length in bytes
+ * @param baton Baton the list was created with
+ * @return The item's UTF-8 text (not NUL-terminated), or NULL for none
+ */
+typedef const char* (*TLog_List_GetItem) (uint64_t index, size_t* len, void* baton);
+
+/** @brief Ways a list's filter matches items. */
+typedef enum tlog_list_match {
+    /** @brief Items containing the query. */
+    TLOG_LIST_MATCH_SUBSTRING,
+    /** @brief Items containing the query's characters in order, e.g. "tbl" matches "Tobylog". */
+    TLOG_LIST_MATCH_SUBSEQUENCE
+} TLog_List_Match;
+
+/**
+ * @brief Creates a list.
+ * 
+ * A list shows a window of its items, one per line, with the selected one highlighted. Up and Down move
+ * the selection, Page Up and Page Down by a window, Home and End to the first and last item. Items are
+ * asked for by index when drawn, so a list takes the same time and memory whatever its number of items.
+ * Texts are cut off at the list's width.
+ * 
+ * @param pool Pool to handle the list
+ * @param getItem Function returning the items' texts
+ * @param baton Baton to call getItem with
+ * @param count Number of items
+ * @param rows Number of items shown at once
+ * @param width Prefered width, or 0 for the whole screen's width
+ * @return A new list, or NULL on error
+ */
+TLog_List* TLog_List_Create(apr_pool_t* pool, TLog_List_GetItem getItem, void* baton, uint64_t count,
+        uint32_t rows, uint32_t width);
+
+/**
+ * @brief Lets typing filter a list's items.
+ * 
+ * A filtering list shows what was typed, the query, in a line above its items, and only the items matching it.
+ * ASCII letters match regardless of case.
+ * 
+ * Matching runs on a case-folded copy of all items' texts, which is taken here, asking for every item once.
+ * Call this again after items' texts changed, and before running the list, as the query's line changes
+ * its height. Matching goes in steps, a small one per keystroke and larger ones while waiting for input,
+ * and shows the matches found so far, so typing stays responsive however many items there are.
+ * A query extending the previous one is only matched against the previous one's matches.
+ * 
+ * @param list The list, with at most UINT32_MAX items
+ * @param match How to match items
+ * @return TRUE on success, or FALSE on error
+ */
+bool TLog_List_SetFilter(TLog_List* list, TLog_List_Match match);
+
+/**
+ * @brief Sets a list's number of items.
+ * 
+ * The selection stays on its item if there still is one, else it moves to the last item. To show the change
+ * during a run, pass the list to @ref TLog_Invalidate(). A filtering list copies the texts of added items
+ * and matches all items again.
+ * 
+ * @param list The list
+ * @param count Number of items
+ * @return TRUE on success, or FALSE on error, keeping the old number of items
+ */
+bool TLog_List_SetCount(TLog_List* list, uint64_t count);
+
+/**
+ * @brief Returns a list's number of items.
+ * 
+ * @param list The list
+ * @return Number of items
+ */
+uint64_t TLog_List_GetCount(TLog_List* list);
+
+/**
+ * @brief Selects a list's item and scrolls it into view.
+ * 
+ * To show the change during a run, pass the list to @ref TLog_Invalidate().
+ * 
+ * @param list The list
+ * @param index Index of the item, beyond the last item selects the last one, and for a filtering list
+ *              an item not matching selects the next matching one
+ */
+void TLog_List_SetSelected(TLog_List* list, uint64_t index);
+
+/**
+ * @brief Returns a list's selected item.
+ * 
+ * @param list The list
+ * @return Index of the item, meaningless for a list showing no items
+ */
+uint64_t TLog_List_GetSelected(TLog_List* list);
+
+#endif
@@ -0,0 +1,121 @@
+/**
+ * @file loop.h
+ * @author Tobias Heukäufer
+ * @brief An event loop to run Tobylog in.
+ *
+ * Run by @ref TLog_RunLoop(), Tobylog waits for the terminal, file descriptors and timers at once,
+ * so a dialog can react to background events without using any CPU while nothing happens.
+ * Callbacks are called from within @ref TLog_RunLoop() and may change widgets, see @ref TLog_Invalidate().
+ */
+
+#ifndef TLOG_INCLUDE_LOOP_H
+#define TLOG_INCLUDE_LOOP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <apr_pools.h>
+
+/** @brief An event loop. */
+typedef struct tlog_loop TLog_Loop;
+
+/** @brief A timer of an event loop. */
+typedef struct tlog_loop_timer TLog_Loop_Timer;
+
+/**
+ * @brief Called when a file descriptor is ready to be read, or reached its end.
+ *
+ * @param fd The file descriptor
+ * @param baton Baton the file descriptor was added with
+ */
+typedef void (*TLog_Loop_FdCallback) (int fd, void* baton);
+
+/**
+ * @brief Called when a timer expires.
+ *
+ * @param timer The timer
+ * @param baton Baton the timer was added with
+ */
+typedef void (*TLog_Loop_TimerCallback) (TLog_Loop_Timer* timer, void* baton);
+
+/**
+ * @brief Called after an event loop was woken up by @ref TLog_Loop_Wakeup().
+ *
+ * @param baton Baton the callback was set with
+ */
+typedef void (*TLog_Loop_WakeupCallback) (void* baton);
+
+/**
+ * @brief Creates an event loop.
+ *
+ * @param pool Memory pool
+ * @return A new event loop, or NULL on error
+ */
+TLog_Loop* TLog_Loop_Create(apr_pool_t* pool);
+
+/**
+ * @brief Adds a file descriptor for an event loop to wait on.
+ *
+ * A loop waits on at most 64 file descriptors. The callback is called as long as the file descriptor
+ * is readable, so it should read it (or remove it at its end).
+ *
+ * @param loop The event loop
+ * @param fd The file descriptor
+ * @param callback Function to call when the file descriptor is ready, or NULL to only wake the loop up
+ * @param baton Baton to call the function with
+ * @return TRUE on success, or FALSE on error
+ */
+bool TLog_Loop_AddFd(TLog_Loop* loop, int fd, TLog_Loop_FdCallback callback, void* baton);
+
+/**
+ * @brief Removes a file descriptor an event loop waits on.
+ *
+ * @param loop The event loop
+ * @param fd The file descriptor
+ */
+void TLog_Loop_RemoveFd(TLog_Loop* loop, int fd);
+
+/**
+ * @brief Adds a timer to an event loop.
+ *
+ * Timers are kept in a timer wheel with a resolution of a few milliseconds.
+ *
+ * @param loop The event loop
+ * @param delay Milliseconds until the timer expires
+ * @param interval Milliseconds between expiries after the first one, or 0 to expire once
+ * @param callback Function to call when the timer expires
+ * @param baton Baton to call the function with
+ * @return The timer, valid until it expired once (if not repeating) or was cancelled, or NULL on error
+ */
+TLog_Loop_Timer* TLog_Loop_AddTimer(TLog_Loop* loop, uint32_t delay, uint32_t interval,
+        TLog_Loop_TimerCallback callback, void* baton);
+
+/**
+ * @brief Cancels a timer.
+ *
+ * May be called from the timer's own callback.
+ *
+ * @param timer The timer
+ */
+void TLog_Loop_CancelTimer(TLog_Loop_Timer* timer);
+
+/**
+ * @brief Sets the function to call after an event loop was woken up.
+ *
+ * @param loop The event loop
+ * @param callback The function, or NULL
+ * @param baton Baton to call the function with
+ */
+void TLog_Loop_SetWakeupCallback(TLog_Loop* loop, TLog_Loop_WakeupCallback callback, void* baton);
+
+/**
+ * @brief Wakes an event loop up.
+ *
+ * Unlike all other event loop functions, this function may be called from any thread.
+ *
+ * @param loop The event loop
+ * @return TRUE on success, or FALSE on error
+ */
+bool TLog_Loop_Wakeup(TLog_Loop* loop);
+
+#endif
@@ -0,0 +1,115 @@
+/**
+ * @file stats.h
+ * @author Tobias Heukäufer
+ * @brief Performance counters.
+ * 
+ * While enabled, Tobylog counts and times what it does in its runs: laying out widgets, drawing their lines,
+ * refreshing the screen, and answering input. Disabled, which is the default, each measuring point costs
+ * a single test, so the counters can stay compiled into production builds and be enabled for slow sessions.
+ */
+
+#ifndef TLOG_INCLUDE_STATS_H
+#define TLOG_INCLUDE_STATS_H
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "widget.h"
+
+/** @brief Number of widget types layout time is told apart for, the last one takes in all further types. */
+#define TLOG_STATS_MAX_TYPES 16
+
+/** @brief Layout time of a widget type. */
+typedef struct tlog_stats_layout {
+    /** @brief The type's widget data (see @ref tlog_widget::data), or NULL for further types. */
+    const TLog_Widget_Data* type;
+    /** @brief Number of prefered width and maximum width calls. */
+    uint64_t calls;
+    /** @brief Nanoseconds spent in them. */
+    uint64_t ns;
+} TLog_Stats_Layout;
+
+/** @brief Counters since statistics were enabled or reset. */
+typedef struct tlog_stats {
+    /** @brief Layout time per widget type, in order of first appearance. */
+    TLog_Stats_Layout layouts[TLOG_STATS_MAX_TYPES];
+    /** @brief Number of widget types in @ref tlog_stats::layouts. */
+    size_t layoutCount;
+
+    /** @brief Number of calls to widgets' @ref TLog_Widget_DrawLine. */
+    uint64_t drawLineCalls;
+    /** @brief Number of drawn lines that differed from the screen and were sent to it. */
+    uint64_t linesWritten;
+
+    /** @brief Number of screen refreshes, i.e. frames. */
+    uint64_t refreshes;
+    /** @brief Nanoseconds spent refreshing the screen. */
+    uint64_t refreshNs;
+
+    /** @brief Number of frames answering input, i.e. of latencies measured. */
+    uint64_t inputFrames;
+    /** @brief Median nanoseconds from taking input to the refresh showing it (approximated to within 19%). */
+    uint64_t latencyP50Ns;
+    /** @brief 90th percentile of the latencies. */
+    uint64_t latencyP90Ns;
+    /** @brief 99th percentile of the latencies. */
+    uint64_t latencyP99Ns;
+    /** @brief Largest latency. */
+    uint64_t latencyMaxNs;
+} TLog_Stats;
+
+/** @brief Counters of a single frame. */
+typedef struct tlog_frame_stats {
+    /** @brief Number of calls to widgets' @ref TLog_Widget_DrawLine. */
+    uint64_t drawLineCalls;
+    /** @brief Number of drawn lines that were sent to the screen. */
+    uint64_t linesWritten;
+    /** @brief Nanoseconds the refresh took. */
+    uint64_t refreshNs;
+    /** @brief Nanoseconds from taking the first input the frame answers to its refresh, or 0 without input. */
+    uint64_t latencyNs;
+    /** @brief Bytes sent to the terminal, or 0 if the backend can't tell. */
+    size_t bytes;
+} TLog_Frame_Stats;
+
+/**
+ * @brief Called after every frame while statistics are enabled.
+ * 
+ * Called from within a run, it must not run Tobylog itself.
+ * 
+ * @param frame The frame's counters
+ * @param baton Baton the callback was set with
+ */
+typedef void (*TLog_Stats_FrameCallback) (const TLog_Frame_Stats* frame, void* baton);
+
+/**
+ * @brief Enables or disables statistics.
+ * 
+ * Counters are kept while disabled, see @ref TLog_Stats_Reset().
+ * 
+ * @param enabled TRUE to collect statistics, or FALSE to stop
+ */
+void TLog_Stats_SetEnabled(bool enabled);
+
+/**
+ * @brief Returns the counters.
+ * 
+ * @param stats Where to store the counters
+ */
+void TLog_Stats_Get(TLog_Stats* stats);
+
+/**
+ * @brief Sets all counters to 0.
+ */
+void TLog_Stats_Reset(void);
+
+/**
+ * @brief Sets the function to call after every frame.
+ * 
+ * @param callback The function, or NULL to call none
+ * @param baton Baton to call the function with
+ */
+void TLog_Stats_SetFrameCallback(TLog_Stats_FrameCallback callback, void* baton);
+
+#endif
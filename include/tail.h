@@ -0,0 +1,64 @@
+/**
+ * @file tail.h
+ * @author Tobias Heukäufer
+ * @brief A widget showing the last lines read from a file descriptor.
+ */
+
+#ifndef TLOG_INCLUDE_TAIL_H
+#define TLOG_INCLUDE_TAIL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <apr_pools.h>
+
+#include "widget.h"
+
+/** @brief A tail. */
+typedef struct tlog_tail TLog_Tail;
+
+/**
+ * @brief Creates a tail.
+ *
+ * A tail shows the last lines read from a file descriptor (e.g. a pipe from a subprocess), like tail -f.
+ * The file descriptor is made non-blocking and read while Tobylog waits for input. However much is read,
+ * a tail keeps only its last bytes, so its memory stays the same. Lines are cut off at the tail's width,
+ * and a tail prefers the whole screen's width.
+ *
+ * @param pool Pool to handle the tail
+ * @param fd File descriptor to read from, not closed by the tail
+ * @param rows Number of lines to show
+ * @param capacity Number of bytes to keep, rounded up to a power of 2
+ * @return A new tail, or NULL on error
+ */
+TLog_Tail* TLog_Tail_Create(apr_pool_t* pool, int fd, uint32_t rows, size_t capacity);
+
+/**
+ * @brief Sets wether a tail follows its input.
+ *
+ * A following tail shows the newest lines as they come in, which is the default. Otherwise it keeps
+ * showing the same lines, until they are dropped to make room for new ones.
+ *
+ * @param tail The tail
+ * @param follow TRUE to follow, or FALSE to stay
+ */
+void TLog_Tail_SetFollow(TLog_Tail* tail, bool follow);
+
+/**
+ * @brief Returns wether a tail's file descriptor reached its end (or failed).
+ *
+ * @param tail The tail
+ * @return TRUE if no more input will be read, or FALSE else
+ */
+bool TLog_Tail_IsFinished(TLog_Tail* tail);
+
+/**
+ * @brief Returns the number of bytes a tail has read so far.
+ *
+ * @param tail The tail
+ * @return Number of bytes read, including those already dropped
+ */
+uint64_t TLog_Tail_GetBytesRead(TLog_Tail* tail);
+
+#endif
@@ -54,4 +54,30 @@ void TLog_Text_SetText(TLog_Text* text, char* value);
  */
 char* TLog_Text_GetText(TLog_Text* text, apr_pool_t* pool);
 
+/**
+ * @brief Sets how much memory a text field's undo history takes at most.
+ * 
+ * Characters typed or deleted in a row are undone (@ref TLog_Widget_Action::TLOG_WIDGET_ACTION_UNDO)
+ * and redone (@ref TLog_Widget_Action::TLOG_WIDGET_ACTION_REDO) at once. The history records the
+ * characters each edit inserted or deleted rather than copies of the text, and drops its oldest edits
+ * once they take more than the budget. Default budget is 1 MiB, setting the text clears the history.
+ * 
+ * @param text The text field
+ * @param budget Maximum number of bytes, or 0 for no undo
+ */
+void TLog_Text_SetHistoryBudget(TLog_Text* text, size_t budget);
+
+/**
+ * @brief Returns a text field's text buffer usage.
+ * 
+ * The buffer is allocated outside of the text field's pool and freed with it.
+ * It grows by doubling and shrinks again as text is deleted, so the unused bytes stay bounded
+ * by three times the text's length.
+ * 
+ * @param text The text field
+ * @param capacity Where to store the buffer's size in bytes, or NULL
+ * @param wasted Where to store the number of unused bytes in the buffer, or NULL
+ */
+void TLog_Text_GetMemoryUsage(TLog_Text* text, size_t* capacity, size_t* wasted);
+
 #endif
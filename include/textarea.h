@@ -0,0 +1,82 @@
+/**
+ * @file textarea.h
+ * @author Tobias Heukäufer
+ * @brief A multi-line text field.
+ */
+
+#ifndef TLOG_INCLUDE_TEXTAREA_H
+#define TLOG_INCLUDE_TEXTAREA_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <apr_pools.h>
+
+#include "widget.h"
+
+/** @brief A text area. */
+typedef struct tlog_text_area TLog_TextArea;
+
+/**
+ * @brief Creates a text area.
+ *
+ * A text area shows a window of its text's lines and edits them: typing inserts at the cursor, Return
+ * inserts a newline, Up and Down move between lines, Page Up and Page Down by a window, Home and End
+ * to the line's start and end. Lines are cut off at the text area's width, which scrolls sideways
+ * to show the cursor. Moving to a line, inserting and deleting take the same time however many lines
+ * there are, and only the lines shown are drawn.
+ *
+ * @param pool Pool to handle the text area
+ * @param rows Number of lines shown
+ * @param width Prefered width, or 0 for the whole screen's width
+ * @return A new text area, or NULL on error
+ */
+TLog_TextArea* TLog_TextArea_Create(apr_pool_t* pool, uint32_t rows, uint32_t width);
+
+/**
+ * @brief Sets a text area's text and puts the cursor at its start.
+ *
+ * @param area The text area
+ * @param text The UTF-8 text (not NUL-terminated), copied
+ * @param len Length of the text in bytes
+ * @return TRUE on success, or FALSE on error (e.g. malformed UTF-8), leaving the text area empty
+ */
+bool TLog_TextArea_SetText(TLog_TextArea* area, const char* text, size_t len);
+
+/**
+ * @brief Returns a text area's text.
+ *
+ * @param area The text area
+ * @param pool Memory pool for the text
+ * @return The NUL-terminated text, or NULL on error
+ */
+char* TLog_TextArea_GetText(TLog_TextArea* area, apr_pool_t* pool);
+
+/**
+ * @brief Returns a text area's number of lines.
+ *
+ * @param area The text area
+ * @return Number of lines, at least 1
+ */
+uint64_t TLog_TextArea_GetLineCount(TLog_TextArea* area);
+
+/**
+ * @brief Moves a text area's cursor to a line's start and scrolls it into view.
+ *
+ * To show the change during a run, pass the text area to @ref TLog_Invalidate().
+ *
+ * @param area The text area
+ * @param line Index of the line, beyond the last line moves to the last one
+ */
+void TLog_TextArea_GoToLine(TLog_TextArea* area, uint64_t line);
+
+/**
+ * @brief Returns the line a text area's cursor is in.
+ *
+ * @param area The text area
+ * @return Index of the line
+ */
+uint64_t TLog_TextArea_GetCursorLine(TLog_TextArea* area);
+
+#endif
@@ -12,6 +12,9 @@
 #include <apr_pools.h>
 
 #include "../include/widget.h"
+#include "../include/backend.h"
+#include "../include/loop.h"
+#include "../include/stats.h"
 
 /** @brief Tobylog function results. */
 typedef enum tlog_result {
@@ -33,6 +36,18 @@ typedef enum tlog_result {
  */
 TLog_Result TLog_Init(apr_pool_t* pool);
 
+/**
+ * @brief Initializes Tobylog to run on a backend.
+ * 
+ * Like @ref TLog_Init(), but drawing to and reading input from the given backend
+ * instead of the terminal via ncurses.
+ * 
+ * @param pool Memory pool
+ * @param backend The backend
+ * @return @ref TLog_Result::TLOG_RESULT_OK on success, or @ref TLog_Result::TLOG_RESULT_FAIL else
+ */
+TLog_Result TLog_InitWithBackend(apr_pool_t* pool, TLog_Backend* backend);
+
 /**
  * @brief Runs Tobylog with a list of widgets.
  * 
@@ -44,4 +59,84 @@ TLog_Result TLog_Init(apr_pool_t* pool);
  */
 TLog_Result TLog_Run(TLog_Widget** widgets);
 
+/**
+ * @brief Runs Tobylog with a list of widgets in an event loop.
+ * 
+ * Like @ref TLog_Run(), but while waiting for input, the loop's file descriptors and timers are waited on
+ * as well, in a single wait using no CPU until something happens. Each wake-up ends in at most one frame,
+ * drawing what the loop's callbacks changed along with widget updates and input. Widgets taking in outside
+ * changes are updated at every wake-up instead of every few milliseconds, so their file descriptors should
+ * be added to the loop. Backends without a file descriptor are still polled for input.
+ * 
+ * @param widgets NULL-terminated array of widgets to be displayed from top to bottom
+ * @param loop The event loop, or NULL to run like @ref TLog_Run()
+ * @return @ref TLog_Result::TLOG_RESULT_OK on Return, @ref TLog_Result::TLOG_RESULT_CANCEL on Esc, or @ref TLog_Result::TLOG_RESULT_FAIL on failure
+ */
+TLog_Result TLog_RunLoop(TLog_Widget** widgets, TLog_Loop* loop);
+
+/**
+ * @brief Returns the memory pool for per-run layout state.
+ * 
+ * The pool is cleared at the start and the end of every run, so widgets can take what they need for a run's
+ * layout from it (e.g. in @ref TLog_Widget_SetMaximumWidth) without the memory adding up over repeated runs,
+ * and register cleanups on it to stop what they started for the run (e.g. a worker thread) once the dialog
+ * is closed. Nothing allocated from it may be used after the run. While several threads lay out widgets (see
+ * @ref TLog_SetLayoutThreads()), each gets a pool of its own, cleared along with it.
+ * 
+ * @return The pool, or NULL if Tobylog isn't initialized
+ */
+apr_pool_t* TLog_GetLayoutPool(void);
+
+/**
+ * @brief Sets how many threads lay out the widgets at a run's start.
+ * 
+ * With more than one thread, the widgets' @ref TLog_Widget_GetPreferedWidth and then their
+ * @ref TLog_Widget_SetMaximumWidth functions are called on several threads at once, one widget
+ * per thread at a time, and the run goes on once all are done. So these two functions must be
+ * thread-safe for different widgets: they may only change state of their own widget, and must not
+ * allocate from a pool another widget allocates from at the same time (e.g. the pool they were
+ * all created with), but from @ref TLog_GetLayoutPool(), which gives each thread a pool of its own,
+ * or with malloc(). All other widget functions, and layouts after the run's start (e.g. on resizes),
+ * are called on the thread running Tobylog. The widgets shipped with Tobylog are thread-safe that way.
+ * 
+ * Default is 1, laying out on the thread running Tobylog.
+ * 
+ * @param threads Number of threads, including the thread running Tobylog, or 0 for one per online processor
+ */
+void TLog_SetLayoutThreads(unsigned int threads);
+
+/**
+ * @brief Wakes a run up to update its widgets, e.g. from a widget's worker thread.
+ * 
+ * Unlike all other Tobylog functions, this function may be called from any thread. Running in an event loop,
+ * the widgets are updated at once, see @ref TLog_RunLoop(). Otherwise they're updated every few
+ * milliseconds anyway, and nothing happens.
+ */
+void TLog_Wakeup(void);
+
+/**
+ * @brief Tells Tobylog a widget changed, e.g. from an event loop callback.
+ * 
+ * The widget is laid out again and redrawn with the next frame. If its height changed, the widgets
+ * below move. The focused widget's cursor stays where it was. Outside of a run, nothing happens,
+ * as all widgets are laid out at a run's start. Widgets may pass themselves from their
+ * @ref TLog_Widget_Update function, e.g. once a worker thread finished their layout.
+ * 
+ * @param widget The widget
+ */
+void TLog_Invalidate(TLog_Widget* widget);
+
+/**
+ * @brief Returns how much output Tobylog has sent to the terminal since initialization.
+ * 
+ * A frame is everything sent between two screen updates. Tobylog keeps a copy of what's on screen
+ * and only sends cells that changed. Byte counts stay 0 if the backend can't tell how many bytes it sent
+ * (like the ncurses backend, whose output can be measured by recording the session, e.g. with script(1)).
+ * 
+ * @param frames Where to store the number of frames, or NULL
+ * @param lastFrameBytes Where to store the number of bytes sent for the last frame, or NULL
+ * @param totalBytes Where to store the number of bytes sent for all frames, or NULL
+ */
+void TLog_GetOutputStats(size_t* frames, size_t* lastFrameBytes, size_t* totalBytes);
+
 #endif
\ No newline at end of file
@@ -7,6 +7,7 @@
 #ifndef TLOG_INCLUDE_WIDGET_H
 #define TLOG_INCLUDE_WIDGET_H
 
+#include <stddef.h>
 #include <stdint.h>
 #include <stdbool.h>
 
@@ -27,7 +28,23 @@ typedef enum tlog_widget_action {
     /** @brief Arrow right key */
     TLOG_WIDGET_ACTION_RIGHT,
     /** @brief Tab key */
-    TLOG_WIDGET_ACTION_TAB
+    TLOG_WIDGET_ACTION_TAB,
+    /** @brief Delete key */
+    TLOG_WIDGET_ACTION_DELETE,
+    /** @brief Home key */
+    TLOG_WIDGET_ACTION_HOME,
+    /** @brief End key */
+    TLOG_WIDGET_ACTION_END,
+    /** @brief Page up key */
+    TLOG_WIDGET_ACTION_PAGE_UP,
+    /** @brief Page down key */
+    TLOG_WIDGET_ACTION_PAGE_DOWN,
+    /** @brief Shift and Tab keys */
+    TLOG_WIDGET_ACTION_SHIFT_TAB,
+    /** @brief Undo key (Ctrl+_, which most terminals also send for Ctrl+/) */
+    TLOG_WIDGET_ACTION_UNDO,
+    /** @brief Redo key (Ctrl+R) */
+    TLOG_WIDGET_ACTION_REDO
 } TLog_Widget_Action;
 
 /** @brief General widget. */
@@ -36,6 +53,9 @@ typedef struct tlog_widget TLog_Widget;
 /**
  * @brief Returns a widget's prefered width.
  * 
+ * A widget must look the same for all maximum widths not below its prefered width, as it isn't
+ * laid out again when the screen is resized between such widths.
+ * 
  * @param widget The widget to query
  * @return The widget's prefered width, or 0 on error
  */
@@ -48,8 +68,19 @@ typedef uint32_t (*TLog_Widget_GetPreferedWidth) (TLog_Widget* widget);
  * that might fail, as later widget calls won't check for errors, meaning from here on, widgets are expected
  * to run smoothly.
  * 
- * If the returned height is greater than the given screen height, this run will end as cancelled,
- * as Tobylog can currently not handle widgets larger than the screen.
+ * Widgets may be taller than the screen. Only the lines on screen are drawn, so drawing a line should not
+ * take longer for a tall widget than for a short one.
+ * 
+ * State only needed for the run's layout should come from @ref TLog_GetLayoutPool() rather than
+ * the widget's own pool, which would grow with every run.
+ * 
+ * With @ref TLog_SetLayoutThreads(), this function and @ref TLog_Widget_GetPreferedWidth may be called
+ * on another thread, at the same time as other widgets' ones.
+ * 
+ * Layouts too slow to wait for (e.g. of a huge text) may be made on a worker thread instead: the widget
+ * returns the height of a placeholder, and once the worker is done (see @ref TLog_Wakeup()) its
+ * @ref TLog_Widget_Update function passes it to @ref TLog_Invalidate() to be laid out again. A cleanup
+ * registered on @ref TLog_GetLayoutPool() stops the worker when the dialog is closed earlier.
  * 
  * @param widget The widget to configure
  * @param maxWidth Maximum width
@@ -62,7 +93,7 @@ typedef uint32_t (*TLog_Widget_SetMaximumWidth) (TLog_Widget* widget, uint32_t m
  * @brief Draws a widget's line to the screen.
  * 
  * When called, the cursor is at the position the layout manager expects the widget to draw its line at,
- * and the terminal's attributes are set to normal.
+ * and the attribute is set to normal. Draw with the functions in draw.h.
  * Drawing longer lines than was previously set by @ref TLog_Widget_SetMaximumWidth may lead to
  * display errors.
  * 
@@ -74,6 +105,9 @@ typedef void (*TLog_Widget_DrawLine) (TLog_Widget* widget, uint32_t lineY);
 /**
  * @brief Notifies a widget of having focus.
  * 
+ * Also called on the focused widget after it was laid out for a new screen size, to learn where its cursor
+ * went, so it should keep its state (e.g. where the cursor is in its content).
+ * 
  * @param widget The widget to notify
  * @param fromAbove Wether focus was received from above (true) or below (false)
  * @param cursorX Where to store the cursor X position in widget space
@@ -94,6 +128,24 @@ typedef void (*TLog_Widget_SetFocus) (TLog_Widget* widget, bool fromAbove, uint3
 typedef void (*TLog_Widget_PutChar) (TLog_Widget* widget, char ch,
         uint32_t* cursorX, uint32_t* cursorY, uint32_t* dirtyStart, uint32_t* dirtyEnd);
 
+/**
+ * @brief Sends several characters to a widget at once.
+ * 
+ * Has the same effect as sending each character by @ref TLog_Widget_PutChar, but lets the widget
+ * insert typed ahead or pasted text in one go. Line breaks and tabs of pasted text come in as '\\n' and '\\t',
+ * widgets without several lines drop them.
+ * 
+ * @param widget The widget to send to
+ * @param text Printable ASCII characters, and '\\n' and '\\t' when pasted (not NUL-terminated)
+ * @param len Number of characters
+ * @param cursorX Where to store the cursor X position in widget space
+ * @param cursorY Where to store the cursor Y position in widget space
+ * @param dirtyStart Index of first dirty line
+ * @param dirtyEnd Index after last dirty line
+ */
+typedef void (*TLog_Widget_PutText) (TLog_Widget* widget, const char* text, size_t len,
+        uint32_t* cursorX, uint32_t* cursorY, uint32_t* dirtyStart, uint32_t* dirtyEnd);
+
 /**
  * @brief Sends an action to a widget.
  * 
@@ -108,6 +160,18 @@ typedef void (*TLog_Widget_PutChar) (TLog_Widget* widget, char ch,
 typedef bool (*TLog_Widget_PutAction) (TLog_Widget* widget, TLog_Widget_Action action,
         uint32_t* cursorX, uint32_t* cursorY, uint32_t* dirtyStart, uint32_t* dirtyEnd);
 
+/**
+ * @brief Lets a widget take in what changed outside of Tobylog (e.g. data arriving on a file descriptor).
+ * 
+ * Called before the widget is first drawn and then regularly while waiting for input, so it must not block.
+ * The widget's height must stay the same, to change it pass the widget to @ref TLog_Invalidate().
+ * 
+ * @param widget The widget to update
+ * @param dirtyStart Index of first dirty line
+ * @param dirtyEnd Index after last dirty line
+ */
+typedef void (*TLog_Widget_Update) (TLog_Widget* widget, uint32_t* dirtyStart, uint32_t* dirtyEnd);
+
 /** @brief Common widget data. */
 typedef struct tlog_widget_data {
     /** @brief @copybrief TLog_Widget_GetPreferedWidth */
@@ -134,6 +198,18 @@ typedef struct tlog_widget_data {
      * Set NULL if not taking action values. 
      */
     TLog_Widget_PutAction putAction;
+    /**
+     * @brief @copybrief TLog_Widget_PutText
+     * 
+     * Set NULL to have characters sent one by one by @ref TLog_Widget_PutChar instead.
+     */
+    TLog_Widget_PutText putText;
+    /**
+     * @brief @copybrief TLog_Widget_Update
+     *
+     * Set NULL if nothing outside of Tobylog changes the widget.
+     */
+    TLog_Widget_Update update;
 } TLog_Widget_Data;
 
 
@@ -0,0 +1,91 @@
+#!/usr/bin/env python3
+"""Prints src/utf8_width.h, the display width table of src/utf8.c.
+
+Widths follow Unicode's East Asian Width property: wide (W) and fullwidth (F)
+characters take 2 columns, combining marks (Mn, Me), format characters (Cf,
+but the soft hyphen), controls (Cc) and Hangul medial vowels and final
+consonants take none, everything else takes 1. Unassigned codepoints in the
+CJK ideograph planes default to wide.
+
+Usage: scripts/utf8_width.py > src/utf8_width.h
+"""
+
+import unicodedata
+
+BLOCK_BITS = 8
+BLOCK_SIZE = 1 << BLOCK_BITS
+MAX_CODEPOINT = 0x110000
+
+WIDE_DEFAULTS = [
+    (0x3400, 0x4DBF),
+    (0x4E00, 0x9FFF),
+    (0xF900, 0xFAFF),
+    (0x20000, 0x2FFFD),
+    (0x30000, 0x3FFFD),
+]
+
+
+def width(cp):
+    ch = chr(cp)
+    category = unicodedata.category(ch)
+    if cp == 0x00AD:
+        return 1
+    if category in ('Mn', 'Me', 'Cf', 'Cc'):
+        return 0
+    if 0x1160 <= cp <= 0x11FF or 0xD7B0 <= cp <= 0xD7FF:
+        return 0
+    if unicodedata.east_asian_width(ch) in ('W', 'F'):
+        return 2
+    if category == 'Cn' and any(low <= cp <= high for low, high in WIDE_DEFAULTS):
+        return 2
+    return 1
+
+
+def main():
+    blocks = []
+    block_index = {}
+    indexes = []
+    for start in range(0, MAX_CODEPOINT, BLOCK_SIZE):
+        packed = bytearray(BLOCK_SIZE // 4)
+        for i in range(BLOCK_SIZE):
+            packed[i // 4] |= width(start + i) << (2 * (i % 4))
+        packed = bytes(packed)
+        if packed not in block_index:
+            block_index[packed] = len(blocks)
+            blocks.append(packed)
+        indexes.append(block_index[packed])
+    assert len(blocks) <= 256
+
+    print('/**')
+    print(' * @file utf8_width.h')
+    print(' * @author Tobias Heuk\u00e4ufer')
+    print(' * @brief Display width table, see scripts/utf8_width.py.')
+    print(' */')
+    print()
+    print('#ifndef TLOG_SRC_UTF8_WIDTH_H')
+    print('#define TLOG_SRC_UTF8_WIDTH_H')
+    print()
+    print('#include <stdint.h>')
+    print()
+    print('/* Generated by scripts/utf8_width.py from Unicode %s */' % unicodedata.unidata_version)
+    print()
+    print('/** @brief Index into @ref WIDTH_BLOCKS per block of %d codepoints. */' % BLOCK_SIZE)
+    print('static const uint8_t WIDTH_INDEX[%d] = {' % len(indexes))
+    for i in range(0, len(indexes), 16):
+        print('    ' + ', '.join('%d' % x for x in indexes[i:i + 16]) + ',')
+    print('};')
+    print()
+    print('/** @brief Widths of a block\'s codepoints, 2 bits each, least significant first. */')
+    print('static const uint8_t WIDTH_BLOCKS[%d][%d] = {' % (len(blocks), BLOCK_SIZE // 4))
+    for block in blocks:
+        print('    {')
+        for i in range(0, len(block), 16):
+            print('        ' + ', '.join('0x%02x' % x for x in block[i:i + 16]) + ',')
+        print('    },')
+    print('};')
+    print()
+    print('#endif')
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,507 @@
+/**
+ * @file headless.c
+ * @author Tobias Heukäufer
+ * @brief A headless backend implementation.
+ */
+
+#include "../include/headless.h"
+
+#include <string.h>
+
+#include <apr_tables.h>
+
+#include "utf8.h"
+
+/* Thanks! https://stackoverflow.com/a/3599170 */
+/** @brief Marks unused function parameters to prevent unused warnings. */
+#define UNUSED(x) (void)(x)
+
+/** @brief Initial capacity of the input queue. */
+#define INIT_INPUT_CAPACITY 16
+
+/** @brief Maximum length of a cell's text in bytes, a character and zero width characters following it. */
+#define MAX_CELL_LEN 8
+
+/**
+ * @brief A screen cell.
+ * 
+ * A wide character takes two cells, the right one is empty.
+ */
+typedef struct tlog_headless_cell {
+    /** @brief The cell's text. */
+    char ch[MAX_CELL_LEN];
+    /** @brief Length of the cell's text in bytes, or 0 right of a wide character. */
+    uint8_t len;
+    /** @brief The cell's attribute. */
+    uint8_t attribute;
+} TLog_Headless_Cell;
+
+struct tlog_headless {
+    /** @brief Backend data. */
+    const TLog_Backend_Data* data;
+
+    /** @brief Memory pool. */
+    apr_pool_t* pool;
+
+    /** @brief Screen width. */
+    uint32_t width;
+    /** @brief Screen height. */
+    uint32_t height;
+    /** @brief Screen cells, row by row. */
+    TLog_Headless_Cell* cells;
+    /** @brief Number of cells there is room for. */
+    size_t capacity;
+
+    /** @brief Cursor column. */
+    uint32_t cursorX;
+    /** @brief Cursor row. */
+    uint32_t cursorY;
+    /** @brief Current attribute. */
+    TLog_Attribute attribute;
+
+    /** @brief Number of flushes. */
+    size_t flushCount;
+    /** @brief Number of bytes a VT100 compatible terminal would have been sent. */
+    size_t bytesWritten;
+
+    /** @brief Queued input. */
+    apr_array_header_t* input;
+    /** @brief Index of the next input to take. */
+    int nextInput;
+    /** @brief Sizes of queued resizes, width and height each. */
+    apr_array_header_t* sizes;
+    /** @brief Index of the next size to take. */
+    int nextSize;
+};
+
+static bool start(TLog_Backend* backend);
+static void stop(TLog_Backend* backend);
+static void getSize(TLog_Backend* backend, uint32_t* width, uint32_t* height);
+static void moveCursor(TLog_Backend* backend, uint32_t y, uint32_t x);
+static void addText(TLog_Backend* backend, const char* text, size_t len);
+static void setAttribute(TLog_Backend* backend, TLog_Attribute attribute);
+static void clearToEol(TLog_Backend* backend);
+static void clearScreen(TLog_Backend* backend);
+static void scrollScreen(TLog_Backend* backend, int lines);
+static void flush(TLog_Backend* backend);
+static size_t getBytesWritten(TLog_Backend* backend);
+static void getInput(TLog_Backend* backend, int timeout, TLog_Input* input);
+
+/**
+ * @brief Resizes the screen, keeping what fits of its content.
+ * 
+ * @param headless The headless backend
+ * @param width New screen width
+ * @param height New screen height
+ */
+static void resize(TLog_Headless* headless, uint32_t width, uint32_t height);
+
+/**
+ * @brief Blanks cells.
+ * 
+ * @param cells First cell to blank
+ * @param count Number of cells to blank
+ */
+static void blank(TLog_Headless_Cell* cells, size_t count);
+
+/**
+ * @brief Blanks the other half of a wide character a cell is part of, as it is about to be overwritten.
+ * 
+ * @param headless The headless backend
+ * @param row The row's first cell
+ * @param x The cell's column
+ */
+static void breakWide(TLog_Headless* headless, TLog_Headless_Cell* row, uint32_t x);
+
+/**
+ * @brief Returns the number of decimal digits of a number.
+ * 
+ * @param n The number
+ * @return Number of digits
+ */
+static size_t countDigits(size_t n);
+
+/** @brief Headless backend functions. */
+static const TLog_Backend_Data TLOG_HEADLESS_DATA = {
+    &start,
+    &stop,
+    &getSize,
+    &moveCursor,
+    &addText,
+    &setAttribute,
+    &clearToEol,
+    &clearScreen,
+    &scrollScreen,
+    &flush,
+    &getBytesWritten,
+    &getInput,
+    NULL
+};
+
+TLog_Headless* TLog_Headless_Create(apr_pool_t* pool, uint32_t width, uint32_t height) {
+    if (width == 0 || height == 0) {
+        goto fail;
+    }
+
+    TLog_Headless* headless = apr_palloc(pool, sizeof(TLog_Headless));
+    if (!headless) {
+        goto fail;
+    }
+
+    headless->data = &TLOG_HEADLESS_DATA;
+
+    headless->pool = pool;
+
+    headless->width = width;
+    headless->height = height;
+    headless->cells = apr_palloc(pool, sizeof(TLog_Headless_Cell) * width * height);
+    if (!headless->cells) {
+        goto fail;
+    }
+    blank(headless->cells, (size_t) width * height);
+    headless->capacity = (size_t) width * height;
+
+    headless->cursorX = headless->cursorY = 0;
+    headless->attribute = TLOG_ATTRIBUTE_NORMAL;
+
+    headless->flushCount = 0;
+    headless->bytesWritten = 0;
+
+    headless->input = apr_array_make(pool, INIT_INPUT_CAPACITY, sizeof(TLog_Input));
+    if (!headless->input) {
+        goto fail;
+    }
+    headless->nextInput = 0;
+
+    headless->sizes = apr_array_make(pool, INIT_INPUT_CAPACITY, sizeof(uint32_t));
+    if (!headless->sizes) {
+        goto fail;
+    }
+    headless->nextSize = 0;
+
+    return headless;
+
+    fail:
+    return NULL;
+}
+
+bool TLog_Headless_PushChars(TLog_Headless* headless, const char* chars) {
+    if (!headless || !chars) {
+        return false;
+    }
+
+    for (; *chars != 0; ++chars) {
+        TLog_Input input;
+        if (*chars >= 32 && *chars <= 126) {
+            input.type = TLOG_INPUT_CHAR;
+            input.ch = *chars;
+        } else if (*chars == '\n') {
+            input.type = TLOG_INPUT_ACTION;
+            input.action = TLOG_WIDGET_ACTION_RETURN;
+        } else if (*chars == '\t') {
+            input.type = TLOG_INPUT_ACTION;
+            input.action = TLOG_WIDGET_ACTION_TAB;
+        } else if (*chars == 0x1b) {
+            input.type = TLOG_INPUT_ACTION;
+            input.action = TLOG_WIDGET_ACTION_ESC;
+        } else {
+            continue;
+        }
+        APR_ARRAY_PUSH(headless->input, TLog_Input) = input;
+    }
+
+    return true;
+}
+
+bool TLog_Headless_PushPaste(TLog_Headless* headless, const char* chars) {
+    if (!headless || !chars) {
+        return false;
+    }
+
+    TLog_Input input;
+    input.type = TLOG_INPUT_PASTE_START;
+    APR_ARRAY_PUSH(headless->input, TLog_Input) = input;
+
+    TLog_Headless_PushChars(headless, chars);
+
+    input.type = TLOG_INPUT_PASTE_END;
+    APR_ARRAY_PUSH(headless->input, TLog_Input) = input;
+
+    return true;
+}
+
+bool TLog_Headless_PushAction(TLog_Headless* headless, TLog_Widget_Action action) {
+    if (!headless) {
+        return false;
+    }
+
+    TLog_Input input;
+    input.type = TLOG_INPUT_ACTION;
+    input.action = action;
+    APR_ARRAY_PUSH(headless->input, TLog_Input) = input;
+
+    return true;
+}
+
+bool TLog_Headless_PushResize(TLog_Headless* headless, uint32_t width, uint32_t height) {
+    if (!headless || width == 0 || height == 0) {
+        return false;
+    }
+
+    APR_ARRAY_PUSH(headless->sizes, uint32_t) = width;
+    APR_ARRAY_PUSH(headless->sizes, uint32_t) = height;
+
+    TLog_Input input;
+    input.type = TLOG_INPUT_RESIZE;
+    APR_ARRAY_PUSH(headless->input, TLog_Input) = input;
+
+    return true;
+}
+
+char* TLog_Headless_GetRow(TLog_Headless* headless, uint32_t y, apr_pool_t* pool) {
+    if (!headless || y >= headless->height) {
+        return NULL;
+    }
+
+    char* row = apr_palloc(pool, headless->width * MAX_CELL_LEN + 1);
+    if (!row) {
+        return NULL;
+    }
+
+    char* ch = row;
+    TLog_Headless_Cell* cell = &headless->cells[(size_t) y * headless->width];
+    for (uint32_t x = 0; x < headless->width; ++x, ++cell) {
+        memcpy(ch, cell->ch, cell->len);
+        ch += cell->len;
+    }
+    *ch = 0;
+
+    return row;
+}
+
+TLog_Attribute TLog_Headless_GetAttribute(TLog_Headless* headless, uint32_t x, uint32_t y) {
+    if (!headless || x >= headless->width || y >= headless->height) {
+        return TLOG_ATTRIBUTE_NORMAL;
+    }
+    return headless->cells[(size_t) y * headless->width + x].attribute;
+}
+
+void TLog_Headless_GetCursor(TLog_Headless* headless, uint32_t* x, uint32_t* y) {
+    if (headless) {
+        *x = headless->cursorX;
+        *y = headless->cursorY;
+    }
+}
+
+size_t TLog_Headless_GetFlushCount(TLog_Headless* headless) {
+    return headless ? headless->flushCount : 0;
+}
+
+static bool start(TLog_Backend* backend) {
+    UNUSED(backend);
+    return true;
+}
+
+static void stop(TLog_Backend* backend) {
+    UNUSED(backend);
+}
+
+static void getSize(TLog_Backend* backend, uint32_t* width, uint32_t* height) {
+    TLog_Headless* headless = (TLog_Headless*) backend;
+    *width = headless->width;
+    *height = headless->height;
+}
+
+static void moveCursor(TLog_Backend* backend, uint32_t y, uint32_t x) {
+    TLog_Headless* headless = (TLog_Headless*) backend;
+    headless->cursorX = x < headless->width ? x : headless->width - 1;
+    headless->cursorY = y < headless->height ? y : headless->height - 1;
+
+    /* ESC [ row ; column H */
+    headless->bytesWritten += 4 + countDigits(y + 1) + countDigits(x + 1);
+}
+
+static void addText(TLog_Backend* backend, const char* text, size_t len) {
+    TLog_Headless* headless = (TLog_Headless*) backend;
+    TLog_Headless_Cell* row = &headless->cells[(size_t) headless->cursorY * headless->width];
+    const char* end = text + len;
+
+    headless->bytesWritten += len;
+
+    while (text < end) {
+        const char* next;
+        size_t width = TLog_UTF8_CharWidth(text, end, &next);
+        size_t charLen = next - text;
+        uint32_t x = headless->cursorX;
+
+        /* Text beyond the screen's edge is cut off */
+        if (width == 0) {
+            /* Zero width characters join the character before */
+            if (x > 1 && row[x - 1].len == 0) {
+                --x;
+            }
+            if (x > 0 && row[x - 1].len + charLen <= MAX_CELL_LEN) {
+                TLog_Headless_Cell* cell = &row[x - 1];
+                memcpy(&cell->ch[cell->len], text, charLen);
+                cell->len += charLen;
+            }
+        } else if (x + width <= headless->width) {
+            breakWide(headless, row, x);
+            if (width == 2) {
+                breakWide(headless, row, x + 1);
+                row[x + 1].len = 0;
+                row[x + 1].attribute = headless->attribute;
+            }
+            TLog_Headless_Cell* cell = &row[x];
+            memcpy(cell->ch, text, charLen);
+            cell->len = charLen;
+            cell->attribute = headless->attribute;
+            headless->cursorX += width;
+        } else {
+            headless->cursorX = headless->width;
+        }
+
+        text = next;
+    }
+}
+
+static void setAttribute(TLog_Backend* backend, TLog_Attribute attribute) {
+    TLog_Headless* headless = (TLog_Headless*) backend;
+    headless->attribute = attribute;
+
+    /* ESC [ 0 m or ESC [ 7 m */
+    headless->bytesWritten += 4;
+}
+
+static void clearToEol(TLog_Backend* backend) {
+    TLog_Headless* headless = (TLog_Headless*) backend;
+    if (headless->cursorX < headless->width) {
+        breakWide(headless, &headless->cells[(size_t) headless->cursorY * headless->width], headless->cursorX);
+        blank(&headless->cells[(size_t) headless->cursorY * headless->width + headless->cursorX],
+                headless->width - headless->cursorX);
+    }
+
+    /* ESC [ K */
+    headless->bytesWritten += 3;
+}
+
+static void clearScreen(TLog_Backend* backend) {
+    TLog_Headless* headless = (TLog_Headless*) backend;
+    blank(headless->cells, (size_t) headless->width * headless->height);
+    headless->cursorX = headless->cursorY = 0;
+
+    /* ESC [ H ESC [ 2 J */
+    headless->bytesWritten += 7;
+}
+
+static void scrollScreen(TLog_Backend* backend, int lines) {
+    TLog_Headless* headless = (TLog_Headless*) backend;
+    size_t width = headless->width;
+    size_t height = headless->height;
+    size_t count = lines < 0 ? (size_t) -lines : (size_t) lines;
+    count = count < height ? count : height;
+
+    if (lines > 0) {
+        memmove(headless->cells, &headless->cells[count * width],
+                sizeof(TLog_Headless_Cell) * (height - count) * width);
+        blank(&headless->cells[(height - count) * width], count * width);
+    } else if (lines < 0) {
+        memmove(&headless->cells[count * width], headless->cells,
+                sizeof(TLog_Headless_Cell) * (height - count) * width);
+        blank(headless->cells, count * width);
+    }
+
+    /* ESC [ lines S or ESC [ lines T */
+    headless->bytesWritten += 3 + countDigits(count);
+}
+
+static void flush(TLog_Backend* backend) {
+    ++((TLog_Headless*) backend)->flushCount;
+}
+
+static size_t getBytesWritten(TLog_Backend* backend) {
+    return ((TLog_Headless*) backend)->bytesWritten;
+}
+
+static void getInput(TLog_Backend* backend, int timeout, TLog_Input* input) {
+    TLog_Headless* headless = (TLog_Headless*) backend;
+    if (headless->nextInput < headless->input->nelts) {
+        *input = APR_ARRAY_IDX(headless->input, headless->nextInput, TLog_Input);
+        ++headless->nextInput;
+
+        if (input->type == TLOG_INPUT_RESIZE) {
+            resize(headless, APR_ARRAY_IDX(headless->sizes, headless->nextSize, uint32_t),
+                    APR_ARRAY_IDX(headless->sizes, headless->nextSize + 1, uint32_t));
+            headless->nextSize += 2;
+            if (headless->nextSize == headless->sizes->nelts) {
+                apr_array_clear(headless->sizes);
+                headless->nextSize = 0;
+            }
+        }
+
+        /* Reuse the drained queue's memory */
+        if (headless->nextInput == headless->input->nelts) {
+            apr_array_clear(headless->input);
+            headless->nextInput = 0;
+        }
+    } else {
+        /* Waiting for input that will never come ends it */
+        input->type = timeout != 0 ? TLOG_INPUT_END : TLOG_INPUT_NONE;
+    }
+}
+
+static void resize(TLog_Headless* headless, uint32_t width, uint32_t height) {
+    TLog_Headless_Cell* cells = headless->cells;
+    size_t count = (size_t) width * height;
+
+    /* Screens going back and forth between sizes reuse their cells */
+    if (count > headless->capacity) {
+        cells = apr_palloc(headless->pool, sizeof(TLog_Headless_Cell) * count);
+        if (!cells) {
+            return;
+        }
+        headless->capacity = count;
+    }
+
+    /* Rows move down in place when the screen gets wider, so move those from the bottom up */
+    uint32_t keptWidth = width < headless->width ? width : headless->width;
+    uint32_t keptHeight = height < headless->height ? height : headless->height;
+    bool wider = width > headless->width;
+    for (uint32_t i = 0; i < keptHeight; ++i) {
+        size_t y = wider ? keptHeight - 1 - i : i;
+        memmove(&cells[y * width], &headless->cells[y * headless->width], sizeof(TLog_Headless_Cell) * keptWidth);
+        blank(&cells[y * width + keptWidth], width - keptWidth);
+    }
+    blank(&cells[(size_t) keptHeight * width], (size_t) (height - keptHeight) * width);
+
+    headless->cells = cells;
+    headless->width = width;
+    headless->height = height;
+    headless->cursorX = headless->cursorX < width ? headless->cursorX : width - 1;
+    headless->cursorY = headless->cursorY < height ? headless->cursorY : height - 1;
+}
+
+static void blank(TLog_Headless_Cell* cells, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        cells[i].ch[0] = ' ';
+        cells[i].len = 1;
+        cells[i].attribute = TLOG_ATTRIBUTE_NORMAL;
+    }
+}
+
+static void breakWide(TLog_Headless* headless, TLog_Headless_Cell* row, uint32_t x) {
+    if (row[x].len == 0 && x > 0) {
+        blank(&row[x - 1], 1);
+    }
+    if (x + 1 < headless->width && row[x + 1].len == 0) {
+        blank(&row[x + 1], 1);
+    }
+}
+
+static size_t countDigits(size_t n) {
+    size_t digits = 1;
+    for (; n >= 10; n /= 10) {
+        ++digits;
+    }
+    return digits;
+}
@@ -0,0 +1,341 @@
+/**
+ * @file history.c
+ * @author Tobias Heukäufer
+ * @brief Undo history implementation.
+ */
+
+#include "history.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/** @brief Initial number of edits there is room for. */
+#define INIT_EDIT_CAPACITY 16
+
+/** @brief Initial size of the text in bytes. */
+#define INIT_TEXT_CAPACITY 256
+
+/** @brief TRUE if a byte continues a character, or FALSE if it starts one. */
+#define IS_CONTINUATION(b) (((b) & 0xc0) == 0x80)
+
+/**
+ * @brief Frees a history's memory.
+ *
+ * @param data The history
+ * @return Always APR_SUCCESS
+ */
+static apr_status_t freeHistory(void* data);
+
+/**
+ * @brief Returns the edit an insertion or deletion goes on, starting one if the last one can't go on.
+ *
+ * Edits undone can't be redone anymore.
+ *
+ * @param history The history
+ * @param kind Kind of edit
+ * @param position Index of the character inserted or deleted in codepoints
+ * @return The edit, or NULL on error
+ */
+static TLog_History_Edit* getEdit(TLog_History* history, TLog_History_Kind kind, size_t position);
+
+/**
+ * @brief Appends a string's range to the last edit.
+ *
+ * @param history The history
+ * @param str The string
+ * @param from First byte position of the range
+ * @param to The byte position after the range
+ * @param count Number of characters in the range
+ * @return 0 on success, or else on error
+ */
+static int append(TLog_History* history, TLog_String* str, size_t from, size_t to, size_t count);
+
+/**
+ * @brief Drops the oldest edits while the edits take more than the budget.
+ *
+ * To not move the edits on every insertion, edits are dropped until they take three quarters
+ * of the budget.
+ *
+ * @param history The history
+ */
+static void trim(TLog_History* history);
+
+/**
+ * @brief Reverses the order of characters, keeping each character's bytes in order.
+ *
+ * @param start First byte
+ * @param end The byte after the last byte
+ */
+static void reverseChars(char* start, char* end);
+
+void TLog_History_Init(TLog_History* history, apr_pool_t* pool, size_t budget) {
+    memset(history, 0, sizeof(TLog_History));
+    history->budget = budget;
+
+    apr_pool_cleanup_register(pool, history, freeHistory, apr_pool_cleanup_null);
+}
+
+void TLog_History_SetBudget(TLog_History* history, size_t budget) {
+    history->budget = budget;
+    if (budget == 0) {
+        TLog_History_Clear(history);
+    } else {
+        trim(history);
+    }
+}
+
+void TLog_History_Clear(TLog_History* history) {
+    free(history->edits);
+    free(history->text);
+
+    history->edits = NULL;
+    history->capacity = history->count = history->current = 0;
+    history->text = NULL;
+    history->len = history->textCapacity = 0;
+    history->open = false;
+}
+
+void TLog_History_Break(TLog_History* history) {
+    history->open = false;
+}
+
+void TLog_History_AddInsert(TLog_History* history, TLog_String* str, size_t from) {
+    if (history->budget == 0 || from >= str->utf8cursor) {
+        return;
+    }
+
+    /* The inserted characters end at the cursor, i.e. right before the gap */
+    if (!getEdit(history, TLOG_HISTORY_INSERT, from)
+            || append(history, str, TLog_String_Offset(str, from), str->gapStart, str->utf8cursor - from)) {
+        TLog_History_Clear(history);
+    }
+    trim(history);
+}
+
+bool TLog_History_DeleteBackward(TLog_History* history, TLog_String* str) {
+    if (str->utf8cursor == 0) {
+        return false;
+    }
+
+    if (history->budget > 0) {
+        size_t position = str->utf8cursor - 1;
+        if (!getEdit(history, TLOG_HISTORY_DELETE_BACKWARD, position)
+                || append(history, str, TLog_String_Offset(str, position), str->gapStart, 1)) {
+            TLog_History_Clear(history);
+        }
+    }
+
+    TLog_String_DeleteBackward(str);
+    trim(history);
+
+    return true;
+}
+
+bool TLog_History_DeleteForward(TLog_History* history, TLog_String* str) {
+    if (str->utf8cursor == str->utf8len) {
+        return false;
+    }
+
+    if (history->budget > 0) {
+        size_t position = str->utf8cursor;
+        if (!getEdit(history, TLOG_HISTORY_DELETE_FORWARD, position)
+                || append(history, str, str->gapStart, TLog_String_Offset(str, position + 1), 1)) {
+            TLog_History_Clear(history);
+        }
+    }
+
+    TLog_String_DeleteForward(str);
+    trim(history);
+
+    return true;
+}
+
+bool TLog_History_Undo(TLog_History* history, TLog_String* str) {
+    if (history->current == 0) {
+        return false;
+    }
+
+    TLog_History_Edit* edit = &history->edits[history->current - 1];
+    char* text = history->text + edit->start;
+
+    TLog_String_MoveCursor(str, edit->position);
+    if (edit->kind == TLOG_HISTORY_INSERT) {
+        TLog_String_Delete(str, edit->utf8len);
+    } else if (edit->kind == TLOG_HISTORY_DELETE_FORWARD) {
+        if (TLog_String_Insert(str, text, edit->len)) {
+            return false;
+        }
+        TLog_String_MoveCursor(str, edit->position);
+    } else {
+        /* Put the characters back in order for inserting them at once, and back again for redoing */
+        reverseChars(text, text + edit->len);
+        int status = TLog_String_Insert(str, text, edit->len);
+        reverseChars(text, text + edit->len);
+        if (status) {
+            return false;
+        }
+    }
+
+    --history->current;
+    history->open = false;
+
+    return true;
+}
+
+bool TLog_History_Redo(TLog_History* history, TLog_String* str) {
+    if (history->current == history->count) {
+        return false;
+    }
+
+    TLog_History_Edit* edit = &history->edits[history->current];
+
+    TLog_String_MoveCursor(str, edit->position);
+    if (edit->kind == TLOG_HISTORY_INSERT) {
+        if (TLog_String_Insert(str, history->text + edit->start, edit->len)) {
+            return false;
+        }
+    } else {
+        TLog_String_Delete(str, edit->utf8len);
+    }
+
+    ++history->current;
+    history->open = false;
+
+    return true;
+}
+
+static apr_status_t freeHistory(void* data) {
+    TLog_History_Clear(data);
+    return APR_SUCCESS;
+}
+
+static TLog_History_Edit* getEdit(TLog_History* history, TLog_History_Kind kind, size_t position) {
+    /* A new edit takes the place of those undone */
+    if (history->current < history->count) {
+        history->count = history->current;
+        history->len = history->count > 0
+                ? history->edits[history->count - 1].start + history->edits[history->count - 1].len : 0;
+        history->open = false;
+    }
+
+    if (history->open && history->count > 0) {
+        TLog_History_Edit* last = &history->edits[history->count - 1];
+        if (last->kind == kind) {
+            if (kind == TLOG_HISTORY_INSERT && position == last->position + last->utf8len) {
+                return last;
+            } else if (kind == TLOG_HISTORY_DELETE_BACKWARD && position + 1 == last->position) {
+                last->position = position;
+                return last;
+            } else if (kind == TLOG_HISTORY_DELETE_FORWARD && position == last->position) {
+                return last;
+            }
+        }
+    }
+
+    if (history->count == history->capacity) {
+        size_t capacity = history->capacity > 0 ? history->capacity * 2 : INIT_EDIT_CAPACITY;
+        TLog_History_Edit* edits = realloc(history->edits, sizeof(TLog_History_Edit) * capacity);
+        if (!edits) {
+            return NULL;
+        }
+        history->edits = edits;
+        history->capacity = capacity;
+    }
+
+    TLog_History_Edit* edit = &history->edits[history->count++];
+    edit->kind = kind;
+    edit->position = position;
+    edit->utf8len = 0;
+    edit->start = history->len;
+    edit->len = 0;
+
+    history->current = history->count;
+    history->open = true;
+
+    return edit;
+}
+
+static int append(TLog_History* history, TLog_String* str, size_t from, size_t to, size_t count) {
+    if (history->textCapacity - history->len < to - from) {
+        /* Don't grow much beyond the budget, which the text is trimmed to right after */
+        size_t capacity = history->textCapacity > 0 ? history->textCapacity : INIT_TEXT_CAPACITY;
+        while (capacity - history->len < to - from) {
+            capacity *= 2;
+        }
+        size_t needed = history->len + (to - from);
+        capacity = capacity < history->budget ? capacity : (needed > history->budget ? needed : history->budget);
+
+        char* text = realloc(history->text, capacity);
+        if (!text) {
+            return -1;
+        }
+        history->text = text;
+        history->textCapacity = capacity;
+    }
+
+    const char* first;
+    const char* second;
+    size_t firstLen, secondLen;
+    TLog_String_GetRange(str, from, to, &first, &firstLen, &second, &secondLen);
+    memcpy(history->text + history->len, first, firstLen);
+    memcpy(history->text + history->len + firstLen, second, secondLen);
+    history->len += to - from;
+
+    TLog_History_Edit* edit = &history->edits[history->count - 1];
+    edit->utf8len += count;
+    edit->len += to - from;
+
+    return 0;
+}
+
+static void trim(TLog_History* history) {
+    size_t usage = history->len + sizeof(TLog_History_Edit) * history->count;
+    if (usage <= history->budget) {
+        return;
+    }
+
+    size_t target = history->budget - history->budget / 4;
+    size_t dropped = 0;
+    while (dropped < history->count && usage > target) {
+        usage -= history->edits[dropped].len + sizeof(TLog_History_Edit);
+        ++dropped;
+    }
+
+    /* Edits undone can only be redone after those before them */
+    if (dropped > history->current || dropped == history->count) {
+        TLog_History_Clear(history);
+        return;
+    }
+
+    size_t start = history->edits[dropped].start;
+    history->count -= dropped;
+    history->current -= dropped;
+    history->len -= start;
+    memmove(history->edits, history->edits + dropped, sizeof(TLog_History_Edit) * history->count);
+    memmove(history->text, history->text + start, history->len);
+    for (size_t i = 0; i < history->count; ++i) {
+        history->edits[i].start -= start;
+    }
+}
+
+static void reverseChars(char* start, char* end) {
+    /* Reverse all bytes, then each character's bytes, whose first byte now comes last */
+    for (char* a = start, * b = end - 1; a < b; ++a, --b) {
+        char tmp = *a;
+        *a = *b;
+        *b = tmp;
+    }
+
+    for (char* ch = start; ch < end;) {
+        char* last = ch;
+        while (last + 1 < end && IS_CONTINUATION(*last)) {
+            ++last;
+        }
+        for (char* a = ch, * b = last; a < b; ++a, --b) {
+            char tmp = *a;
+            *a = *b;
+            *b = tmp;
+        }
+        ch = last + 1;
+    }
+}
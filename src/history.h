@@ -0,0 +1,149 @@
+/**
+ * @file history.h
+ * @author Tobias Heukäufer
+ * @brief An undo history of a string's edits.
+ */
+
+#ifndef TLOG_SRC_HISTORY_H
+#define TLOG_SRC_HISTORY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include <apr_pools.h>
+
+#include "string.h"
+
+/** @brief Kinds of edits. */
+typedef enum tlog_history_kind {
+    /** @brief Text was inserted. */
+    TLOG_HISTORY_INSERT,
+    /** @brief Characters before the cursor were deleted, the text holds them last one first. */
+    TLOG_HISTORY_DELETE_BACKWARD,
+    /** @brief Characters after the cursor were deleted. */
+    TLOG_HISTORY_DELETE_FORWARD
+} TLog_History_Kind;
+
+/** @brief An edit, i.e. a run of characters inserted or deleted in a row. */
+typedef struct tlog_history_edit {
+    /** @brief Kind of edit. */
+    TLog_History_Kind kind;
+    /** @brief Index of the first character inserted or deleted in codepoints. */
+    size_t position;
+    /** @brief Number of characters. */
+    size_t utf8len;
+    /** @brief The characters' first byte in the history's text. */
+    size_t start;
+    /** @brief Length of the characters in bytes. */
+    size_t len;
+} TLog_History_Edit;
+
+/**
+ * @brief An undo history.
+ *
+ * The history records edits, not copies of the string, so an edit costs the characters it
+ * inserted or deleted. Characters typed or deleted in a row are one edit, undone at once. Once
+ * the edits take more than the budget, the oldest ones are dropped.
+ */
+typedef struct tlog_history {
+    /** @brief Edits, oldest first (allocated with malloc). */
+    TLog_History_Edit* edits;
+    /** @brief Number of edits there is room for. */
+    size_t capacity;
+    /** @brief Number of edits. */
+    size_t count;
+    /** @brief Number of edits done, those after them were undone and can be redone. */
+    size_t current;
+
+    /** @brief The edits' characters, in the order of the edits (allocated with malloc). */
+    char* text;
+    /** @brief Length of the characters in bytes. */
+    size_t len;
+    /** @brief Size of the text in bytes. */
+    size_t textCapacity;
+
+    /** @brief Maximum number of bytes the edits take, 0 records none. */
+    size_t budget;
+    /** @brief Wether the last edit may go on. */
+    bool open;
+} TLog_History;
+
+/**
+ * @brief Initializes an empty history.
+ *
+ * The history's memory is freed on the pool's cleanup.
+ *
+ * @param history The history
+ * @param pool Memory pool
+ * @param budget Maximum number of bytes the edits take, counting their characters and records
+ */
+void TLog_History_Init(TLog_History* history, apr_pool_t* pool, size_t budget);
+
+/**
+ * @brief Sets a history's budget, dropping the oldest edits that don't fit anymore.
+ *
+ * @param history The history
+ * @param budget Maximum number of bytes the edits take, 0 drops all edits and records none
+ */
+void TLog_History_SetBudget(TLog_History* history, size_t budget);
+
+/**
+ * @brief Drops all edits.
+ *
+ * @param history The history
+ */
+void TLog_History_Clear(TLog_History* history);
+
+/**
+ * @brief Ends the last edit, so the next one is undone on its own (e.g. when the cursor moved).
+ *
+ * @param history The history
+ */
+void TLog_History_Break(TLog_History* history);
+
+/**
+ * @brief Records that a string's characters from an index up to its cursor were inserted.
+ *
+ * @param history The history
+ * @param str The string, after the insertion
+ * @param from Index of the first inserted character in codepoints
+ */
+void TLog_History_AddInsert(TLog_History* history, TLog_String* str, size_t from);
+
+/**
+ * @brief Deletes the character before a string's cursor, recording it.
+ *
+ * @param history The history
+ * @param str The string
+ * @return TRUE if a character was deleted, or FALSE else
+ */
+bool TLog_History_DeleteBackward(TLog_History* history, TLog_String* str);
+
+/**
+ * @brief Deletes the character after a string's cursor, recording it.
+ *
+ * @param history The history
+ * @param str The string
+ * @return TRUE if a character was deleted, or FALSE else
+ */
+bool TLog_History_DeleteForward(TLog_History* history, TLog_String* str);
+
+/**
+ * @brief Undoes the last edit done, moving the cursor to where it was.
+ *
+ * @param history The history
+ * @param str The string, as the edits left it
+ * @return TRUE if an edit was undone, or FALSE if there is none (or on error)
+ */
+bool TLog_History_Undo(TLog_History* history, TLog_String* str);
+
+/**
+ * @brief Redoes the first edit undone, moving the cursor to where the edit left it.
+ *
+ * @param history The history
+ * @param str The string, as the undos left it
+ * @return TRUE if an edit was redone, or FALSE if there is none (or on error)
+ */
+bool TLog_History_Redo(TLog_History* history, TLog_String* str);
+
+#endif
@@ -6,29 +6,160 @@
 
 #include "../include/label.h"
 
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
-#include <apr_tables.h>
-#include <apr_strings.h>
-
-#include <ncurses.h>
+#include <apr_atomic.h>
+#include <apr_file_io.h>
+#include <apr_mmap.h>
+#include <apr_thread_proc.h>
 
+#include "../include/draw.h"
+#include "../include/tobylog.h"
 #include "utf8.h"
 
-/** @brief Initial capacity of a label's line meta buffer. */
-#define INIT_LINE_CAPACITY 4
+/** @brief Initial capacity of a label's checkpoint buffer. */
+#define INIT_CHECKPOINT_CAPACITY 4
+
+/** @brief Number of lines between two checkpoints, a power of 2. */
+#define CHECKPOINT_INTERVAL 64
+
+/** @brief Number of layouts (i.e. maximum widths) a label keeps. */
+#define LAYOUT_CACHE_SIZE 4
+
+/** @brief Initial capacity of a label's break opportunity buffer. */
+#define INIT_BREAKS_CAPACITY 64
+
+/** @brief Maximum length of a segment entry, a tag and three varints of up to 10 bytes. */
+#define MAX_SEGMENT_LEN 31
+
+/** @brief TRUE if a byte continues a character, or FALSE if it starts one. */
+#define IS_CONTINUATION(b) (((b) & 0xc0) == 0x80)
+
+/** @brief Length in bytes from which asynchronous labels are laid out on a worker thread. */
+#define ASYNC_MIN_LEN (64 * 1024)
+
+/** @brief Number of bytes a worker thread lays out between looking wether it was cancelled. */
+#define JOB_CHECK_INTERVAL (64 * 1024)
+
+/** @brief Height of a label while a worker thread lays it out. */
+#define PLACEHOLDER_HEIGHT 1
+
+/** @brief Placeholder of a label while a worker thread lays it out, followed by the percentage done. */
+#define PLACEHOLDER_LOADING "Loading... "
+
+/** @brief Placeholder of a label whose worker thread failed (e.g. as the text isn't UTF-8). */
+#define PLACEHOLDER_FAILED "The text can't be shown"
+
+/** @brief State of a job whose worker thread is laying out. */
+#define JOB_RUNNING 0
+/** @brief State of a job whose layout is done. */
+#define JOB_DONE 1
+/** @brief State of a job that failed or was cancelled. */
+#define JOB_FAILED 2
+
+/*
+ * Break opportunities are stored as one entry per segment (see TLog_Label_Segment):
+ * - 1WWWWWSN: a printable ASCII word of W (< 32) characters, followed by S (0 or 1) spaces
+ * - 01....SN: a word of 3 bytes taking 2 columns (like a CJK character), followed by S spaces
+ * - 0000000N: followed by varints of the word's width, its length minus its width, and the spaces
+ * N is set if a newline ends the segment.
+ */
+/** @brief Tag of a printable ASCII segment entry. */
+#define SEGMENT_ASCII 0x80
+/** @brief Tag of a wide character segment entry. */
+#define SEGMENT_WIDE 0x40
+/** @brief Flag of a segment entry whose word is followed by a space. */
+#define SEGMENT_SPACE 0x02
+/** @brief Flag of a segment entry ended by a newline. */
+#define SEGMENT_NEWLINE 0x01
 
 /* Thanks! https://stackoverflow.com/a/3599170 */
 /** @brief Marks unused function parameters to prevent unused warnings. */
 #define UNUSED(x) (void)(x)
 
-/** @brief A label's line's start and ending. */
-typedef struct tlog_label_line {
-    /** @brief First character in line. */
-    char* start;
-    /** @brief The character after the last character in line. */
-    char* end;
-} TLog_Label_Line;
+/**
+ * @brief A label's lines for a maximum width.
+ * 
+ * Lines aren't stored, only where every @ref CHECKPOINT_INTERVAL th line starts,
+ * so a label of millions of lines lays out in little memory and draws any line
+ * after breaking at most @ref CHECKPOINT_INTERVAL lines.
+ * 
+ * Layouts outlive runs, so their checkpoints are reallocated as they grow and freed with the label's pool,
+ * rather than leaving every outgrown buffer in the pool.
+ */
+typedef struct tlog_label_layout {
+    /** @brief Maximum width the lines were laid out for, or 0 if unused. */
+    uint32_t maxWidth;
+    /** @brief Value of the label's use counter when last used. */
+    size_t lastUse;
+    /** @brief Number of lines. */
+    uint32_t height;
+    /** @brief Starts of every @ref CHECKPOINT_INTERVAL th line. */
+    const char** checkpoints;
+    /** @brief Number of checkpoints. */
+    size_t checkpointCount;
+    /** @brief Number of checkpoints there is room for. */
+    size_t checkpointCapacity;
+
+    /** @brief Index of the line after the last drawn line. */
+    uint32_t nextY;
+    /** @brief Start of the line after the last drawn line. */
+    const char* nextStart;
+} TLog_Label_Layout;
+
+/**
+ * @brief A word, the spaces following it and possibly a newline ending it.
+ * 
+ * Word wrapped lines break between segments, or within words wider than a line.
+ * Words end at spaces and newlines, after hyphens and around wide characters.
+ */
+typedef struct tlog_label_segment {
+    /** @brief Length of the word in bytes. */
+    size_t wordLen;
+    /** @brief Number of columns the word takes. */
+    size_t wordWidth;
+    /** @brief Number of spaces following the word. */
+    size_t spaces;
+    /** @brief Wether a newline ends the segment. */
+    bool newline;
+} TLog_Label_Segment;
+
+/**
+ * @brief A layout made on a worker thread.
+ * 
+ * The worker only touches the layout and the label's segment entries, which the label leaves alone
+ * until the worker is joined.
+ */
+typedef struct tlog_label_job {
+    /** @brief Pool the job and its thread were made from. */
+    apr_pool_t* pool;
+    /** @brief The worker thread. */
+    apr_thread_t* thread;
+    /** @brief Pool of the run the job was started in, see @ref TLog_GetLayoutPool(). */
+    apr_pool_t* runPool;
+    /** @brief The label. */
+    struct tlog_label* label;
+    /** @brief The layout being made. */
+    TLog_Label_Layout* layout;
+    /** @brief Maximum width the layout is made for. */
+    uint32_t maxWidth;
+
+    /** @brief Number of bytes to go through, the text once per pass (checking, segmenting, laying out). */
+    size_t total;
+    /** @brief Number of bytes gone through by passes before the current one. */
+    size_t base;
+    /** @brief Number of bytes gone through when last looked wether cancelled. */
+    size_t polled;
+
+    /** @brief State, @ref JOB_RUNNING, @ref JOB_DONE or @ref JOB_FAILED. */
+    volatile apr_uint32_t state;
+    /** @brief Set to make the worker stop. */
+    volatile apr_uint32_t cancelled;
+    /** @brief Percentage of the bytes gone through. */
+    volatile apr_uint32_t percent;
+} TLog_Label_Job;
 
 struct tlog_label {
     /** @brief Widget data. */
@@ -37,16 +168,305 @@ struct tlog_label {
     /** @brief Memory pool */
     apr_pool_t* pool;
 
-    /** @brief Text. */
-    char* text;
+    /** @brief Text, not NUL-terminated if borrowed. */
+    const char* text;
+    /** @brief Text's length in bytes. */
+    size_t len;
+    /** @brief Buffer holding the text if copied, reused by later texts. */
+    char* copy;
+    /** @brief Size of the copy buffer in bytes. */
+    size_t copyCapacity;
+    /** @brief Wether the text is known to be UTF-8, else it's checked when first laid out. */
+    bool checked;
+
+    /** @brief Prefered width, valid if @ref tlog_label::hasPreferedWidth is set. */
+    uint32_t preferedWidth;
+    /** @brief Wether the prefered width was calculated for the current text. */
+    bool hasPreferedWidth;
+
+    /** @brief Wether lines break between words (true) or anywhere (false). */
+    bool wordWrap;
+    /** @brief Segment entries of the text, valid if @ref tlog_label::hasBreaks is set. */
+    uint8_t* breaks;
+    /** @brief Length of the segment entries in bytes. */
+    size_t breaksLen;
+    /** @brief Size of the segment entry buffer in bytes. */
+    size_t breaksCapacity;
+    /** @brief Wether the segment entries were made for the current text. */
+    bool hasBreaks;
+
+    /** @brief Recently used layouts. */
+    TLog_Label_Layout layouts[LAYOUT_CACHE_SIZE];
+    /** @brief Current layout. */
+    TLog_Label_Layout* layout;
+    /** @brief Counter of layout uses. */
+    size_t uses;
 
-    /** @brief Line starts and endings. */
-    apr_array_header_t* lines;
+    /** @brief Wether large texts are laid out on a worker thread. */
+    bool async;
+    /** @brief Layout made on a worker thread, or NULL. */
+    TLog_Label_Job* job;
+    /** @brief Maximum width the label was last laid out for. */
+    uint32_t maxWidth;
+    /** @brief Percentage done shown by the placeholder. */
+    uint32_t shownPercent;
+    /** @brief Wether the last worker thread failed. */
+    bool jobFailed;
+
+    /** @brief Number of calculations answered by cache. */
+    size_t cacheHits;
+    /** @brief Number of calculations not answered by cache. */
+    size_t cacheMisses;
 };
 
+/**
+ * @brief Creates a label.
+ * 
+ * @param pool Pool to handle the label
+ * @param text Label's text
+ * @param len Length of the text in bytes
+ * @param copy TRUE to copy the text, or FALSE to borrow it
+ * @param check TRUE to check the text is UTF-8 now, or FALSE to leave it to the first layout
+ * @return A new label, or NULL on error
+ */
+static TLog_Label* create(apr_pool_t* pool, const char* text, size_t len, bool copy, bool check);
+
+/**
+ * @brief Creates a label showing a file's content.
+ * 
+ * @param pool Pool to handle the label and the mapping
+ * @param path Path of the file
+ * @param async TRUE to make an asynchronous label, its text checked by the worker thread
+ * @return A new label, or NULL on error
+ */
+static TLog_Label* createFromFile(apr_pool_t* pool, const char* path, bool async);
+
+/**
+ * @brief Sets a label's text and drops its cached calculations.
+ * 
+ * @param label The label
+ * @param text The text
+ * @param len Length of the text in bytes
+ * @param copy TRUE to copy the text, or FALSE to borrow it
+ * @param check TRUE to check the text is UTF-8 now, or FALSE to leave it to the first layout
+ * @return TRUE on success, or FALSE on error
+ */
+static bool setText(TLog_Label* label, const char* text, size_t len, bool copy, bool check);
+
+/**
+ * @brief Frees a label's buffers.
+ * 
+ * @param data The label
+ * @return Always APR_SUCCESS
+ */
+static apr_status_t freeBuffers(void* data);
+
+/**
+ * @brief Drops a label's cached layouts.
+ * 
+ * @param label The label
+ */
+static void dropLayouts(TLog_Label* label);
+
+/**
+ * @brief Returns a label's layout for a maximum width, preferably a cached one.
+ * 
+ * @param label The label
+ * @param maxWidth Maximum width, at least 1
+ * @param async TRUE to make a missing layout on a worker thread, if one can be started
+ * @return The layout, or NULL on error or if a worker thread makes it
+ */
+static TLog_Label_Layout* getLayout(TLog_Label* label, uint32_t maxWidth, bool async);
+
+/**
+ * @brief Makes a label's layout, and its segment entries if needed.
+ * 
+ * @param label The label
+ * @param layout The layout, its maximum width set, marked unused on failure
+ * @param job The job making the layout, or NULL if made on the calling thread
+ * @return TRUE on success, or FALSE on error or if the job was cancelled
+ */
+static bool makeLayout(TLog_Label* label, TLog_Label_Layout* layout, TLog_Label_Job* job);
+
+/**
+ * @brief Counts a label's lines and notes its checkpoints.
+ * 
+ * @param label The label
+ * @param layout The layout to store the height and checkpoints in, marked unused if cancelled
+ * @param job The job making the layout, or NULL
+ */
+static void layOut(TLog_Label* label, TLog_Label_Layout* layout, TLog_Label_Job* job);
+
+/**
+ * @brief Counts a label's word wrapped lines and notes its checkpoints.
+ * 
+ * Only walks the label's segment entries, not its text (but for words wider than a line).
+ * 
+ * @param label The label
+ * @param layout The layout to store the height and checkpoints in, marked unused if cancelled
+ * @param job The job making the layout, or NULL
+ */
+static void layOutWords(TLog_Label* label, TLog_Label_Layout* layout, TLog_Label_Job* job);
+
+/**
+ * @brief Counts a line, noting it as checkpoint if due.
+ * 
+ * @param layout The layout
+ * @param height The number of lines so far, incremented
+ * @param start The line's first byte
+ */
+static void addLine(TLog_Label_Layout* layout, uint64_t* height, const char* start);
+
+/**
+ * @brief Notes a checkpoint, growing the layout's buffer if needed.
+ * 
+ * If the buffer can't grow, the layout is marked unused (its maximum width set to 0).
+ * 
+ * @param layout The layout
+ * @param start The checkpoint's line's first byte
+ */
+static void pushCheckpoint(TLog_Label_Layout* layout, const char* start);
+
+/**
+ * @brief Checks a label's text is UTF-8.
+ * 
+ * @param label The label
+ * @param job The job checking it, or NULL
+ * @return TRUE if it is, or FALSE if not or if the job was cancelled
+ */
+static bool checkText(TLog_Label* label, TLog_Label_Job* job);
+
+/**
+ * @brief Makes the segment entries of a label's text.
+ * 
+ * @param label The label
+ * @param job The job making them, or NULL
+ * @return TRUE on success, or FALSE on error or if the job was cancelled
+ */
+static bool findBreaks(TLog_Label* label, TLog_Label_Job* job);
+
+/**
+ * @brief Starts making a label's layout on a worker thread.
+ * 
+ * The job is stopped with the run, see @ref TLog_GetLayoutPool().
+ * 
+ * @param label The label
+ * @param layout The layout, its maximum width set
+ * @return TRUE if the worker was started, or FALSE else
+ */
+static bool startJob(TLog_Label* label, TLog_Label_Layout* layout);
+
+/**
+ * @brief Makes a job's layout, run by its worker thread.
+ * 
+ * @param thread The thread
+ * @param data The job
+ * @return Nothing
+ */
+static void* APR_THREAD_FUNC runJob(apr_thread_t* thread, void* data);
+
+/**
+ * @brief Tells how far a job got, and wether it was cancelled.
+ * 
+ * Only looks every @ref JOB_CHECK_INTERVAL bytes, so it may be called often.
+ * 
+ * @param job The job, or NULL for layouts made on the calling thread
+ * @param done Number of bytes gone through by the current pass
+ * @return TRUE if the job was cancelled, or FALSE else
+ */
+static bool isCancelled(TLog_Label_Job* job, size_t done);
+
+/**
+ * @brief Waits for a label's worker thread to end, keeping its layout if it's done.
+ * 
+ * @param label The label
+ * @param cancel TRUE to make the worker stop first, or FALSE to wait for it to finish
+ */
+static void stopJob(TLog_Label* label, bool cancel);
+
+/**
+ * @brief Cancels a label's worker thread when its run ends.
+ * 
+ * @param data The label
+ * @return Always APR_SUCCESS
+ */
+static apr_status_t cancelJob(void* data);
+
+/**
+ * @brief Splits a segment off a text.
+ * 
+ * @param start The segment's first byte
+ * @param end The byte after the text's last byte
+ * @param limit Width beyond which to stop reading the word, leaving the rest of the segment unread
+ * @param segment Where to store the segment
+ * @return The next segment's first byte
+ */
+static const char* nextSegment(const char* start, const char* end, size_t limit, TLog_Label_Segment* segment);
+
+/**
+ * @brief Writes a segment entry.
+ * 
+ * @param entry Where to write the entry, with room for @ref MAX_SEGMENT_LEN bytes
+ * @param segment The segment
+ * @return The byte after the entry
+ */
+static uint8_t* pushSegment(uint8_t* entry, const TLog_Label_Segment* segment);
+
+/**
+ * @brief Reads a segment entry.
+ * 
+ * @param entry The entry's first byte
+ * @param segment Where to store the segment
+ * @return The next entry's first byte
+ */
+static const uint8_t* readSegment(const uint8_t* entry, TLog_Label_Segment* segment);
+
+/**
+ * @brief Writes a varint (7 bits per byte, least significant first) to a segment entry.
+ * 
+ * @param entry Where to write the varint
+ * @param value The value
+ * @return The byte after the varint
+ */
+static uint8_t* pushVarint(uint8_t* entry, size_t value);
+
+/**
+ * @brief Reads a varint from segment entries.
+ * 
+ * @param entry The varint's first byte
+ * @param value Where to store the value
+ * @return The byte after the varint
+ */
+static const uint8_t* readVarint(const uint8_t* entry, size_t* value);
+
+/**
+ * @brief Breaks a line off a text.
+ * 
+ * @param start The line's first byte
+ * @param end The byte after the text's last byte
+ * @param maxWidth Maximum width
+ * @param lineEnd Where to store the byte after the line's last byte
+ * @return The next line's first byte
+ */
+static const char* nextLine(const char* start, const char* end, uint32_t maxWidth, const char** lineEnd);
+
+/**
+ * @brief Breaks a word wrapped line off a text.
+ * 
+ * Breaks the same way @ref layOutWords() does.
+ * 
+ * @param start The line's first byte
+ * @param end The byte after the text's last byte
+ * @param maxWidth Maximum width
+ * @param lineEnd Where to store the byte after the line's last byte
+ * @return The next line's first byte
+ */
+static const char* nextWordLine(const char* start, const char* end, uint32_t maxWidth, const char** lineEnd);
+
 static uint32_t getPreferedWidth(TLog_Widget* widget);
 static uint32_t setMaximumWidth(TLog_Widget* widget, uint32_t maxWidth, uint32_t screenHeight);
 static void drawLine(TLog_Widget* widget, uint32_t lineY);
+static void update(TLog_Widget* widget, uint32_t* dirtyStart, uint32_t* dirtyEnd);
 
 /** @brief Label widget functions. */
 static const TLog_Widget_Data TLOG_LABEL_DATA = {
@@ -55,14 +475,73 @@ static const TLog_Widget_Data TLOG_LABEL_DATA = {
     &drawLine,
     NULL,
     NULL,
+    NULL,
+    NULL,
     NULL
 };
 
+/** @brief Functions of labels laid out on worker threads, updated to learn when the worker is done. */
+static const TLog_Widget_Data TLOG_ASYNC_LABEL_DATA = {
+    &getPreferedWidth,
+    &setMaximumWidth,
+    &drawLine,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    &update
+};
+
 TLog_Label* TLog_Label_Create(apr_pool_t* pool, char* text) {
-    if (!text) {
-        goto fail;
+    return text ? create(pool, text, strlen(text), true, true) : NULL;
+}
+
+TLog_Label* TLog_Label_CreateStatic(apr_pool_t* pool, const char* text, size_t len) {
+    return text ? create(pool, text, len, false, true) : NULL;
+}
+
+TLog_Label* TLog_Label_CreateFromFile(apr_pool_t* pool, const char* path) {
+    return createFromFile(pool, path, false);
+}
+
+TLog_Label* TLog_Label_CreateFromFileAsync(apr_pool_t* pool, const char* path) {
+    return createFromFile(pool, path, true);
+}
+
+bool TLog_Label_SetText(TLog_Label* label, char* text) {
+    return label && text && setText(label, text, strlen(text), true, true);
+}
+
+void TLog_Label_SetWordWrap(TLog_Label* label, bool wordWrap) {
+    if (label && label->wordWrap != wordWrap) {
+        stopJob(label, true);
+        label->wordWrap = wordWrap;
+        dropLayouts(label);
+    }
+}
+
+void TLog_Label_SetAsync(TLog_Label* label, bool async) {
+    if (label) {
+        if (!async) {
+            stopJob(label, true);
+        }
+        label->async = async;
+        label->data = async ? &TLOG_ASYNC_LABEL_DATA : &TLOG_LABEL_DATA;
     }
+}
+
+void TLog_Label_GetCacheStats(TLog_Label* label, size_t* hits, size_t* misses) {
+    if (label) {
+        if (hits) {
+            *hits = label->cacheHits;
+        }
+        if (misses) {
+            *misses = label->cacheMisses;
+        }
+    }
+}
 
+static TLog_Label* create(apr_pool_t* pool, const char* text, size_t len, bool copy, bool check) {
     TLog_Label* label = apr_palloc(pool, sizeof(TLog_Label));
     if (!label) {
         goto fail;
@@ -72,16 +551,71 @@ TLog_Label* TLog_Label_Create(apr_pool_t* pool, char* text) {
 
     label->pool = pool;
 
-    label->text = apr_pstrdup(pool, text);
-    if (!label->text) {
+    label->copy = NULL;
+    label->copyCapacity = 0;
+
+    for (size_t i = 0; i < LAYOUT_CACHE_SIZE; ++i) {
+        label->layouts[i].checkpoints = NULL;
+        label->layouts[i].checkpointCapacity = 0;
+    }
+    label->uses = 0;
+
+    label->async = false;
+    label->job = NULL;
+    label->maxWidth = 1;
+    label->shownPercent = 0;
+    label->jobFailed = false;
+
+    label->wordWrap = false;
+    label->breaks = NULL;
+    label->breaksCapacity = 0;
+
+    label->cacheHits = label->cacheMisses = 0;
+
+    apr_pool_cleanup_register(pool, label, freeBuffers, apr_pool_cleanup_null);
+
+    if (!setText(label, text, len, copy, check)) {
         goto fail;
     }
 
-    label->lines = apr_array_make(pool, 0, sizeof(TLog_Label_Line));
-    if (!label->lines) {
+    return label;
+
+    fail:
+    return NULL;
+}
+
+static TLog_Label* createFromFile(apr_pool_t* pool, const char* path, bool async) {
+    apr_file_t* file;
+    if (!path || apr_file_open(&file, path, APR_FOPEN_READ, APR_OS_DEFAULT, pool) != APR_SUCCESS) {
         goto fail;
     }
 
+    /* Empty files can't be mapped, but make empty labels */
+    const char* text = "";
+    size_t len = 0;
+    apr_finfo_t info;
+    apr_status_t status = apr_file_info_get(&info, APR_FINFO_SIZE, file);
+    if (status == APR_SUCCESS && (apr_uint64_t) info.size > SIZE_MAX) {
+        status = APR_ENOMEM;
+    } else if (status == APR_SUCCESS && info.size > 0) {
+        apr_mmap_t* map;
+        status = apr_mmap_create(&map, file, 0, info.size, APR_MMAP_READ, pool);
+        if (status == APR_SUCCESS) {
+            text = map->mm;
+            len = map->size;
+        }
+    }
+
+    /* The mapping stays when the file is closed */
+    apr_file_close(file);
+    if (status != APR_SUCCESS) {
+        goto fail;
+    }
+
+    TLog_Label* label = create(pool, text, len, false, !async);
+    if (label) {
+        TLog_Label_SetAsync(label, async);
+    }
     return label;
 
     fail:
@@ -90,52 +624,666 @@ TLog_Label* TLog_Label_Create(apr_pool_t* pool, char* text) {
 
 static uint32_t getPreferedWidth(TLog_Widget* widget) {
     TLog_Label* label = (TLog_Label*) widget;
-    
-    uint32_t preferedWidth = 0;
-    uint32_t currentWidth = 0;
-    for (char* ch = label->text; *ch != 0; ch = TLog_UTF8_NextChar(ch)) {
-        if (*ch == '\n') {
-            currentWidth = 0;
-        } else {
-            /* Shall I one-line it? */
-            ++currentWidth;
-            if (currentWidth > preferedWidth) {
-                preferedWidth = currentWidth;
-            }
+    const char* end = label->text + label->len;
+
+    /* Measuring reads the whole text, which laying out on a worker thread is to avoid */
+    if (label->async && label->len >= ASYNC_MIN_LEN) {
+        return UINT32_MAX;
+    }
+
+    if (label->hasPreferedWidth) {
+        ++label->cacheHits;
+        return label->preferedWidth;
+    }
+    ++label->cacheMisses;
+
+    if (!label->checked && !checkText(label, NULL)) {
+        return 0;
+    }
+
+    size_t preferedWidth = 0;
+    for (const char* start = label->text; ; ++start) {
+        size_t count;
+        const char* newline = TLog_UTF8_FindNewline(start, end, &count);
+
+        /* No character takes more than 2 columns, so short paragraphs needn't be measured */
+        if (count * 2 > preferedWidth) {
+            size_t width = TLog_UTF8_Width(start, newline);
+            preferedWidth = width > preferedWidth ? width : preferedWidth;
+        }
+        start = newline;
+        if (start == end) {
+            break;
         }
     }
 
-    return preferedWidth;
+    label->preferedWidth = preferedWidth > UINT32_MAX ? UINT32_MAX : preferedWidth;
+    label->hasPreferedWidth = true;
+
+    return label->preferedWidth;
 }
 
 static uint32_t setMaximumWidth(TLog_Widget* widget, uint32_t maxWidth, uint32_t screenHeight) {
+    UNUSED(screenHeight);
     TLog_Label* label = (TLog_Label*) widget;
 
-    apr_array_clear(label->lines);
+    /* Every line holds at least one character */
+    maxWidth = maxWidth > 0 ? maxWidth : 1;
 
-    /* TODO Sexy word wrap */
-    size_t utf8width;
-    TLog_Label_Line line;
-    for (line.start = line.end = label->text, utf8width = 0;
-            *line.end != 0;
-            line.end = TLog_UTF8_NextChar(line.end), ++utf8width) {
-        if (*line.end == '\n' || utf8width == maxWidth) {
-            APR_ARRAY_PUSH(label->lines, TLog_Label_Line) = line;
-            utf8width = 0;
-            line.start = line.end = *line.end == '\n' ? TLog_UTF8_NextChar(line.end) : line.end;
+    /* A worker laying out for another width is of no use anymore, one that's done leaves its layout cached */
+    if (label->job) {
+        if (label->job->maxWidth == maxWidth && apr_atomic_read32(&label->job->state) == JOB_RUNNING) {
+            return PLACEHOLDER_HEIGHT;
         }
+        stopJob(label, label->job->maxWidth != maxWidth);
     }
-    APR_ARRAY_PUSH(label->lines, TLog_Label_Line) = line;
 
-    while (label->lines->nelts > (int) screenHeight) {
-        apr_array_pop(label->lines);
+    label->maxWidth = maxWidth;
+    label->jobFailed = false;
+    label->layout = getLayout(label, maxWidth, label->async && label->len >= ASYNC_MIN_LEN);
+    if (label->job) {
+        return PLACEHOLDER_HEIGHT;
     }
 
-    return label->lines->nelts;
+    return label->layout ? label->layout->height : 0;
 }
 
 static void drawLine(TLog_Widget* widget, uint32_t lineY) {
     TLog_Label* label = (TLog_Label*) widget;
-    TLog_Label_Line* line = &APR_ARRAY_IDX(label->lines, lineY, TLog_Label_Line);
-    addnstr(line->start, line->end - line->start);
+    TLog_Label_Layout* layout = label->layout;
+
+    if (!layout) {
+        /* A worker thread lays the label out, or failed to */
+        char loading[sizeof(PLACEHOLDER_LOADING) + 4];
+        const char* placeholder = PLACEHOLDER_FAILED;
+        size_t len = sizeof(PLACEHOLDER_FAILED) - 1;
+        if (!label->jobFailed) {
+            len = snprintf(loading, sizeof(loading), PLACEHOLDER_LOADING "%u%%", label->shownPercent);
+            placeholder = loading;
+        }
+        TLog_Draw_Text(placeholder, len < label->maxWidth ? len : label->maxWidth);
+        return;
+    }
+
+    const char* end = label->text + label->len;
+    const char* (*next)(const char*, const char*, uint32_t, const char**) = label->wordWrap ? &nextWordLine : &nextLine;
+    const char* start;
+    const char* lineEnd;
+
+    /* Lines are mostly drawn top to bottom, so continue from the last drawn line if possible */
+    if (layout->nextStart && layout->nextY == lineY) {
+        start = layout->nextStart;
+    } else {
+        start = layout->checkpoints[lineY / CHECKPOINT_INTERVAL];
+        for (uint32_t y = lineY & ~(uint32_t) (CHECKPOINT_INTERVAL - 1); y < lineY; ++y) {
+            start = next(start, end, layout->maxWidth, &lineEnd);
+        }
+    }
+
+    layout->nextStart = next(start, end, layout->maxWidth, &lineEnd);
+    layout->nextY = lineY + 1;
+
+    TLog_Draw_Text(start, lineEnd - start);
+}
+
+static void update(TLog_Widget* widget, uint32_t* dirtyStart, uint32_t* dirtyEnd) {
+    TLog_Label* label = (TLog_Label*) widget;
+    TLog_Label_Job* job = label->job;
+    if (!job) {
+        return;
+    }
+
+    if (apr_atomic_read32(&job->state) == JOB_RUNNING) {
+        /* Only redraw the placeholder when the percentage changed */
+        uint32_t percent = apr_atomic_read32(&job->percent);
+        if (percent != label->shownPercent) {
+            label->shownPercent = percent;
+            *dirtyStart = 0;
+            *dirtyEnd = PLACEHOLDER_HEIGHT;
+        }
+        return;
+    }
+
+    stopJob(label, false);
+    if (label->jobFailed) {
+        *dirtyStart = 0;
+        *dirtyEnd = PLACEHOLDER_HEIGHT;
+    } else {
+        /* The layout is cached now, so laying the label out again takes its height at once */
+        TLog_Invalidate(widget);
+    }
+}
+
+static bool setText(TLog_Label* label, const char* text, size_t len, bool copy, bool check) {
+    if (check && !TLog_UTF8_Validate(text, text + len)) {
+        return false;
+    }
+
+    /* A worker may still read the old text */
+    stopJob(label, true);
+
+    if (copy) {
+        /* The old text may be passed again, so it's only freed once copied */
+        char* buffer = label->copy;
+        if (len + 1 > label->copyCapacity) {
+            buffer = malloc(len + 1);
+            if (!buffer) {
+                return false;
+            }
+        }
+        memmove(buffer, text, len);
+        buffer[len] = 0;
+        if (buffer != label->copy) {
+            free(label->copy);
+            label->copy = buffer;
+            label->copyCapacity = len + 1;
+        }
+        text = buffer;
+    }
+
+    label->text = text;
+    label->len = len;
+    label->checked = check;
+
+    label->hasPreferedWidth = false;
+    label->hasBreaks = false;
+    dropLayouts(label);
+
+    return true;
+}
+
+static apr_status_t freeBuffers(void* data) {
+    TLog_Label* label = data;
+
+    stopJob(label, true);
+    free(label->copy);
+    label->copy = NULL;
+    for (size_t i = 0; i < LAYOUT_CACHE_SIZE; ++i) {
+        free(label->layouts[i].checkpoints);
+        label->layouts[i].checkpoints = NULL;
+    }
+    free(label->breaks);
+    label->breaks = NULL;
+
+    return APR_SUCCESS;
+}
+
+static void dropLayouts(TLog_Label* label) {
+    for (size_t i = 0; i < LAYOUT_CACHE_SIZE; ++i) {
+        label->layouts[i].maxWidth = 0;
+    }
+    label->layout = NULL;
+}
+
+static TLog_Label_Layout* getLayout(TLog_Label* label, uint32_t maxWidth, bool async) {
+    TLog_Label_Layout* layout = NULL;
+    for (size_t i = 0; i < LAYOUT_CACHE_SIZE; ++i) {
+        TLog_Label_Layout* candidate = &label->layouts[i];
+        if (candidate->maxWidth == maxWidth) {
+            ++label->cacheHits;
+            candidate->lastUse = ++label->uses;
+            return candidate;
+        } else if (!layout || candidate->maxWidth == 0
+                || (layout->maxWidth != 0 && candidate->lastUse < layout->lastUse)) {
+            /* Prefer unused layouts, then the least recently used one */
+            layout = candidate;
+        }
+    }
+    ++label->cacheMisses;
+
+    layout->maxWidth = maxWidth;
+    layout->lastUse = ++label->uses;
+
+    /* Without a worker thread, the layout is made here */
+    if (async && startJob(label, layout)) {
+        return NULL;
+    }
+
+    return makeLayout(label, layout, NULL) ? layout : NULL;
+}
+
+static bool makeLayout(TLog_Label* label, TLog_Label_Layout* layout, TLog_Label_Job* job) {
+    if ((!label->checked && !checkText(label, job))
+            || (label->wordWrap && !label->hasBreaks && !findBreaks(label, job))) {
+        layout->maxWidth = 0;
+        return false;
+    }
+
+    if (label->wordWrap) {
+        layOutWords(label, layout, job);
+    } else {
+        layOut(label, layout, job);
+    }
+
+    /* The checkpoints didn't fit in memory, or the job was cancelled */
+    return layout->maxWidth != 0;
+}
+
+static void layOut(TLog_Label* label, TLog_Label_Layout* layout, TLog_Label_Job* job) {
+    const char* end = label->text + label->len;
+    uint32_t maxWidth = layout->maxWidth;
+    uint64_t height = 0;
+
+    layout->checkpointCount = 0;
+    layout->nextStart = NULL;
+
+    const char* newline;
+    for (const char* start = label->text; ; start = newline + 1) {
+        if (isCancelled(job, start - label->text)) {
+            layout->maxWidth = 0;
+            return;
+        }
+
+        size_t count;
+        newline = TLog_UTF8_FindNewline(start, end, &count);
+
+        if (TLog_UTF8_SkipASCII(start, newline) == newline) {
+            /* Printable ASCII takes one line per started maxWidth characters, but at least one */
+            uint64_t lines = newline > start ? (newline - start - 1) / maxWidth + 1 : 1;
+            for (uint64_t y = (height + CHECKPOINT_INTERVAL - 1) & ~(uint64_t) (CHECKPOINT_INTERVAL - 1);
+                    y < height + lines && y < UINT32_MAX; y += CHECKPOINT_INTERVAL) {
+                pushCheckpoint(layout, start + (y - height) * maxWidth);
+            }
+            height += lines;
+        } else {
+            /* Anything else needs its lines broken by width */
+            const char* lineStart = start;
+            do {
+                addLine(layout, &height, lineStart);
+                const char* lineEnd;
+                lineStart = nextLine(lineStart, newline, maxWidth, &lineEnd);
+            } while (lineStart < newline && height < UINT32_MAX && !isCancelled(job, lineStart - label->text));
+        }
+
+        if (newline == end || height >= UINT32_MAX) {
+            break;
+        }
+    }
+
+    layout->height = height < UINT32_MAX ? height : UINT32_MAX;
+}
+
+static const char* nextLine(const char* start, const char* end, uint32_t maxWidth, const char** lineEnd) {
+    /* Newlines take no columns, so one ending the line is always within the fitting part */
+    const char* wrap = TLog_UTF8_SeekWidth(start, end, maxWidth, NULL);
+    const char* newline = memchr(start, '\n', wrap - start);
+
+    if (newline) {
+        *lineEnd = newline;
+        return newline + 1;
+    }
+
+    /* A character wider than the line gets a line of its own */
+    if (wrap == start && start < end) {
+        TLog_UTF8_CharWidth(start, end, &wrap);
+    }
+
+    *lineEnd = wrap;
+    return wrap;
+}
+
+static void layOutWords(TLog_Label* label, TLog_Label_Layout* layout, TLog_Label_Job* job) {
+    const uint8_t* entry = label->breaks;
+    const uint8_t* entriesEnd = entry + label->breaksLen;
+    uint32_t maxWidth = layout->maxWidth;
+    const char* ch = label->text;
+    uint64_t height = 0;
+    size_t x = 0;
+
+    layout->checkpointCount = 0;
+    layout->nextStart = NULL;
+
+    addLine(layout, &height, ch);
+    while (entry < entriesEnd && height < UINT32_MAX) {
+        if (isCancelled(job, ch - label->text)) {
+            layout->maxWidth = 0;
+            return;
+        }
+
+        TLog_Label_Segment segment;
+        entry = readSegment(entry, &segment);
+
+        /* Words go to the next line if they don't fit, spaces may hang over the edge */
+        if (x > 0 && x + segment.wordWidth > maxWidth) {
+            addLine(layout, &height, ch);
+            x = 0;
+        }
+
+        if (segment.wordWidth <= maxWidth) {
+            x += segment.wordWidth;
+        } else if (segment.wordLen == segment.wordWidth) {
+            /* Printable ASCII words wider than a line break every maxWidth characters */
+            size_t rest = segment.wordWidth;
+            for (const char* piece = ch; rest > maxWidth && height < UINT32_MAX; rest -= maxWidth) {
+                piece += maxWidth;
+                addLine(layout, &height, piece);
+            }
+            x = rest;
+        } else {
+            /* Other words wider than a line break where it ends */
+            const char* wordEnd = ch + segment.wordLen;
+            for (const char* piece = ch; height < UINT32_MAX; ) {
+                const char* wrap = TLog_UTF8_SeekWidth(piece, wordEnd, maxWidth, &x);
+                if (wrap == piece) {
+                    x = TLog_UTF8_CharWidth(piece, wordEnd, &wrap);
+                }
+                if (wrap == wordEnd) {
+                    break;
+                }
+                addLine(layout, &height, wrap);
+                piece = wrap;
+            }
+        }
+        ch += segment.wordLen + segment.spaces;
+
+        if (segment.newline) {
+            ++ch;
+            addLine(layout, &height, ch);
+            x = 0;
+        } else {
+            x = x + segment.spaces < maxWidth ? x + segment.spaces : maxWidth;
+        }
+    }
+
+    layout->height = height < UINT32_MAX ? height : UINT32_MAX;
+}
+
+static void addLine(TLog_Label_Layout* layout, uint64_t* height, const char* start) {
+    if ((*height & (CHECKPOINT_INTERVAL - 1)) == 0 && *height < UINT32_MAX) {
+        pushCheckpoint(layout, start);
+    }
+    ++*height;
+}
+
+static void pushCheckpoint(TLog_Label_Layout* layout, const char* start) {
+    if (layout->checkpointCount == layout->checkpointCapacity) {
+        size_t capacity = layout->checkpointCapacity > 0 ? layout->checkpointCapacity * 2 : INIT_CHECKPOINT_CAPACITY;
+        const char** checkpoints = realloc(layout->checkpoints, sizeof(const char*) * capacity);
+        if (!checkpoints) {
+            layout->maxWidth = 0;
+            return;
+        }
+        layout->checkpoints = checkpoints;
+        layout->checkpointCapacity = capacity;
+    }
+    layout->checkpoints[layout->checkpointCount++] = start;
+}
+
+static bool checkText(TLog_Label* label, TLog_Label_Job* job) {
+    const char* end = label->text + label->len;
+
+    /* A worker checks piecewise to look wether it was cancelled in between, pieces end where characters start */
+    for (const char* start = label->text; start < end; ) {
+        const char* pieceEnd = job && (size_t) (end - start) > JOB_CHECK_INTERVAL ? start + JOB_CHECK_INTERVAL : end;
+        while (pieceEnd < end && IS_CONTINUATION(*pieceEnd)) {
+            ++pieceEnd;
+        }
+        if (!TLog_UTF8_Validate(start, pieceEnd) || isCancelled(job, pieceEnd - label->text)) {
+            return false;
+        }
+        start = pieceEnd;
+    }
+
+    label->checked = true;
+    if (job) {
+        job->base += label->len;
+    }
+    return true;
+}
+
+static bool findBreaks(TLog_Label* label, TLog_Label_Job* job) {
+    const char* end = label->text + label->len;
+
+    label->breaksLen = 0;
+    for (const char* start = label->text; start < end; ) {
+        if (isCancelled(job, start - label->text)) {
+            return false;
+        }
+
+        if (label->breaksCapacity - label->breaksLen < MAX_SEGMENT_LEN) {
+            size_t capacity = label->breaksCapacity > 0 ? label->breaksCapacity * 2 : INIT_BREAKS_CAPACITY;
+            uint8_t* breaks = realloc(label->breaks, capacity);
+            if (!breaks) {
+                return false;
+            }
+            label->breaks = breaks;
+            label->breaksCapacity = capacity;
+        }
+
+        TLog_Label_Segment segment;
+        start = nextSegment(start, end, SIZE_MAX, &segment);
+        label->breaksLen = pushSegment(label->breaks + label->breaksLen, &segment) - label->breaks;
+    }
+
+    label->hasBreaks = true;
+    if (job) {
+        job->base += label->len;
+    }
+    return true;
+}
+
+static bool startJob(TLog_Label* label, TLog_Label_Layout* layout) {
+    apr_pool_t* runPool = TLog_GetLayoutPool();
+    apr_pool_t* pool;
+
+    /* Made without a parent, as other widgets may take from the label's pool on other layout threads */
+    if (!runPool || apr_pool_create(&pool, NULL) != APR_SUCCESS) {
+        goto fail;
+    }
+
+    TLog_Label_Job* job = apr_palloc(pool, sizeof(TLog_Label_Job));
+    if (!job) {
+        goto fail_pool;
+    }
+    job->pool = pool;
+    job->runPool = runPool;
+    job->label = label;
+    job->layout = layout;
+    job->maxWidth = layout->maxWidth;
+    job->total = label->len * (1 + !label->checked + (label->wordWrap && !label->hasBreaks));
+    job->base = job->polled = 0;
+    apr_atomic_set32(&job->state, JOB_RUNNING);
+    apr_atomic_set32(&job->cancelled, 0);
+    apr_atomic_set32(&job->percent, 0);
+
+    if (apr_thread_create(&job->thread, NULL, runJob, job, pool) != APR_SUCCESS) {
+        goto fail_pool;
+    }
+
+    label->job = job;
+    label->layout = NULL;
+    label->shownPercent = 0;
+    apr_pool_cleanup_register(runPool, label, cancelJob, apr_pool_cleanup_null);
+
+    return true;
+
+    fail_pool:
+    apr_pool_destroy(pool);
+    fail:
+    return false;
+}
+
+static void* APR_THREAD_FUNC runJob(apr_thread_t* thread, void* data) {
+    TLog_Label_Job* job = data;
+
+    bool done = makeLayout(job->label, job->layout, job);
+    apr_atomic_set32(&job->state, done ? JOB_DONE : JOB_FAILED);
+    TLog_Wakeup();
+
+    apr_thread_exit(thread, APR_SUCCESS);
+    return NULL;
+}
+
+static bool isCancelled(TLog_Label_Job* job, size_t done) {
+    if (!job || job->base + done - job->polled < JOB_CHECK_INTERVAL) {
+        return false;
+    }
+
+    job->polled = job->base + done;
+    apr_atomic_set32(&job->percent, (apr_uint32_t) ((uint64_t) job->polled * 100 / job->total));
+
+    return apr_atomic_read32(&job->cancelled) != 0;
+}
+
+static void stopJob(TLog_Label* label, bool cancel) {
+    TLog_Label_Job* job = label->job;
+    if (!job) {
+        return;
+    }
+
+    if (cancel) {
+        apr_atomic_set32(&job->cancelled, 1);
+    }
+    apr_status_t status;
+    apr_thread_join(&status, job->thread);
+
+    /* A worker cancelled or failed leaves its layout unused, one done leaves it cached */
+    label->jobFailed = apr_atomic_read32(&job->state) == JOB_FAILED && !cancel;
+    label->job = NULL;
+    apr_pool_cleanup_kill(job->runPool, label, cancelJob);
+    apr_pool_destroy(job->pool);
+}
+
+static apr_status_t cancelJob(void* data) {
+    stopJob(data, true);
+    return APR_SUCCESS;
+}
+
+static const char* nextSegment(const char* start, const char* end, size_t limit, TLog_Label_Segment* segment) {
+    const char* ch = start;
+    size_t width = 0;
+
+    while (ch < end && *ch != ' ' && *ch != '\n' && width <= limit) {
+        const char* next;
+        size_t charWidth;
+        if ((unsigned char) *ch > 0x20 && (unsigned char) *ch < 0x7f) {
+            charWidth = 1;
+            next = ch + 1;
+        } else {
+            charWidth = TLog_UTF8_CharWidth(ch, end, &next);
+        }
+
+        /* Wide characters are words of their own, lines may break around them and after hyphens */
+        if (charWidth == 2 && ch > start) {
+            break;
+        }
+        bool hyphen = *ch == '-' && ch > start;
+        width += charWidth;
+        ch = next;
+        if (charWidth == 2 || hyphen) {
+            /* Zero width characters stay with the character before */
+            while (ch < end && *ch != '\n' && TLog_UTF8_CharWidth(ch, end, &next) == 0) {
+                ch = next;
+            }
+            break;
+        }
+    }
+
+    segment->wordLen = ch - start;
+    segment->wordWidth = width;
+
+    for (segment->spaces = 0; ch < end && *ch == ' '; ++ch) {
+        ++segment->spaces;
+    }
+    segment->newline = ch < end && *ch == '\n';
+
+    return segment->newline ? ch + 1 : ch;
+}
+
+static uint8_t* pushSegment(uint8_t* entry, const TLog_Label_Segment* segment) {
+    uint8_t flags = (segment->spaces == 1 ? SEGMENT_SPACE : 0) | (segment->newline ? SEGMENT_NEWLINE : 0);
+
+    /* Words as long as wide are printable ASCII */
+    if (segment->spaces <= 1 && segment->wordLen == segment->wordWidth && segment->wordWidth < 32) {
+        *entry++ = SEGMENT_ASCII | segment->wordWidth << 2 | flags;
+    } else if (segment->spaces <= 1 && segment->wordLen == 3 && segment->wordWidth == 2) {
+        *entry++ = SEGMENT_WIDE | flags;
+    } else {
+        *entry++ = segment->newline ? SEGMENT_NEWLINE : 0;
+        entry = pushVarint(entry, segment->wordWidth);
+        entry = pushVarint(entry, segment->wordLen - segment->wordWidth);
+        entry = pushVarint(entry, segment->spaces);
+    }
+
+    return entry;
+}
+
+static const uint8_t* readSegment(const uint8_t* entry, TLog_Label_Segment* segment) {
+    uint8_t tag = *entry++;
+
+    if (tag & SEGMENT_ASCII) {
+        segment->wordLen = segment->wordWidth = (tag >> 2) & 0x1f;
+        segment->spaces = (tag & SEGMENT_SPACE) != 0;
+    } else if (tag & SEGMENT_WIDE) {
+        segment->wordLen = 3;
+        segment->wordWidth = 2;
+        segment->spaces = (tag & SEGMENT_SPACE) != 0;
+    } else {
+        size_t extra;
+        entry = readVarint(entry, &segment->wordWidth);
+        entry = readVarint(entry, &extra);
+        entry = readVarint(entry, &segment->spaces);
+        segment->wordLen = segment->wordWidth + extra;
+    }
+    segment->newline = (tag & SEGMENT_NEWLINE) != 0;
+
+    return entry;
+}
+
+static uint8_t* pushVarint(uint8_t* entry, size_t value) {
+    for (; value >= 0x80; value >>= 7) {
+        *entry++ = (value & 0x7f) | 0x80;
+    }
+    *entry++ = value;
+    return entry;
+}
+
+static const uint8_t* readVarint(const uint8_t* entry, size_t* value) {
+    *value = 0;
+    for (unsigned int shift = 0; ; shift += 7) {
+        uint8_t b = *entry++;
+        *value |= (size_t) (b & 0x7f) << shift;
+        if (!(b & 0x80)) {
+            return entry;
+        }
+    }
+}
+
+static const char* nextWordLine(const char* start, const char* end, uint32_t maxWidth, const char** lineEnd) {
+    const char* ch = start;
+    size_t x = 0;
+
+    *lineEnd = start;
+    while (ch < end) {
+        /* Words wider than a line needn't be read beyond it */
+        TLog_Label_Segment segment;
+        const char* next = nextSegment(ch, end, maxWidth, &segment);
+        const char* wordEnd = ch + segment.wordLen;
+
+        if (x > 0 && x + segment.wordWidth > maxWidth) {
+            return ch;
+        }
+
+        if (segment.wordWidth <= maxWidth) {
+            x += segment.wordWidth;
+        } else {
+            const char* wrap = TLog_UTF8_SeekWidth(ch, wordEnd, maxWidth, &x);
+            if (wrap == ch) {
+                x = TLog_UTF8_CharWidth(ch, wordEnd, &wrap);
+            }
+            if (wrap < wordEnd) {
+                *lineEnd = wrap;
+                return wrap;
+            }
+        }
+        *lineEnd = wordEnd;
+
+        if (segment.newline) {
+            return next;
+        }
+        x = x + segment.spaces < maxWidth ? x + segment.spaces : maxWidth;
+        ch = next;
+    }
+
+    return end;
 }
@@ -0,0 +1,758 @@
+/**
+ * @file list.c
+ * @author Tobias Heukäufer
+ * @brief A list implementation.
+ */
+
+#include "../include/list.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "../include/draw.h"
+#include "match.h"
+#include "utf8.h"
+
+/* Thanks! https://stackoverflow.com/a/3599170 */
+/** @brief Marks unused function parameters to prevent unused warnings. */
+#define UNUSED(x) (void)(x)
+
+/** @brief Maximum length of a filter's query in bytes. */
+#define MAX_QUERY_LEN 255
+
+/** @brief Number of corpus bytes matched per keystroke, few enough to keep typing responsive. */
+#define KEYSTROKE_MATCH_LEN (1024 * 1024)
+
+/** @brief Number of corpus bytes matched per update while waiting for input. */
+#define UPDATE_MATCH_LEN (4 * 1024 * 1024)
+
+/** @brief Number of bytes an item counts as besides its text when matched on its own or found matching. */
+#define ITEM_MATCH_COST 16
+
+/** @brief Initial size of a filter's corpus in bytes. */
+#define INIT_CORPUS_CAPACITY 4096
+
+/**
+ * @brief A list's filter.
+ *
+ * Items are matched in the corpus, a case-folded copy of all items' texts, each followed by a newline.
+ * Queries are printable ASCII, so they never match across texts. Matching goes in steps, first through
+ * the matches of the query the current one extends, compacting them in place, then on through the items
+ * not looked at yet. Either way matches are found in order, so those found so far can be shown.
+ * The buffers are reallocated as they grow and freed with the list's pool.
+ */
+typedef struct tlog_list_filter {
+    /** @brief How items are matched. */
+    TLog_List_Match match;
+
+    /** @brief Corpus (allocated with malloc). */
+    char* corpus;
+    /** @brief Corpus's size in bytes. */
+    size_t corpusCapacity;
+    /** @brief Every item's start in the corpus, then the corpus's length (allocated with malloc). */
+    uint64_t* offsets;
+    /** @brief Number of items there is room for in the offsets and matches. */
+    size_t itemCapacity;
+    /** @brief Number of items in the corpus. */
+    uint64_t folded;
+
+    /** @brief Query, case-folded. */
+    char query[MAX_QUERY_LEN];
+    /** @brief Query's length in bytes, 0 if not filtering. */
+    size_t queryLen;
+
+    /** @brief Indices of the matching items found so far, then those to narrow down (allocated with malloc). */
+    uint32_t* matches;
+    /** @brief Number of matching items found so far. */
+    uint64_t matchCount;
+    /** @brief Index into the matches of the next previous match to narrow down. */
+    uint64_t narrowNext;
+    /** @brief Index into the matches after the last previous match to narrow down. */
+    uint64_t narrowEnd;
+    /** @brief Index of the first item not looked at yet. */
+    uint64_t scanned;
+} TLog_List_Filter;
+
+struct tlog_list {
+    /** @brief Widget data. */
+    const TLog_Widget_Data* data;
+
+    /** @brief Pool. */
+    apr_pool_t* pool;
+
+    /** @brief Function returning the items' texts. */
+    TLog_List_GetItem getItem;
+    /** @brief Baton to call getItem with. */
+    void* baton;
+    /** @brief Number of items. */
+    uint64_t count;
+
+    /** @brief Number of items shown. */
+    uint32_t rows;
+    /** @brief Prefered width. */
+    uint32_t preferedWidth;
+    /** @brief Width. */
+    uint32_t width;
+
+    /** @brief Position of the first item shown among those shown. */
+    uint64_t top;
+    /** @brief Position of the selected item among those shown. */
+    uint64_t selected;
+
+    /** @brief Filter, or NULL if typing doesn't filter. */
+    TLog_List_Filter* filter;
+};
+
+static uint32_t getPreferedWidth(TLog_Widget* widget);
+static uint32_t setMaximumWidth(TLog_Widget* widget, uint32_t maxWidth, uint32_t screenHeight);
+static void drawLine(TLog_Widget* widget, uint32_t lineY);
+static void setFocus(TLog_Widget* widget, bool fromAbove, uint32_t* cursorX, uint32_t* cursorY);
+static void putChar(TLog_Widget* widget, char ch,
+        uint32_t* cursorX, uint32_t* cursorY, uint32_t* dirtyStart, uint32_t* dirtyEnd);
+static void putText(TLog_Widget* widget, const char* chars, size_t len,
+        uint32_t* cursorX, uint32_t* cursorY, uint32_t* dirtyStart, uint32_t* dirtyEnd);
+static bool putAction(TLog_Widget* widget, TLog_Widget_Action action,
+        uint32_t* cursorX, uint32_t* cursorY, uint32_t* dirtyStart, uint32_t* dirtyEnd);
+static void update(TLog_Widget* widget, uint32_t* dirtyStart, uint32_t* dirtyEnd);
+
+/**
+ * @brief Selects an item, scrolling as little as possible to show it.
+ *
+ * @param list The list
+ * @param position Position of the item among those shown, beyond the last item selects the last one
+ */
+static void selectItem(TLog_List* list, uint64_t position);
+
+/**
+ * @brief Returns the number of items a list shows, i.e. all or those matching its query.
+ *
+ * @param list The list
+ * @return Number of items
+ */
+static uint64_t getShownCount(TLog_List* list);
+
+/**
+ * @brief Returns the index of an item shown.
+ *
+ * @param list The list
+ * @param position Position of the item among those shown
+ * @return Index of the item
+ */
+static uint64_t getItemIndex(TLog_List* list, uint64_t position);
+
+/**
+ * @brief Returns the number of lines above a list's items, i.e. 1 for a filtering list's query.
+ *
+ * @param list The list
+ * @return Number of lines
+ */
+static uint32_t getHeaderHeight(TLog_List* list);
+
+/**
+ * @brief Copies items' texts into a list's corpus, replacing those from the first item on.
+ *
+ * @param list The filtering list
+ * @param from Index of the first item to copy, at most the number of items in the corpus
+ * @return TRUE on success, or FALSE on error, with the corpus holding the items copied so far
+ */
+static bool fold(TLog_List* list, uint64_t from);
+
+/**
+ * @brief Sets a list's query and starts matching it.
+ *
+ * If the query extends the previous one, only the previous matches are narrowed down. Selects the first item.
+ *
+ * @param list The filtering list
+ * @param query The case-folded query
+ * @param len Length of the query in bytes
+ */
+static void setQuery(TLog_List* list, const char* query, size_t len);
+
+/**
+ * @brief Starts matching a list's query against all items.
+ *
+ * @param list The filtering list
+ */
+static void restartMatching(TLog_List* list);
+
+/**
+ * @brief Matches a list's query against further items.
+ *
+ * @param list The filtering list
+ * @param budget Number of corpus bytes to look at, roughly
+ */
+static void matchStep(TLog_List* list, size_t budget);
+
+/**
+ * @brief Returns wether a list's query still needs matching.
+ *
+ * @param filter The list's filter
+ * @return TRUE if items are left to look at, or FALSE else
+ */
+static bool isMatching(TLog_List_Filter* filter);
+
+/**
+ * @brief Checks an item against a list's query.
+ *
+ * @param filter The list's filter
+ * @param index Index of the item
+ * @return TRUE if the item matches, or FALSE else
+ */
+static bool isMatch(TLog_List_Filter* filter, uint64_t index);
+
+/**
+ * @brief Finds the item whose text (or following newline) holds a corpus byte.
+ *
+ * @param filter The list's filter
+ * @param from Index of an item starting at or before the byte
+ * @param offset The byte's offset in the corpus
+ * @return Index of the item
+ */
+static uint64_t findItem(TLog_List_Filter* filter, uint64_t from, uint64_t offset);
+
+/**
+ * @brief Frees a filter's buffers.
+ *
+ * @param data The filter
+ * @return APR_SUCCESS
+ */
+static apr_status_t freeFilter(void* data);
+
+/** @brief List widget functions. */
+static const TLog_Widget_Data TLOG_LIST_DATA = {
+    &getPreferedWidth,
+    &setMaximumWidth,
+    &drawLine,
+    &setFocus,
+    NULL,
+    &putAction,
+    NULL,
+    NULL
+};
+
+/** @brief Filtering list widget functions, taking the query and matching it while waiting for input. */
+static const TLog_Widget_Data TLOG_FILTER_LIST_DATA = {
+    &getPreferedWidth,
+    &setMaximumWidth,
+    &drawLine,
+    &setFocus,
+    &putChar,
+    &putAction,
+    &putText,
+    &update
+};
+
+TLog_List* TLog_List_Create(apr_pool_t* pool, TLog_List_GetItem getItem, void* baton, uint64_t count,
+        uint32_t rows, uint32_t width) {
+    if (!getItem || rows == 0) {
+        goto fail;
+    }
+
+    TLog_List* list = apr_palloc(pool, sizeof(TLog_List));
+    if (!list) {
+        goto fail;
+    }
+
+    list->data = &TLOG_LIST_DATA;
+
+    list->pool = pool;
+
+    list->getItem = getItem;
+    list->baton = baton;
+    list->count = count;
+
+    list->rows = rows;
+    list->preferedWidth = width > 0 ? width : UINT32_MAX;
+    list->width = 1;
+
+    list->top = 0;
+    list->selected = 0;
+
+    list->filter = NULL;
+
+    return list;
+
+    fail:
+    return NULL;
+}
+
+bool TLog_List_SetFilter(TLog_List* list, TLog_List_Match match) {
+    if (!list || list->count > UINT32_MAX) {
+        return false;
+    }
+
+    if (!list->filter) {
+        TLog_List_Filter* filter = apr_pcalloc(list->pool, sizeof(TLog_List_Filter));
+        if (!filter) {
+            return false;
+        }
+        apr_pool_cleanup_register(list->pool, filter, freeFilter, apr_pool_cleanup_null);
+
+        list->filter = filter;
+        list->data = &TLOG_FILTER_LIST_DATA;
+    }
+
+    list->filter->match = match;
+    bool folded = fold(list, 0);
+    restartMatching(list);
+    selectItem(list, 0);
+
+    return folded;
+}
+
+bool TLog_List_SetCount(TLog_List* list, uint64_t count) {
+    if (!list) {
+        return false;
+    }
+
+    TLog_List_Filter* filter = list->filter;
+    uint64_t selected = TLog_List_GetSelected(list);
+    if (filter) {
+        if (count > UINT32_MAX) {
+            return false;
+        }
+
+        uint64_t oldCount = list->count;
+        list->count = count;
+        if (!fold(list, oldCount < count ? oldCount : count)) {
+            list->count = oldCount;
+            filter->folded = oldCount;
+            return false;
+        }
+        restartMatching(list);
+    }
+
+    list->count = count;
+    TLog_List_SetSelected(list, selected);
+
+    return true;
+}
+
+uint64_t TLog_List_GetCount(TLog_List* list) {
+    return list ? list->count : 0;
+}
+
+void TLog_List_SetSelected(TLog_List* list, uint64_t index) {
+    if (!list) {
+        return;
+    }
+
+    TLog_List_Filter* filter = list->filter;
+    if (!filter || filter->queryLen == 0) {
+        selectItem(list, index);
+        return;
+    }
+
+    /* Matches are in order, so find the first one not before the item */
+    uint64_t first = 0;
+    uint64_t last = filter->matchCount;
+    while (first < last) {
+        uint64_t middle = first + (last - first) / 2;
+        if (filter->matches[middle] < index) {
+            first = middle + 1;
+        } else {
+            last = middle;
+        }
+    }
+    selectItem(list, first);
+}
+
+uint64_t TLog_List_GetSelected(TLog_List* list) {
+    return list && list->selected < getShownCount(list) ? getItemIndex(list, list->selected) : 0;
+}
+
+static uint32_t getPreferedWidth(TLog_Widget* widget) {
+    return ((TLog_List*) widget)->preferedWidth;
+}
+
+static uint32_t setMaximumWidth(TLog_Widget* widget, uint32_t maxWidth, uint32_t screenHeight) {
+    UNUSED(screenHeight);
+
+    TLog_List* list = (TLog_List*) widget;
+    list->width = maxWidth < list->preferedWidth ? maxWidth : list->preferedWidth;
+    list->width = list->width > 0 ? list->width : 1;
+
+    /* The height stays the same however many items there are, so changing them needs no new layout */
+    return getHeaderHeight(list) + list->rows;
+}
+
+static void drawLine(TLog_Widget* widget, uint32_t lineY) {
+    TLog_List* list = (TLog_List*) widget;
+    uint32_t header = getHeaderHeight(list);
+
+    if (lineY < header) {
+        /* The query's end and the cursor after it, like a text field */
+        TLog_List_Filter* filter = list->filter;
+        size_t shown = filter->queryLen < list->width - 1 ? filter->queryLen : list->width - 1;
+        TLog_Draw_SetAttribute(TLOG_ATTRIBUTE_REVERSE);
+        TLog_Draw_Text(filter->query + filter->queryLen - shown, shown);
+        TLog_Draw_Fill(' ', list->width - shown);
+        return;
+    }
+
+    uint64_t position = list->top + lineY - header;
+    if (position >= getShownCount(list)) {
+        return;
+    }
+
+    size_t len = 0;
+    const char* text = list->getItem(getItemIndex(list, position), &len, list->baton);
+    if (!text) {
+        text = "";
+        len = 0;
+    }
+
+    size_t width = 0;
+    const char* cut = TLog_UTF8_SeekWidth(text, text + len, list->width, &width);
+
+    /* The selection is highlighted across the whole width */
+    if (position == list->selected) {
+        TLog_Draw_SetAttribute(TLOG_ATTRIBUTE_REVERSE);
+        TLog_Draw_Text(text, cut - text);
+        TLog_Draw_Fill(' ', list->width - width);
+    } else {
+        TLog_Draw_Text(text, cut - text);
+    }
+}
+
+static void setFocus(TLog_Widget* widget, bool fromAbove, uint32_t* cursorX, uint32_t* cursorY) {
+    UNUSED(fromAbove);
+
+    TLog_List* list = (TLog_List*) widget;
+    if (list->filter) {
+        *cursorX = list->filter->queryLen < list->width - 1 ? list->filter->queryLen : list->width - 1;
+        *cursorY = 0;
+    } else {
+        *cursorX = 0;
+        *cursorY = list->selected - list->top;
+    }
+}
+
+static void putChar(TLog_Widget* widget, char ch,
+        uint32_t* cursorX, uint32_t* cursorY, uint32_t* dirtyStart, uint32_t* dirtyEnd) {
+    putText(widget, &ch, 1, cursorX, cursorY, dirtyStart, dirtyEnd);
+}
+
+static void putText(TLog_Widget* widget, const char* chars, size_t len,
+        uint32_t* cursorX, uint32_t* cursorY, uint32_t* dirtyStart, uint32_t* dirtyEnd) {
+    TLog_List* list = (TLog_List*) widget;
+    TLog_List_Filter* filter = list->filter;
+
+    *dirtyStart = *dirtyEnd = 0;
+
+    /* Characters beyond the maximum length are dropped, and so are pasted line breaks and tabs */
+    char query[MAX_QUERY_LEN];
+    size_t queryLen = filter->queryLen;
+    memcpy(query, filter->query, queryLen);
+    for (size_t i = 0; i < len && queryLen < MAX_QUERY_LEN; ++i) {
+        if ((unsigned char) chars[i] >= ' ') {
+            query[queryLen++] = chars[i];
+        }
+    }
+    if (queryLen == filter->queryLen) {
+        return;
+    }
+
+    TLog_Match_Fold(query + filter->queryLen, query + filter->queryLen, query + queryLen);
+    setQuery(list, query, queryLen);
+    matchStep(list, KEYSTROKE_MATCH_LEN);
+
+    setFocus(widget, 0, cursorX, cursorY);
+    *dirtyEnd = getHeaderHeight(list) + list->rows;
+}
+
+static bool putAction(TLog_Widget* widget, TLog_Widget_Action action,
+        uint32_t* cursorX, uint32_t* cursorY, uint32_t* dirtyStart, uint32_t* dirtyEnd) {
+    TLog_List* list = (TLog_List*) widget;
+    uint32_t header = getHeaderHeight(list);
+    uint64_t oldTop = list->top;
+    uint64_t oldSelected = list->selected;
+    uint64_t count = getShownCount(list);
+    uint64_t last = count > 0 ? count - 1 : 0;
+
+    *dirtyStart = *dirtyEnd = 0;
+
+    /* At the list's ends, Up and Down move through the widgets instead */
+    if (action == TLOG_WIDGET_ACTION_UP) {
+        if (list->selected == 0) {
+            return false;
+        }
+        selectItem(list, list->selected - 1);
+    } else if (action == TLOG_WIDGET_ACTION_DOWN) {
+        if (list->selected >= last) {
+            return false;
+        }
+        selectItem(list, list->selected + 1);
+    } else if (action == TLOG_WIDGET_ACTION_PAGE_UP) {
+        selectItem(list, list->selected > list->rows ? list->selected - list->rows : 0);
+    } else if (action == TLOG_WIDGET_ACTION_PAGE_DOWN) {
+        selectItem(list, last - list->selected > list->rows ? list->selected + list->rows : last);
+    } else if (action == TLOG_WIDGET_ACTION_HOME) {
+        selectItem(list, 0);
+    } else if (action == TLOG_WIDGET_ACTION_END) {
+        selectItem(list, last);
+    } else if (action == TLOG_WIDGET_ACTION_BACKSPACE && list->filter) {
+        if (list->filter->queryLen > 0) {
+            setQuery(list, list->filter->query, list->filter->queryLen - 1);
+            matchStep(list, KEYSTROKE_MATCH_LEN);
+            setFocus(widget, 0, cursorX, cursorY);
+            *dirtyEnd = header + list->rows;
+        }
+        return true;
+    } else {
+        return false;
+    }
+
+    if (list->top != oldTop) {
+        *dirtyStart = header;
+        *dirtyEnd = header + list->rows;
+    } else if (list->selected != oldSelected) {
+        uint32_t oldY = oldSelected - list->top;
+        uint32_t newY = list->selected - list->top;
+        *dirtyStart = header + (oldY < newY ? oldY : newY);
+        *dirtyEnd = header + (oldY > newY ? oldY : newY) + 1;
+    }
+
+    setFocus(widget, 0, cursorX, cursorY);
+
+    return true;
+}
+
+static void update(TLog_Widget* widget, uint32_t* dirtyStart, uint32_t* dirtyEnd) {
+    TLog_List* list = (TLog_List*) widget;
+    TLog_List_Filter* filter = list->filter;
+
+    *dirtyStart = *dirtyEnd = 0;
+    if (!isMatching(filter)) {
+        return;
+    }
+
+    uint64_t oldCount = filter->matchCount;
+    matchStep(list, UPDATE_MATCH_LEN);
+
+    /* Matches are only added, so only rows from the first new one on changed */
+    if (filter->matchCount > oldCount && oldCount < list->top + list->rows) {
+        uint32_t header = getHeaderHeight(list);
+        *dirtyStart = header + (oldCount > list->top ? oldCount - list->top : 0);
+        *dirtyEnd = header + list->rows;
+    }
+}
+
+static void selectItem(TLog_List* list, uint64_t position) {
+    uint64_t count = getShownCount(list);
+    uint64_t last = count > 0 ? count - 1 : 0;
+    list->selected = position < last ? position : last;
+
+    if (list->selected < list->top) {
+        list->top = list->selected;
+    } else if (list->selected - list->top >= list->rows) {
+        list->top = list->selected - list->rows + 1;
+    }
+
+    /* Don't leave empty rows at the end while there are items above */
+    uint64_t maxTop = count > list->rows ? count - list->rows : 0;
+    list->top = list->top < maxTop ? list->top : maxTop;
+}
+
+static uint64_t getShownCount(TLog_List* list) {
+    return list->filter && list->filter->queryLen > 0 ? list->filter->matchCount : list->count;
+}
+
+static uint64_t getItemIndex(TLog_List* list, uint64_t position) {
+    return list->filter && list->filter->queryLen > 0 ? list->filter->matches[position] : position;
+}
+
+static uint32_t getHeaderHeight(TLog_List* list) {
+    return list->filter ? 1 : 0;
+}
+
+static bool fold(TLog_List* list, uint64_t from) {
+    TLog_List_Filter* filter = list->filter;
+
+    if (filter->itemCapacity < list->count + 1) {
+        size_t capacity = filter->itemCapacity > 0 ? filter->itemCapacity : 1024;
+        while (capacity < list->count + 1) {
+            capacity *= 2;
+        }
+
+        uint64_t* offsets = realloc(filter->offsets, sizeof(uint64_t) * capacity);
+        if (!offsets) {
+            goto fail;
+        }
+        filter->offsets = offsets;
+
+        uint32_t* matches = realloc(filter->matches, sizeof(uint32_t) * capacity);
+        if (!matches) {
+            goto fail;
+        }
+        filter->matches = matches;
+        filter->itemCapacity = capacity;
+    }
+
+    filter->offsets[0] = 0;
+    filter->folded = from;
+    for (uint64_t i = from; i < list->count; ++i) {
+        size_t len = 0;
+        const char* text = list->getItem(i, &len, list->baton);
+        len = text ? len : 0;
+
+        /* Room for the text and its newline */
+        size_t corpusLen = filter->offsets[i];
+        if (filter->corpusCapacity < corpusLen + len + 1) {
+            size_t capacity = filter->corpusCapacity > 0 ? filter->corpusCapacity : INIT_CORPUS_CAPACITY;
+            while (capacity < corpusLen + len + 1) {
+                capacity *= 2;
+            }
+
+            char* corpus = realloc(filter->corpus, capacity);
+            if (!corpus) {
+                goto fail;
+            }
+            filter->corpus = corpus;
+            filter->corpusCapacity = capacity;
+        }
+
+        if (len > 0) {
+            TLog_Match_Fold(filter->corpus + corpusLen, text, text + len);
+        }
+        filter->corpus[corpusLen + len] = '\n';
+        filter->offsets[i + 1] = corpusLen + len + 1;
+        filter->folded = i + 1;
+    }
+
+    return true;
+
+    fail:
+    return false;
+}
+
+static void setQuery(TLog_List* list, const char* query, size_t len) {
+    TLog_List_Filter* filter = list->filter;
+
+    /* Items matching the longer query are among those matching the shorter one */
+    bool narrows = filter->queryLen > 0 && len > filter->queryLen
+            && memcmp(query, filter->query, filter->queryLen) == 0;
+
+    memmove(filter->query, query, len);
+    filter->queryLen = len;
+
+    if (narrows) {
+        /* Matches found so far and those left to narrow down are narrowed down again, items on as before */
+        uint64_t left = filter->narrowEnd - filter->narrowNext;
+        memmove(filter->matches + filter->matchCount, filter->matches + filter->narrowNext, sizeof(uint32_t) * left);
+        filter->narrowNext = 0;
+        filter->narrowEnd = filter->matchCount + left;
+        filter->matchCount = 0;
+    } else {
+        restartMatching(list);
+    }
+
+    list->top = 0;
+    selectItem(list, 0);
+}
+
+static void restartMatching(TLog_List* list) {
+    TLog_List_Filter* filter = list->filter;
+    filter->matchCount = 0;
+    filter->narrowNext = filter->narrowEnd = 0;
+    filter->scanned = 0;
+}
+
+static void matchStep(TLog_List* list, size_t budget) {
+    TLog_List_Filter* filter = list->filter;
+    uint64_t* offsets = filter->offsets;
+    size_t spent = 0;
+
+    if (filter->queryLen == 0) {
+        return;
+    }
+
+    /* Narrow down the previous matches first, as matches must be found in order */
+    while (filter->narrowNext < filter->narrowEnd && spent < budget) {
+        uint32_t index = filter->matches[filter->narrowNext++];
+        spent += offsets[index + 1] - offsets[index] + ITEM_MATCH_COST;
+        if (isMatch(filter, index)) {
+            filter->matches[filter->matchCount++] = index;
+        }
+    }
+    if (filter->narrowNext < filter->narrowEnd) {
+        return;
+    }
+    filter->narrowNext = filter->narrowEnd = 0;
+
+    if (filter->match == TLOG_LIST_MATCH_SUBSEQUENCE) {
+        for (; filter->scanned < filter->folded && spent < budget; ++filter->scanned) {
+            spent += offsets[filter->scanned + 1] - offsets[filter->scanned] + ITEM_MATCH_COST;
+            if (isMatch(filter, filter->scanned)) {
+                filter->matches[filter->matchCount++] = filter->scanned;
+            }
+        }
+        return;
+    }
+
+    /* Substrings are searched for across texts at once, up to the end of the text the budget runs out in */
+    while (filter->scanned < filter->folded && spent < budget) {
+        uint64_t limit = offsets[filter->scanned] + (budget - spent);
+        uint64_t end = limit < offsets[filter->folded]
+                ? findItem(filter, filter->scanned, limit) + 1 : filter->folded;
+
+        const char* start = filter->corpus + offsets[filter->scanned];
+        const char* stop = filter->corpus + offsets[end];
+        const char* found = TLog_Match_Find(start, stop, filter->query, filter->queryLen);
+        if (found == stop) {
+            spent += stop - start;
+            filter->scanned = end;
+            continue;
+        }
+
+        uint64_t index = findItem(filter, filter->scanned, found - filter->corpus);
+        filter->matches[filter->matchCount++] = index;
+        spent += offsets[index + 1] - offsets[filter->scanned] + ITEM_MATCH_COST;
+        filter->scanned = index + 1;
+    }
+}
+
+static bool isMatching(TLog_List_Filter* filter) {
+    return filter->queryLen > 0 && (filter->narrowNext < filter->narrowEnd || filter->scanned < filter->folded);
+}
+
+static bool isMatch(TLog_List_Filter* filter, uint64_t index) {
+    const char* start = filter->corpus + filter->offsets[index];
+    const char* end = filter->corpus + filter->offsets[index + 1] - 1;
+
+    if (filter->match == TLOG_LIST_MATCH_SUBSEQUENCE) {
+        return TLog_Match_IsSubsequence(start, end, filter->query, filter->queryLen);
+    }
+    return TLog_Match_Find(start, end, filter->query, filter->queryLen) != end;
+}
+
+static uint64_t findItem(TLog_List_Filter* filter, uint64_t from, uint64_t offset) {
+    /* The last item starting at or before the offset, which is mostly close by, so gallop there first */
+    uint64_t first = from;
+    uint64_t step = 1;
+    while (first + step < filter->folded && filter->offsets[first + step] <= offset) {
+        first += step;
+        step *= 2;
+    }
+
+    uint64_t last = (first + step < filter->folded ? first + step : filter->folded) - 1;
+    while (first < last) {
+        uint64_t middle = first + (last - first + 1) / 2;
+        if (filter->offsets[middle] <= offset) {
+            first = middle;
+        } else {
+            last = middle - 1;
+        }
+    }
+    return first;
+}
+
+static apr_status_t freeFilter(void* data) {
+    TLog_List_Filter* filter = data;
+
+    free(filter->corpus);
+    free(filter->offsets);
+    free(filter->matches);
+
+    return APR_SUCCESS;
+}
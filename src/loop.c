@@ -0,0 +1,434 @@
+/**
+ * @file loop.c
+ * @author Tobias Heukäufer
+ * @brief An event loop implementation.
+ */
+
+#include "loop.h"
+
+#include <stdatomic.h>
+
+#include <apr_poll.h>
+#include <apr_portable.h>
+#include <apr_time.h>
+
+/** @brief Maximum number of file descriptors a loop waits on. */
+#define MAX_LOOP_FDS 64
+
+/** @brief Number of slots of a loop's timer wheel, a power of 2. */
+#define WHEEL_SIZE 256
+
+/** @brief Milliseconds covered by a slot of a loop's timer wheel. */
+#define TICK_LEN 4
+
+/** @brief States of a timer. */
+typedef enum tlog_loop_timer_state {
+    /** @brief Waiting in a slot of the timer wheel. */
+    TLOG_LOOP_TIMER_WAITING,
+    /** @brief Expired, its callback is called. */
+    TLOG_LOOP_TIMER_FIRING,
+    /** @brief Not in use, kept for the next timer added. */
+    TLOG_LOOP_TIMER_FREE
+} TLog_Loop_Timer_State;
+
+/** @brief A file descriptor a loop waits on. */
+typedef struct tlog_loop_fd {
+    /** @brief The file descriptor, or -1 if never used. */
+    int fd;
+    /** @brief Wether the file descriptor is waited on. */
+    bool active;
+    /** @brief The file descriptor wrapped, kept for when it is added again. */
+    apr_file_t* file;
+    /** @brief Descriptor in the pollset. */
+    apr_pollfd_t pollfd;
+
+    /** @brief Function to call when the file descriptor is ready. */
+    TLog_Loop_FdCallback callback;
+    /** @brief Baton to call the function with. */
+    void* baton;
+} TLog_Loop_Fd;
+
+struct tlog_loop_timer {
+    /** @brief Loop of the timer. */
+    TLog_Loop* loop;
+    /** @brief State. */
+    TLog_Loop_Timer_State state;
+    /** @brief Milliseconds since the loop's start when the timer expires. */
+    uint64_t deadline;
+    /** @brief Milliseconds between expiries, or 0 to expire once. */
+    uint32_t interval;
+
+    /** @brief Function to call when the timer expires. */
+    TLog_Loop_TimerCallback callback;
+    /** @brief Baton to call the function with. */
+    void* baton;
+
+    /** @brief Next timer in the same list. */
+    TLog_Loop_Timer* next;
+    /** @brief Previous timer in the same slot. */
+    TLog_Loop_Timer* prev;
+};
+
+struct tlog_loop {
+    /** @brief Memory pool. */
+    apr_pool_t* pool;
+    /** @brief Pollset of all file descriptors waited on. */
+    apr_pollset_t* pollset;
+    /** @brief File descriptors. */
+    TLog_Loop_Fd fds[MAX_LOOP_FDS];
+
+    /** @brief Time the loop was created. */
+    apr_time_t start;
+    /** @brief Timer wheel, slot i holds the timers expiring in ticks congruent to i. */
+    TLog_Loop_Timer* wheel[WHEEL_SIZE];
+    /** @brief First tick whose timers may still wait. */
+    uint64_t tick;
+    /** @brief Number of waiting timers. */
+    size_t timerCount;
+    /** @brief Timers not in use. */
+    TLog_Loop_Timer* freeTimers;
+
+    /** @brief Wether the loop was woken up since it last waited. */
+    atomic_bool woken;
+    /** @brief Function to call after the loop was woken up. */
+    TLog_Loop_WakeupCallback wakeupCallback;
+    /** @brief Baton to call the function with. */
+    void* wakeupBaton;
+};
+
+/**
+ * @brief Returns the milliseconds since a loop was created.
+ *
+ * @param loop The loop
+ * @return The milliseconds
+ */
+static uint64_t getNow(TLog_Loop* loop);
+
+/**
+ * @brief Puts a timer into the slot of its deadline.
+ *
+ * @param loop The loop
+ * @param timer The timer
+ */
+static void insertTimer(TLog_Loop* loop, TLog_Loop_Timer* timer);
+
+/**
+ * @brief Takes a timer out of its slot.
+ *
+ * @param loop The loop
+ * @param timer The timer
+ */
+static void unlinkTimer(TLog_Loop* loop, TLog_Loop_Timer* timer);
+
+/**
+ * @brief Returns the milliseconds until a loop's next timer expires.
+ *
+ * @param loop The loop
+ * @param now Milliseconds since the loop's start
+ * @return The milliseconds, or -1 without timers
+ */
+static int64_t getTimerTimeout(TLog_Loop* loop, uint64_t now);
+
+/**
+ * @brief Calls the callbacks of all expired timers.
+ *
+ * @param loop The loop
+ * @param now Milliseconds since the loop's start
+ */
+static void fireTimers(TLog_Loop* loop, uint64_t now);
+
+TLog_Loop* TLog_Loop_Create(apr_pool_t* pool) {
+    TLog_Loop* loop = apr_pcalloc(pool, sizeof(TLog_Loop));
+    if (!loop) {
+        goto fail;
+    }
+
+    loop->pool = pool;
+    if (apr_pollset_create(&loop->pollset, MAX_LOOP_FDS, pool, APR_POLLSET_WAKEABLE) != APR_SUCCESS) {
+        goto fail;
+    }
+    for (size_t i = 0; i < MAX_LOOP_FDS; ++i) {
+        loop->fds[i].fd = -1;
+    }
+
+    loop->start = apr_time_now();
+    atomic_init(&loop->woken, false);
+
+    return loop;
+
+    fail:
+    return NULL;
+}
+
+bool TLog_Loop_AddFd(TLog_Loop* loop, int fd, TLog_Loop_FdCallback callback, void* baton) {
+    if (!loop || fd < 0) {
+        goto fail;
+    }
+
+    /* Prefer the entry the file descriptor had before, so it needs not be wrapped again */
+    TLog_Loop_Fd* entry = NULL;
+    for (size_t i = 0; i < MAX_LOOP_FDS; ++i) {
+        TLog_Loop_Fd* candidate = &loop->fds[i];
+        if (candidate->fd == fd) {
+            entry = candidate;
+            break;
+        } else if (!entry && !candidate->active) {
+            entry = candidate;
+        }
+    }
+    if (!entry) {
+        goto fail;
+    }
+
+    entry->callback = callback;
+    entry->baton = baton;
+    if (entry->active) {
+        return true;
+    }
+
+    if (entry->fd != fd) {
+        apr_os_file_t osFile = fd;
+        entry->file = NULL;
+        if (apr_os_file_put(&entry->file, &osFile, 0, loop->pool) != APR_SUCCESS) {
+            entry->fd = -1;
+            goto fail;
+        }
+        entry->fd = fd;
+    }
+
+    entry->pollfd.p = loop->pool;
+    entry->pollfd.desc_type = APR_POLL_FILE;
+    entry->pollfd.reqevents = APR_POLLIN;
+    entry->pollfd.rtnevents = 0;
+    entry->pollfd.desc.f = entry->file;
+    entry->pollfd.client_data = entry;
+    if (apr_pollset_add(loop->pollset, &entry->pollfd) != APR_SUCCESS) {
+        goto fail;
+    }
+    entry->active = true;
+
+    return true;
+
+    fail:
+    return false;
+}
+
+void TLog_Loop_RemoveFd(TLog_Loop* loop, int fd) {
+    if (!loop) {
+        return;
+    }
+
+    for (size_t i = 0; i < MAX_LOOP_FDS; ++i) {
+        TLog_Loop_Fd* entry = &loop->fds[i];
+        if (entry->active && entry->fd == fd) {
+            apr_pollset_remove(loop->pollset, &entry->pollfd);
+            entry->active = false;
+            return;
+        }
+    }
+}
+
+TLog_Loop_Timer* TLog_Loop_AddTimer(TLog_Loop* loop, uint32_t delay, uint32_t interval,
+        TLog_Loop_TimerCallback callback, void* baton) {
+    if (!loop || !callback) {
+        goto fail;
+    }
+
+    TLog_Loop_Timer* timer = loop->freeTimers;
+    if (timer) {
+        loop->freeTimers = timer->next;
+    } else {
+        timer = apr_palloc(loop->pool, sizeof(TLog_Loop_Timer));
+        if (!timer) {
+            goto fail;
+        }
+        timer->loop = loop;
+    }
+
+    timer->deadline = getNow(loop) + delay;
+    timer->interval = interval;
+    timer->callback = callback;
+    timer->baton = baton;
+    insertTimer(loop, timer);
+
+    return timer;
+
+    fail:
+    return NULL;
+}
+
+void TLog_Loop_CancelTimer(TLog_Loop_Timer* timer) {
+    if (!timer) {
+        return;
+    }
+
+    TLog_Loop* loop = timer->loop;
+    switch (timer->state) {
+        case TLOG_LOOP_TIMER_WAITING:
+            unlinkTimer(loop, timer);
+            timer->state = TLOG_LOOP_TIMER_FREE;
+            timer->next = loop->freeTimers;
+            loop->freeTimers = timer;
+            break;
+
+        case TLOG_LOOP_TIMER_FIRING:
+            /* Freed once its firing is over */
+            timer->state = TLOG_LOOP_TIMER_FREE;
+            break;
+
+        case TLOG_LOOP_TIMER_FREE:
+            break;
+    }
+}
+
+void TLog_Loop_SetWakeupCallback(TLog_Loop* loop, TLog_Loop_WakeupCallback callback, void* baton) {
+    if (loop) {
+        loop->wakeupCallback = callback;
+        loop->wakeupBaton = baton;
+    }
+}
+
+bool TLog_Loop_Wakeup(TLog_Loop* loop) {
+    if (!loop) {
+        return false;
+    }
+
+    /* The pollset may swallow a wakeup along with ready file descriptors, the flag is never lost */
+    atomic_store(&loop->woken, true);
+    return apr_pollset_wakeup(loop->pollset) == APR_SUCCESS;
+}
+
+void TLog_Loop_Wait(TLog_Loop* loop, int timeout) {
+    int64_t timerTimeout = getTimerTimeout(loop, getNow(loop));
+    if (timerTimeout >= 0 && (timeout < 0 || timerTimeout < timeout)) {
+        timeout = timerTimeout;
+    }
+
+    apr_int32_t count = 0;
+    const apr_pollfd_t* ready = NULL;
+    apr_interval_time_t pollTimeout = timeout < 0 ? -1 : apr_time_from_msec(timeout);
+    if (apr_pollset_poll(loop->pollset, pollTimeout, &count, &ready) == APR_SUCCESS) {
+        for (apr_int32_t i = 0; i < count; ++i) {
+            TLog_Loop_Fd* entry = ready[i].client_data;
+
+            /* An earlier callback may have removed it */
+            if (entry->active && entry->callback) {
+                entry->callback(entry->fd, entry->baton);
+            }
+        }
+    }
+
+    if (atomic_exchange(&loop->woken, false) && loop->wakeupCallback) {
+        loop->wakeupCallback(loop->wakeupBaton);
+    }
+
+    fireTimers(loop, getNow(loop));
+}
+
+static uint64_t getNow(TLog_Loop* loop) {
+    apr_time_t elapsed = apr_time_now() - loop->start;
+    return elapsed > 0 ? apr_time_as_msec(elapsed) : 0;
+}
+
+static void insertTimer(TLog_Loop* loop, TLog_Loop_Timer* timer) {
+    TLog_Loop_Timer** slot = &loop->wheel[(timer->deadline / TICK_LEN) & (WHEEL_SIZE - 1)];
+
+    timer->state = TLOG_LOOP_TIMER_WAITING;
+    timer->prev = NULL;
+    timer->next = *slot;
+    if (*slot) {
+        (*slot)->prev = timer;
+    }
+    *slot = timer;
+
+    ++loop->timerCount;
+}
+
+static void unlinkTimer(TLog_Loop* loop, TLog_Loop_Timer* timer) {
+    if (timer->prev) {
+        timer->prev->next = timer->next;
+    } else {
+        loop->wheel[(timer->deadline / TICK_LEN) & (WHEEL_SIZE - 1)] = timer->next;
+    }
+    if (timer->next) {
+        timer->next->prev = timer->prev;
+    }
+
+    --loop->timerCount;
+}
+
+static int64_t getTimerTimeout(TLog_Loop* loop, uint64_t now) {
+    if (loop->timerCount == 0) {
+        return -1;
+    }
+
+    /* The first slot holding a timer of its own turn has the next deadline */
+    for (uint64_t tick = loop->tick; tick < loop->tick + WHEEL_SIZE; ++tick) {
+        uint64_t earliest = UINT64_MAX;
+        for (TLog_Loop_Timer* timer = loop->wheel[tick & (WHEEL_SIZE - 1)]; timer; timer = timer->next) {
+            if (timer->deadline < (tick + 1) * TICK_LEN && timer->deadline < earliest) {
+                earliest = timer->deadline;
+            }
+        }
+        if (earliest != UINT64_MAX) {
+            return earliest > now ? (int64_t) (earliest - now) : 0;
+        }
+    }
+
+    /* All timers are more than a turn away, wake up to look again in a turn */
+    uint64_t turnEnd = (loop->tick + WHEEL_SIZE) * TICK_LEN;
+    return turnEnd > now ? (int64_t) (turnEnd - now) : 0;
+}
+
+static void fireTimers(TLog_Loop* loop, uint64_t now) {
+    uint64_t nowTick = now / TICK_LEN;
+    if (loop->timerCount == 0) {
+        loop->tick = nowTick;
+        return;
+    }
+
+    /* Each slot needs to be looked at once, however long ago the last look was */
+    uint64_t tick = loop->tick;
+    if (nowTick - tick >= WHEEL_SIZE) {
+        tick = nowTick - (WHEEL_SIZE - 1);
+    }
+
+    /* Collect first, callbacks may add and cancel timers */
+    TLog_Loop_Timer* expired = NULL;
+    for (; tick <= nowTick; ++tick) {
+        TLog_Loop_Timer* timer = loop->wheel[tick & (WHEEL_SIZE - 1)];
+        while (timer) {
+            TLog_Loop_Timer* next = timer->next;
+            if (timer->deadline <= now) {
+                unlinkTimer(loop, timer);
+                timer->state = TLOG_LOOP_TIMER_FIRING;
+                timer->next = expired;
+                expired = timer;
+            }
+            timer = next;
+        }
+    }
+    loop->tick = nowTick;
+
+    while (expired) {
+        TLog_Loop_Timer* timer = expired;
+        expired = timer->next;
+
+        if (timer->state == TLOG_LOOP_TIMER_FIRING) {
+            timer->callback(timer, timer->baton);
+        }
+
+        if (timer->state == TLOG_LOOP_TIMER_FIRING && timer->interval > 0) {
+            /* Expiries missed while busy are dropped, not made up for */
+            timer->deadline += timer->interval;
+            if (timer->deadline <= now) {
+                timer->deadline = now + timer->interval;
+            }
+            insertTimer(loop, timer);
+        } else {
+            timer->state = TLOG_LOOP_TIMER_FREE;
+            timer->next = loop->freeTimers;
+            loop->freeTimers = timer;
+        }
+    }
+}
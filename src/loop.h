@@ -0,0 +1,21 @@
+/**
+ * @file loop.h
+ * @author Tobias Heukäufer
+ * @brief Event loop internals.
+ */
+
+#ifndef TLOG_SRC_LOOP_H
+#define TLOG_SRC_LOOP_H
+
+#include "../include/loop.h"
+
+/**
+ * @brief Waits until a file descriptor is ready, a timer expires, the loop is woken up or the time is up,
+ * then calls the callbacks of what happened.
+ *
+ * @param loop The event loop
+ * @param timeout Milliseconds to wait at most, or -1 to wait until something happens
+ */
+void TLog_Loop_Wait(TLog_Loop* loop, int timeout);
+
+#endif
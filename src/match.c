@@ -0,0 +1,134 @@
+/**
+ * @file match.c
+ * @author Tobias Heukäufer
+ * @brief Text matching implementation.
+ */
+
+#include "match.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+/** @brief Defined if SSE2/AVX2 kernels are built (and chosen at runtime). */
+#define TLOG_MATCH_X86
+#include <immintrin.h>
+#endif
+
+/*
+ * The kernels look for blocks of positions where both the needle's first and last byte are,
+ * and only compare the rest of the needle there, which rarely happens for more than the matches.
+ */
+
+static const char* findScalar(const char* start, const char* end, const char* needle, size_t len);
+
+#ifdef TLOG_MATCH_X86
+static const char* findSSE2(const char* start, const char* end, const char* needle, size_t len);
+static const char* findAVX2(const char* start, const char* end, const char* needle, size_t len);
+
+/** @brief TRUE if the CPU runs the AVX2 kernels. */
+#define HAS_AVX2() (__builtin_cpu_supports("avx2"))
+/** @brief TRUE if the CPU runs the SSE2 kernels. */
+#define HAS_SSE2() (__builtin_cpu_supports("sse2"))
+#endif
+
+void TLog_Match_Fold(char* dest, const char* start, const char* end) {
+    /* Branch free, so compilers vectorize it */
+    for (const char* ch = start; ch < end; ++ch, ++dest) {
+        unsigned char b = *ch;
+        *dest = b | ((unsigned char) (b - 'A') < 26 ? 0x20 : 0);
+    }
+}
+
+const char* TLog_Match_Find(const char* start, const char* end, const char* needle, size_t len) {
+    if ((size_t) (end - start) < len) {
+        return end;
+    }
+
+#ifdef TLOG_MATCH_X86
+    if (HAS_AVX2()) {
+        return findAVX2(start, end, needle, len);
+    } else if (HAS_SSE2()) {
+        return findSSE2(start, end, needle, len);
+    }
+#endif
+    return findScalar(start, end, needle, len);
+}
+
+bool TLog_Match_IsSubsequence(const char* start, const char* end, const char* needle, size_t len) {
+    const char* ch = start;
+    for (size_t i = 0; i < len; ++i) {
+        ch = memchr(ch, needle[i], end - ch);
+        if (!ch) {
+            return false;
+        }
+        ++ch;
+    }
+    return true;
+}
+
+static const char* findScalar(const char* start, const char* end, const char* needle, size_t len) {
+    const char* last = end - len;
+    for (const char* ch = start; ch <= last; ++ch) {
+        ch = memchr(ch, needle[0], last - ch + 1);
+        if (!ch) {
+            break;
+        }
+        if (memcmp(ch + 1, needle + 1, len - 1) == 0) {
+            return ch;
+        }
+    }
+    return end;
+}
+
+#ifdef TLOG_MATCH_X86
+
+/************** SSE2 **************/
+
+__attribute__((target("sse2")))
+static const char* findSSE2(const char* start, const char* end, const char* needle, size_t len) {
+    const __m128i first = _mm_set1_epi8(needle[0]);
+    const __m128i last = _mm_set1_epi8(needle[len - 1]);
+    const char* ch;
+
+    for (ch = start; (size_t) (end - ch) >= 16 + len - 1; ch += 16) {
+        __m128i firsts = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*) ch), first);
+        __m128i lasts = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*) (ch + len - 1)), last);
+        unsigned int candidates = _mm_movemask_epi8(_mm_and_si128(firsts, lasts));
+        while (candidates) {
+            unsigned int index = __builtin_ctz(candidates);
+            if (len <= 2 || memcmp(ch + index + 1, needle + 1, len - 2) == 0) {
+                return ch + index;
+            }
+            candidates &= candidates - 1;
+        }
+    }
+
+    return findScalar(ch, end, needle, len);
+}
+
+/************** AVX2 **************/
+
+__attribute__((target("avx2")))
+static const char* findAVX2(const char* start, const char* end, const char* needle, size_t len) {
+    const __m256i first = _mm256_set1_epi8(needle[0]);
+    const __m256i last = _mm256_set1_epi8(needle[len - 1]);
+    const char* ch;
+
+    for (ch = start; (size_t) (end - ch) >= 32 + len - 1; ch += 32) {
+        __m256i firsts = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*) ch), first);
+        __m256i lasts = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*) (ch + len - 1)), last);
+        unsigned int candidates = _mm256_movemask_epi8(_mm256_and_si256(firsts, lasts));
+        while (candidates) {
+            unsigned int index = __builtin_ctz(candidates);
+            if (len <= 2 || memcmp(ch + index + 1, needle + 1, len - 2) == 0) {
+                return ch + index;
+            }
+            candidates &= candidates - 1;
+        }
+    }
+
+    return findScalar(ch, end, needle, len);
+}
+
+#endif
@@ -0,0 +1,46 @@
+/**
+ * @file match.h
+ * @author Tobias Heukäufer
+ * @brief Text matching utility.
+ */
+
+#ifndef TLOG_SRC_MATCH_H
+#define TLOG_SRC_MATCH_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+
+/**
+ * @brief Copies a range, folding ASCII letters to lower case.
+ * 
+ * Other bytes are copied as they are, so the copy stays UTF-8 and as long as the range.
+ * 
+ * @param dest Where to copy to
+ * @param start First byte of the range
+ * @param end The byte after the last byte of the range
+ */
+void TLog_Match_Fold(char* dest, const char* start, const char* end);
+
+/**
+ * @brief Finds the first occurrence of a needle in a range.
+ * 
+ * @param start First byte of the range
+ * @param end The byte after the last byte of the range
+ * @param needle The needle
+ * @param len The needle's length in bytes, at least 1
+ * @return The occurrence's first byte, or end if there is none
+ */
+const char* TLog_Match_Find(const char* start, const char* end, const char* needle, size_t len);
+
+/**
+ * @brief Checks wether a needle's bytes occur in a range in order, not necessarily next to each other.
+ * 
+ * @param start First byte of the range
+ * @param end The byte after the last byte of the range
+ * @param needle The needle
+ * @param len The needle's length in bytes
+ * @return TRUE if the needle occurs, or FALSE else
+ */
+bool TLog_Match_IsSubsequence(const char* start, const char* end, const char* needle, size_t len);
+
+#endif
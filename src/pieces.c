@@ -0,0 +1,567 @@
+/**
+ * @file pieces.c
+ * @author Tobias Heukäufer
+ * @brief Piece table implementation.
+ */
+
+#include "pieces.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/** @brief Initial number of pieces there is room for. */
+#define INIT_PIECE_CAPACITY 64
+
+/** @brief Initial size of the added buffer in bytes. */
+#define INIT_ADDED_CAPACITY 4096
+
+/** @brief Initial number of newlines a buffer has room for. */
+#define INIT_NEWLINE_CAPACITY 256
+
+/** @brief Returns a piece by index. */
+#define PIECE(pieces, i) (&(pieces)->pieces[i])
+
+/**
+ * @brief Frees a text's buffers.
+ *
+ * @param data The text
+ * @return Always APR_SUCCESS
+ */
+static apr_status_t freeBuffers(void* data);
+
+/**
+ * @brief Appends text to a buffer, noting its newlines.
+ *
+ * @param buffer The buffer
+ * @param text The text
+ * @param len Length of the text in bytes
+ * @return 0 on success, or else on error, leaving the buffer as it was
+ */
+static int append(TLog_Piece_Buffer* buffer, const char* text, size_t len);
+
+/**
+ * @brief Returns the index of a buffer's first newline at or after an offset.
+ *
+ * @param buffer The buffer
+ * @param offset The offset
+ * @return Index of the newline, or the number of newlines if there is none
+ */
+static uint64_t findNewline(TLog_Piece_Buffer* buffer, uint64_t offset);
+
+/**
+ * @brief Makes sure pieces can be taken without reallocating, so indices held stay valid.
+ *
+ * @param pieces The text
+ * @param count Number of pieces
+ * @return 0 on success, or else on error
+ */
+static int reserve(TLog_Pieces* pieces, uint32_t count);
+
+/**
+ * @brief Returns a random priority, which keeps the treap balanced whatever the order of insertions.
+ *
+ * @param pieces The text
+ * @return The priority
+ */
+static uint32_t nextPriority(TLog_Pieces* pieces);
+
+/**
+ * @brief Takes a piece, which must have been reserved.
+ *
+ * @param pieces The text
+ * @param added Wether the piece is in the added buffer
+ * @param start First byte in the buffer
+ * @param len Length in bytes
+ * @param priority Heap priority
+ * @return Index of the piece
+ */
+static uint32_t takePiece(TLog_Pieces* pieces, bool added, uint64_t start, uint64_t len, uint32_t priority);
+
+/**
+ * @brief Frees a subtree's pieces.
+ *
+ * @param pieces The text
+ * @param i The subtree's root
+ */
+static void freeTree(TLog_Pieces* pieces, uint32_t i);
+
+/**
+ * @brief Sums up a piece's subtree's length and newlines.
+ *
+ * @param pieces The text
+ * @param i The piece
+ */
+static void updatePiece(TLog_Pieces* pieces, uint32_t i);
+
+/**
+ * @brief Joins two subtrees.
+ *
+ * @param pieces The text
+ * @param a The subtree holding the first part of the text
+ * @param b The subtree holding the second part of the text
+ * @return The joined subtree's root
+ */
+static uint32_t merge(TLog_Pieces* pieces, uint32_t a, uint32_t b);
+
+/**
+ * @brief Splits a subtree at a byte position, splitting the piece there if needed (1 piece must be reserved).
+ *
+ * @param pieces The text
+ * @param i The subtree's root
+ * @param offset Byte position within the subtree
+ * @param left Where to store the root of the part before the position
+ * @param right Where to store the root of the part from the position on
+ */
+static void split(TLog_Pieces* pieces, uint32_t i, uint64_t offset, uint32_t* left, uint32_t* right);
+
+/**
+ * @brief Extends the piece ending at a byte position by bytes appended to the added buffer, if it ends the buffer.
+ *
+ * @param pieces The text
+ * @param i The subtree's root
+ * @param offset Byte position within the subtree
+ * @param start Where the appended bytes start in the added buffer
+ * @param len Number of appended bytes
+ * @param newlines Number of newlines in the appended bytes
+ * @return TRUE if a piece was extended, or FALSE else
+ */
+static bool extend(TLog_Pieces* pieces, uint32_t i, uint64_t offset, uint64_t start, uint64_t len,
+        uint64_t newlines);
+
+/**
+ * @brief Copies a subtree's range of text.
+ *
+ * @param pieces The text
+ * @param i The subtree's root
+ * @param from First byte position of the range within the subtree
+ * @param to The byte position after the range within the subtree
+ * @param dest Where to copy to
+ */
+static void copy(TLog_Pieces* pieces, uint32_t i, uint64_t from, uint64_t to, char* dest);
+
+int TLog_Pieces_Init(TLog_Pieces* pieces, apr_pool_t* pool) {
+    memset(pieces, 0, sizeof(TLog_Pieces));
+    pieces->random = 0x9e3779b97f4a7c15ull;
+    pieces->used = 1;
+
+    apr_pool_cleanup_register(pool, pieces, freeBuffers, apr_pool_cleanup_null);
+
+    return reserve(pieces, INIT_PIECE_CAPACITY - 1);
+}
+
+int TLog_Pieces_Set(TLog_Pieces* pieces, const char* text, size_t len) {
+    /* Nothing refers to either buffer anymore */
+    pieces->used = 1;
+    pieces->freed = 0;
+    pieces->root = 0;
+    pieces->original.len = pieces->original.newlineCount = 0;
+    pieces->added.len = pieces->added.newlineCount = 0;
+
+    if (len == 0) {
+        return 0;
+    }
+
+    if (append(&pieces->original, text, len)) {
+        return -1;
+    }
+    pieces->root = takePiece(pieces, false, 0, len, nextPriority(pieces));
+
+    return 0;
+}
+
+int TLog_Pieces_Insert(TLog_Pieces* pieces, uint64_t offset, const char* text, size_t len) {
+    uint64_t total = TLog_Pieces_GetLen(pieces);
+    offset = offset < total ? offset : total;
+    if (len == 0) {
+        return 0;
+    }
+
+    if (reserve(pieces, 2)) {
+        return -1;
+    }
+
+    /* Bytes left in the added buffer by a failed insertion are never referred to */
+    uint64_t start = pieces->added.len;
+    uint64_t oldNewlines = pieces->added.newlineCount;
+    if (append(&pieces->added, text, len)) {
+        return -1;
+    }
+
+    /* Typing goes on where it left off, so mostly the last piece added just grows */
+    uint64_t newlines = pieces->added.newlineCount - oldNewlines;
+    if (offset > 0 && extend(pieces, pieces->root, offset, start, len, newlines)) {
+        return 0;
+    }
+
+    uint32_t left, right;
+    split(pieces, pieces->root, offset, &left, &right);
+    uint32_t piece = takePiece(pieces, true, start, len, nextPriority(pieces));
+    pieces->root = merge(pieces, merge(pieces, left, piece), right);
+
+    return 0;
+}
+
+int TLog_Pieces_Delete(TLog_Pieces* pieces, uint64_t from, uint64_t to) {
+    uint64_t total = TLog_Pieces_GetLen(pieces);
+    to = to < total ? to : total;
+    if (from >= to) {
+        return 0;
+    }
+
+    if (reserve(pieces, 2)) {
+        return -1;
+    }
+
+    uint32_t left, middle, right;
+    split(pieces, pieces->root, from, &left, &right);
+    split(pieces, right, to - from, &middle, &right);
+    freeTree(pieces, middle);
+    pieces->root = merge(pieces, left, right);
+
+    return 0;
+}
+
+uint64_t TLog_Pieces_GetLen(TLog_Pieces* pieces) {
+    return pieces->root ? PIECE(pieces, pieces->root)->treeLen : 0;
+}
+
+uint64_t TLog_Pieces_GetLineCount(TLog_Pieces* pieces) {
+    return (pieces->root ? PIECE(pieces, pieces->root)->treeNewlines : 0) + 1;
+}
+
+uint64_t TLog_Pieces_GetLineStart(TLog_Pieces* pieces, uint64_t line) {
+    if (line == 0) {
+        return 0;
+    }
+
+    /* The line starts after the text's line-th newline */
+    uint64_t offset = 0;
+    uint32_t i = pieces->root;
+    while (i) {
+        TLog_Piece* piece = PIECE(pieces, i);
+        TLog_Piece* left = PIECE(pieces, piece->left);
+        uint64_t leftNewlines = piece->left ? left->treeNewlines : 0;
+        if (line <= leftNewlines) {
+            i = piece->left;
+            continue;
+        }
+
+        line -= leftNewlines;
+        offset += piece->left ? left->treeLen : 0;
+        if (line <= piece->newlines) {
+            TLog_Piece_Buffer* buffer = piece->added ? &pieces->added : &pieces->original;
+            uint64_t newline = buffer->newlines[findNewline(buffer, piece->start) + line - 1];
+            return offset + (newline - piece->start) + 1;
+        }
+
+        line -= piece->newlines;
+        offset += piece->len;
+        i = piece->right;
+    }
+
+    return offset;
+}
+
+uint64_t TLog_Pieces_GetLineEnd(TLog_Pieces* pieces, uint64_t line) {
+    if (line + 1 >= TLog_Pieces_GetLineCount(pieces)) {
+        return TLog_Pieces_GetLen(pieces);
+    }
+    return TLog_Pieces_GetLineStart(pieces, line + 1) - 1;
+}
+
+uint64_t TLog_Pieces_GetLine(TLog_Pieces* pieces, uint64_t offset) {
+    /* Count the newlines before the position */
+    uint64_t line = 0;
+    uint32_t i = pieces->root;
+    while (i) {
+        TLog_Piece* piece = PIECE(pieces, i);
+        TLog_Piece* left = PIECE(pieces, piece->left);
+        uint64_t leftLen = piece->left ? left->treeLen : 0;
+        if (offset < leftLen) {
+            i = piece->left;
+            continue;
+        }
+
+        line += piece->left ? left->treeNewlines : 0;
+        offset -= leftLen;
+        if (offset < piece->len) {
+            TLog_Piece_Buffer* buffer = piece->added ? &pieces->added : &pieces->original;
+            return line + findNewline(buffer, piece->start + offset) - findNewline(buffer, piece->start);
+        }
+
+        line += piece->newlines;
+        offset -= piece->len;
+        i = piece->right;
+    }
+
+    return line;
+}
+
+void TLog_Pieces_Copy(TLog_Pieces* pieces, uint64_t from, uint64_t to, char* dest) {
+    copy(pieces, pieces->root, from, to, dest);
+}
+
+static apr_status_t freeBuffers(void* data) {
+    TLog_Pieces* pieces = data;
+
+    free(pieces->original.text);
+    free(pieces->original.newlines);
+    free(pieces->added.text);
+    free(pieces->added.newlines);
+    free(pieces->pieces);
+
+    return APR_SUCCESS;
+}
+
+static int append(TLog_Piece_Buffer* buffer, const char* text, size_t len) {
+    if (buffer->capacity - buffer->len < len) {
+        uint64_t capacity = buffer->capacity > 0 ? buffer->capacity : INIT_ADDED_CAPACITY;
+        while (capacity - buffer->len < len) {
+            capacity *= 2;
+        }
+
+        char* grown = realloc(buffer->text, capacity);
+        if (!grown) {
+            return -1;
+        }
+        buffer->text = grown;
+        buffer->capacity = capacity;
+    }
+
+    /* Count first, so the newlines' room is made before anything changes */
+    uint64_t count = 0;
+    for (const char* newline = memchr(text, '\n', len); newline;
+            newline = memchr(newline + 1, '\n', text + len - newline - 1)) {
+        ++count;
+    }
+
+    if (buffer->newlineCapacity - buffer->newlineCount < count) {
+        uint64_t capacity = buffer->newlineCapacity > 0 ? buffer->newlineCapacity : INIT_NEWLINE_CAPACITY;
+        while (capacity - buffer->newlineCount < count) {
+            capacity *= 2;
+        }
+
+        uint64_t* grown = realloc(buffer->newlines, sizeof(uint64_t) * capacity);
+        if (!grown) {
+            return -1;
+        }
+        buffer->newlines = grown;
+        buffer->newlineCapacity = capacity;
+    }
+
+    for (const char* newline = memchr(text, '\n', len); newline;
+            newline = memchr(newline + 1, '\n', text + len - newline - 1)) {
+        buffer->newlines[buffer->newlineCount++] = buffer->len + (newline - text);
+    }
+    memcpy(buffer->text + buffer->len, text, len);
+    buffer->len += len;
+
+    return 0;
+}
+
+static uint64_t findNewline(TLog_Piece_Buffer* buffer, uint64_t offset) {
+    uint64_t first = 0;
+    uint64_t last = buffer->newlineCount;
+    while (first < last) {
+        uint64_t middle = first + (last - first) / 2;
+        if (buffer->newlines[middle] < offset) {
+            first = middle + 1;
+        } else {
+            last = middle;
+        }
+    }
+    return first;
+}
+
+static int reserve(TLog_Pieces* pieces, uint32_t count) {
+    if (pieces->used + count <= pieces->capacity) {
+        return 0;
+    }
+
+    uint32_t capacity = pieces->capacity > 0 ? pieces->capacity : INIT_PIECE_CAPACITY;
+    while (capacity < pieces->used + count) {
+        if (capacity > UINT32_MAX / 2) {
+            return -1;
+        }
+        capacity *= 2;
+    }
+
+    TLog_Piece* grown = realloc(pieces->pieces, sizeof(TLog_Piece) * capacity);
+    if (!grown) {
+        return -1;
+    }
+    pieces->pieces = grown;
+    pieces->capacity = capacity;
+
+    return 0;
+}
+
+static uint32_t nextPriority(TLog_Pieces* pieces) {
+    /* xorshift64 */
+    pieces->random ^= pieces->random << 13;
+    pieces->random ^= pieces->random >> 7;
+    pieces->random ^= pieces->random << 17;
+    return (uint32_t) (pieces->random >> 32);
+}
+
+static uint32_t takePiece(TLog_Pieces* pieces, bool added, uint64_t start, uint64_t len, uint32_t priority) {
+    uint32_t i = pieces->freed;
+    if (i) {
+        pieces->freed = PIECE(pieces, i)->left;
+    } else {
+        i = pieces->used++;
+    }
+
+    TLog_Piece* piece = PIECE(pieces, i);
+    piece->added = added;
+    piece->start = start;
+    piece->len = len;
+    piece->left = piece->right = 0;
+    piece->priority = priority;
+
+    TLog_Piece_Buffer* buffer = added ? &pieces->added : &pieces->original;
+    piece->newlines = findNewline(buffer, start + len) - findNewline(buffer, start);
+    updatePiece(pieces, i);
+
+    return i;
+}
+
+static void freeTree(TLog_Pieces* pieces, uint32_t i) {
+    if (!i) {
+        return;
+    }
+
+    TLog_Piece* piece = PIECE(pieces, i);
+    freeTree(pieces, piece->left);
+    freeTree(pieces, piece->right);
+    piece->left = pieces->freed;
+    pieces->freed = i;
+}
+
+static void updatePiece(TLog_Pieces* pieces, uint32_t i) {
+    TLog_Piece* piece = PIECE(pieces, i);
+    piece->treeLen = piece->len;
+    piece->treeNewlines = piece->newlines;
+    if (piece->left) {
+        piece->treeLen += PIECE(pieces, piece->left)->treeLen;
+        piece->treeNewlines += PIECE(pieces, piece->left)->treeNewlines;
+    }
+    if (piece->right) {
+        piece->treeLen += PIECE(pieces, piece->right)->treeLen;
+        piece->treeNewlines += PIECE(pieces, piece->right)->treeNewlines;
+    }
+}
+
+static uint32_t merge(TLog_Pieces* pieces, uint32_t a, uint32_t b) {
+    if (!a || !b) {
+        return a ? a : b;
+    }
+
+    if (PIECE(pieces, a)->priority >= PIECE(pieces, b)->priority) {
+        uint32_t right = merge(pieces, PIECE(pieces, a)->right, b);
+        PIECE(pieces, a)->right = right;
+        updatePiece(pieces, a);
+        return a;
+    }
+
+    uint32_t left = merge(pieces, a, PIECE(pieces, b)->left);
+    PIECE(pieces, b)->left = left;
+    updatePiece(pieces, b);
+    return b;
+}
+
+static void split(TLog_Pieces* pieces, uint32_t i, uint64_t offset, uint32_t* left, uint32_t* right) {
+    if (!i) {
+        *left = *right = 0;
+        return;
+    }
+
+    TLog_Piece* piece = PIECE(pieces, i);
+    uint64_t leftLen = piece->left ? PIECE(pieces, piece->left)->treeLen : 0;
+
+    if (offset <= leftLen) {
+        uint32_t leftRight;
+        split(pieces, piece->left, offset, left, &leftRight);
+        PIECE(pieces, i)->left = leftRight;
+        updatePiece(pieces, i);
+        *right = i;
+    } else if (offset >= leftLen + piece->len) {
+        uint32_t rightLeft;
+        split(pieces, piece->right, offset - leftLen - piece->len, &rightLeft, right);
+        PIECE(pieces, i)->right = rightLeft;
+        updatePiece(pieces, i);
+        *left = i;
+    } else {
+        /* The piece's rest takes its place above its right subtree, with the same priority */
+        uint64_t cut = offset - leftLen;
+        uint32_t rest = takePiece(pieces, piece->added, piece->start + cut, piece->len - cut, piece->priority);
+        piece = PIECE(pieces, i);
+        PIECE(pieces, rest)->right = piece->right;
+        updatePiece(pieces, rest);
+
+        piece->len = cut;
+        piece->newlines -= PIECE(pieces, rest)->newlines;
+        piece->right = 0;
+        updatePiece(pieces, i);
+
+        *left = i;
+        *right = rest;
+    }
+}
+
+static bool extend(TLog_Pieces* pieces, uint32_t i, uint64_t offset, uint64_t start, uint64_t len,
+        uint64_t newlines) {
+    if (!i) {
+        return false;
+    }
+
+    TLog_Piece* piece = PIECE(pieces, i);
+    uint64_t leftLen = piece->left ? PIECE(pieces, piece->left)->treeLen : 0;
+    bool extended;
+
+    if (offset <= leftLen) {
+        extended = extend(pieces, piece->left, offset, start, len, newlines);
+    } else if (offset < leftLen + piece->len) {
+        extended = false;
+    } else if (offset == leftLen + piece->len) {
+        extended = piece->added && piece->start + piece->len == start;
+        if (extended) {
+            piece->len += len;
+            piece->newlines += newlines;
+        }
+    } else {
+        extended = extend(pieces, piece->right, offset - leftLen - piece->len, start, len, newlines);
+    }
+
+    if (extended) {
+        piece->treeLen += len;
+        piece->treeNewlines += newlines;
+    }
+    return extended;
+}
+
+static void copy(TLog_Pieces* pieces, uint32_t i, uint64_t from, uint64_t to, char* dest) {
+    if (!i || from >= to) {
+        return;
+    }
+
+    TLog_Piece* piece = PIECE(pieces, i);
+    uint64_t leftLen = piece->left ? PIECE(pieces, piece->left)->treeLen : 0;
+    uint64_t pieceEnd = leftLen + piece->len;
+
+    if (from < leftLen) {
+        copy(pieces, piece->left, from, to < leftLen ? to : leftLen, dest);
+    }
+
+    uint64_t pieceFrom = from > leftLen ? from : leftLen;
+    uint64_t pieceTo = to < pieceEnd ? to : pieceEnd;
+    if (pieceFrom < pieceTo) {
+        TLog_Piece_Buffer* buffer = piece->added ? &pieces->added : &pieces->original;
+        memcpy(dest + (pieceFrom - from), buffer->text + piece->start + (pieceFrom - leftLen), pieceTo - pieceFrom);
+    }
+
+    if (to > pieceEnd) {
+        uint64_t rightFrom = from > pieceEnd ? from : pieceEnd;
+        copy(pieces, piece->right, rightFrom - pieceEnd, to - pieceEnd, dest + (rightFrom - from));
+    }
+}
@@ -0,0 +1,181 @@
+/**
+ * @file pieces.h
+ * @author Tobias Heukäufer
+ * @brief A piece table.
+ */
+
+#ifndef TLOG_SRC_PIECES_H
+#define TLOG_SRC_PIECES_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <apr_pools.h>
+
+/** @brief A piece of text, i.e. a range of one of the buffers, and the root of a subtree of pieces. */
+typedef struct tlog_piece {
+    /** @brief Wether the piece is in the added buffer (true) or the original buffer (false). */
+    bool added;
+    /** @brief First byte in the buffer. */
+    uint64_t start;
+    /** @brief Length in bytes. */
+    uint64_t len;
+    /** @brief Number of newlines. */
+    uint64_t newlines;
+
+    /** @brief Left child, or 0 for none. */
+    uint32_t left;
+    /** @brief Right child, or 0 for none. */
+    uint32_t right;
+    /** @brief Heap priority, children's priorities are not above their parent's. */
+    uint32_t priority;
+
+    /** @brief Length of the subtree in bytes. */
+    uint64_t treeLen;
+    /** @brief Number of newlines in the subtree. */
+    uint64_t treeNewlines;
+} TLog_Piece;
+
+/** @brief A buffer the pieces take their text from, with its newlines' offsets. */
+typedef struct tlog_piece_buffer {
+    /** @brief Text (allocated with malloc). */
+    char* text;
+    /** @brief Length in bytes. */
+    uint64_t len;
+    /** @brief Size in bytes. */
+    uint64_t capacity;
+
+    /** @brief Offsets of the newlines, in order (allocated with malloc). */
+    uint64_t* newlines;
+    /** @brief Number of newlines. */
+    uint64_t newlineCount;
+    /** @brief Number of newlines there is room for. */
+    uint64_t newlineCapacity;
+} TLog_Piece_Buffer;
+
+/**
+ * @brief A text as a piece table.
+ *
+ * The text is a sequence of pieces of the original buffer, which is never changed, and the added buffer,
+ * to which inserted text is appended. The pieces are kept in a treap ordered by position, with every subtree's
+ * length and number of newlines, and each buffer keeps the offsets of its newlines. So finding a line or
+ * a position's line, inserting and deleting take O(log n) (expected) for n pieces and lines, however
+ * long the text is. Typing at the end of the last insertion extends its piece rather than adding one.
+ */
+typedef struct tlog_pieces {
+    /** @brief The original buffer. */
+    TLog_Piece_Buffer original;
+    /** @brief The added buffer. */
+    TLog_Piece_Buffer added;
+
+    /** @brief Pieces, index 0 is unused so it can stand for none (allocated with malloc). */
+    TLog_Piece* pieces;
+    /** @brief Number of pieces there is room for. */
+    uint32_t capacity;
+    /** @brief Number of pieces ever used. */
+    uint32_t used;
+    /** @brief First freed piece, whose left child links the next, or 0 for none. */
+    uint32_t freed;
+    /** @brief The treap's root, or 0 for an empty text. */
+    uint32_t root;
+
+    /** @brief State of the pseudo random generator for priorities. */
+    uint64_t random;
+} TLog_Pieces;
+
+/**
+ * @brief Initializes an empty text.
+ *
+ * The buffers are freed on the pool's cleanup.
+ *
+ * @param pieces The text
+ * @param pool Memory pool
+ * @return 0 on success, or else on error
+ */
+int TLog_Pieces_Init(TLog_Pieces* pieces, apr_pool_t* pool);
+
+/**
+ * @brief Replaces a text, making the new one the original buffer.
+ *
+ * @param pieces The text
+ * @param text The new text
+ * @param len Length of the new text in bytes
+ * @return 0 on success, or else on error, leaving the text empty
+ */
+int TLog_Pieces_Set(TLog_Pieces* pieces, const char* text, size_t len);
+
+/**
+ * @brief Inserts text.
+ *
+ * @param pieces The text
+ * @param offset Byte position to insert at, at most the text's length
+ * @param text The text to insert
+ * @param len Length of the text to insert in bytes
+ * @return 0 on success, or else on error, leaving the text as it was
+ */
+int TLog_Pieces_Insert(TLog_Pieces* pieces, uint64_t offset, const char* text, size_t len);
+
+/**
+ * @brief Deletes a range of text.
+ *
+ * @param pieces The text
+ * @param from First byte position of the range
+ * @param to The byte position after the range, at most the text's length
+ * @return 0 on success, or else on error, leaving the text as it was
+ */
+int TLog_Pieces_Delete(TLog_Pieces* pieces, uint64_t from, uint64_t to);
+
+/**
+ * @brief Returns a text's length.
+ *
+ * @param pieces The text
+ * @return Length in bytes
+ */
+uint64_t TLog_Pieces_GetLen(TLog_Pieces* pieces);
+
+/**
+ * @brief Returns a text's number of lines, i.e. its number of newlines plus 1.
+ *
+ * @param pieces The text
+ * @return Number of lines
+ */
+uint64_t TLog_Pieces_GetLineCount(TLog_Pieces* pieces);
+
+/**
+ * @brief Returns where a line starts.
+ *
+ * @param pieces The text
+ * @param line Index of the line
+ * @return Byte position of the line's first byte, or the text's length if there is no such line
+ */
+uint64_t TLog_Pieces_GetLineStart(TLog_Pieces* pieces, uint64_t line);
+
+/**
+ * @brief Returns where a line ends.
+ *
+ * @param pieces The text
+ * @param line Index of the line
+ * @return Byte position of the line's newline, or the text's length for the last line
+ */
+uint64_t TLog_Pieces_GetLineEnd(TLog_Pieces* pieces, uint64_t line);
+
+/**
+ * @brief Returns the line a byte position is in.
+ *
+ * @param pieces The text
+ * @param offset The byte position, a newline belongs to the line it ends
+ * @return Index of the line
+ */
+uint64_t TLog_Pieces_GetLine(TLog_Pieces* pieces, uint64_t offset);
+
+/**
+ * @brief Copies a range of text.
+ *
+ * @param pieces The text
+ * @param from First byte position of the range
+ * @param to The byte position after the range, at most the text's length
+ * @param dest Where to copy to, room for to - from bytes
+ */
+void TLog_Pieces_Copy(TLog_Pieces* pieces, uint64_t from, uint64_t to, char* dest);
+
+#endif
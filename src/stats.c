@@ -0,0 +1,197 @@
+/**
+ * @file stats.c
+ * @author Tobias Heukäufer
+ * @brief Performance counter implementation.
+ */
+
+#include "stats.h"
+
+#include <string.h>
+#include <time.h>
+
+/*
+ * Latencies are counted in a histogram of 4 buckets per power of 2, so percentiles come out
+ * within 19% (2^(1/4)) of the true value, in constant memory however many frames there are.
+ */
+/** @brief Number of buckets per power of 2, as bits. */
+#define SUB_BUCKET_BITS 2
+/** @brief Number of latency buckets. */
+#define BUCKET_COUNT (64 << SUB_BUCKET_BITS)
+
+bool TLog_Stats_Enabled = false;
+
+/** @brief The counters. */
+static TLog_Stats stats;
+
+/** @brief Number of latencies per bucket. */
+static uint64_t latencies[BUCKET_COUNT];
+
+/** @brief The current frame's counters. */
+static TLog_Frame_Stats frame;
+
+/** @brief Time the current frame's first input was taken, or 0 if there was none. */
+static uint64_t inputTime = 0;
+
+/** @brief Function to call after every frame. */
+static TLog_Stats_FrameCallback frameCallback = NULL;
+
+/** @brief Baton to call the frame function with. */
+static void* frameBaton = NULL;
+
+/**
+ * @brief Returns the bucket of a latency.
+ * 
+ * @param ns The latency
+ * @return The bucket's index
+ */
+static size_t getBucket(uint64_t ns);
+
+/**
+ * @brief Returns the largest latency of a bucket.
+ * 
+ * @param bucket The bucket's index
+ * @return The latency
+ */
+static uint64_t getBucketMax(size_t bucket);
+
+/**
+ * @brief Returns a percentile of the latencies.
+ * 
+ * @param percent The percentile
+ * @return The latency, or 0 without latencies
+ */
+static uint64_t getPercentile(unsigned int percent);
+
+void TLog_Stats_SetEnabled(bool enabled) {
+    /* A frame half measured would be off */
+    if (enabled && !TLog_Stats_Enabled) {
+        memset(&frame, 0, sizeof(frame));
+        inputTime = 0;
+    }
+    TLog_Stats_Enabled = enabled;
+}
+
+void TLog_Stats_Get(TLog_Stats* result) {
+    if (!result) {
+        return;
+    }
+
+    *result = stats;
+    result->latencyP50Ns = getPercentile(50);
+    result->latencyP90Ns = getPercentile(90);
+    result->latencyP99Ns = getPercentile(99);
+}
+
+void TLog_Stats_Reset(void) {
+    memset(&stats, 0, sizeof(stats));
+    memset(latencies, 0, sizeof(latencies));
+    memset(&frame, 0, sizeof(frame));
+    inputTime = 0;
+}
+
+void TLog_Stats_SetFrameCallback(TLog_Stats_FrameCallback callback, void* baton) {
+    frameCallback = callback;
+    frameBaton = baton;
+}
+
+uint64_t TLog_Stats_Now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+void TLog_Stats_AddLayout(const TLog_Widget_Data* type, uint64_t ns) {
+    size_t i = 0;
+    for (; i < stats.layoutCount && stats.layouts[i].type != type; ++i);
+
+    if (i == stats.layoutCount) {
+        if (i == TLOG_STATS_MAX_TYPES) {
+            /* The last entry takes in all further types */
+            i = TLOG_STATS_MAX_TYPES - 1;
+            stats.layouts[i].type = NULL;
+        } else {
+            stats.layouts[i].type = type;
+            stats.layouts[i].calls = 0;
+            stats.layouts[i].ns = 0;
+            ++stats.layoutCount;
+        }
+    }
+
+    ++stats.layouts[i].calls;
+    stats.layouts[i].ns += ns;
+}
+
+void TLog_Stats_AddLine(bool written) {
+    ++frame.drawLineCalls;
+    frame.linesWritten += written;
+}
+
+void TLog_Stats_AddInput(void) {
+    if (inputTime == 0) {
+        inputTime = TLog_Stats_Now();
+    }
+}
+
+void TLog_Stats_AddFrame(uint64_t refreshNs, size_t bytes) {
+    frame.refreshNs = refreshNs;
+    frame.bytes = bytes;
+    frame.latencyNs = 0;
+    if (inputTime != 0) {
+        uint64_t now = TLog_Stats_Now();
+        frame.latencyNs = now > inputTime ? now - inputTime : 1;
+        ++latencies[getBucket(frame.latencyNs)];
+        ++stats.inputFrames;
+        stats.latencyMaxNs = frame.latencyNs > stats.latencyMaxNs ? frame.latencyNs : stats.latencyMaxNs;
+        inputTime = 0;
+    }
+
+    stats.drawLineCalls += frame.drawLineCalls;
+    stats.linesWritten += frame.linesWritten;
+    ++stats.refreshes;
+    stats.refreshNs += refreshNs;
+
+    if (frameCallback) {
+        frameCallback(&frame, frameBaton);
+    }
+    memset(&frame, 0, sizeof(frame));
+}
+
+static size_t getBucket(uint64_t ns) {
+    if (ns < (1u << SUB_BUCKET_BITS)) {
+        return ns;
+    }
+
+    /* The power of 2 and the next bits below the highest set bit */
+    unsigned int exponent = 63 - __builtin_clzll(ns);
+    size_t sub = (ns >> (exponent - SUB_BUCKET_BITS)) & ((1u << SUB_BUCKET_BITS) - 1);
+    return ((size_t) (exponent - SUB_BUCKET_BITS + 1) << SUB_BUCKET_BITS) + sub;
+}
+
+static uint64_t getBucketMax(size_t bucket) {
+    if (bucket < (1u << SUB_BUCKET_BITS)) {
+        return bucket;
+    }
+
+    unsigned int exponent = (bucket >> SUB_BUCKET_BITS) + SUB_BUCKET_BITS - 1;
+    uint64_t sub = bucket & ((1u << SUB_BUCKET_BITS) - 1);
+    uint64_t step = (uint64_t) 1 << (exponent - SUB_BUCKET_BITS);
+    return ((uint64_t) 1 << exponent) + (sub + 1) * step - 1;
+}
+
+static uint64_t getPercentile(unsigned int percent) {
+    if (stats.inputFrames == 0) {
+        return 0;
+    }
+
+    /* The smallest latency at least the percentage of latencies are at or below */
+    uint64_t rank = (stats.inputFrames * percent + 99) / 100;
+    uint64_t count = 0;
+    for (size_t i = 0; i < BUCKET_COUNT; ++i) {
+        count += latencies[i];
+        if (count >= rank) {
+            uint64_t max = getBucketMax(i);
+            return max < stats.latencyMaxNs ? max : stats.latencyMaxNs;
+        }
+    }
+    return stats.latencyMaxNs;
+}
@@ -0,0 +1,53 @@
+/**
+ * @file stats.h
+ * @author Tobias Heukäufer
+ * @brief Performance counter internals.
+ * 
+ * Measuring points test @ref TLog_Stats_Enabled before calling anything here, so disabled statistics
+ * cost a test each.
+ */
+
+#ifndef TLOG_SRC_STATS_H
+#define TLOG_SRC_STATS_H
+
+#include "../include/stats.h"
+
+/** @brief TRUE while statistics are collected. */
+extern bool TLog_Stats_Enabled;
+
+/**
+ * @brief Returns monotonic time.
+ * 
+ * @return Nanoseconds since an arbitrary point
+ */
+uint64_t TLog_Stats_Now(void);
+
+/**
+ * @brief Counts a widget layout call.
+ * 
+ * @param type The widget's data
+ * @param ns Nanoseconds the call took
+ */
+void TLog_Stats_AddLayout(const TLog_Widget_Data* type, uint64_t ns);
+
+/**
+ * @brief Counts a widget's drawn line.
+ * 
+ * @param written Wether the line was sent to the screen
+ */
+void TLog_Stats_AddLine(bool written);
+
+/**
+ * @brief Notes that input was taken, starting the latency of the next frame if not already started.
+ */
+void TLog_Stats_AddInput(void);
+
+/**
+ * @brief Counts a frame and calls the frame callback.
+ * 
+ * @param refreshNs Nanoseconds the refresh took
+ * @param bytes Bytes sent to the terminal, or 0 if unknown
+ */
+void TLog_Stats_AddFrame(uint64_t refreshNs, size_t bytes);
+
+#endif
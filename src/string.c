@@ -1,5 +1,6 @@
 #include "string.h"
 
+#include <stdlib.h>
 #include <string.h>
 
 #include <apr_strings.h>
@@ -8,7 +9,49 @@
 
 #define INIT_CAP 64
 
-static int ensureCapacity(TLog_String* str, size_t capacity);
+/** @brief TRUE if a byte continues a character, or FALSE if it starts one. */
+#define IS_CONTINUATION(b) (((b) & 0xc0) == 0x80)
+
+/**
+ * @brief Frees a string's buffer.
+ * 
+ * @param data The string
+ * @return Always APR_SUCCESS
+ */
+static apr_status_t freeBuffer(void* data);
+
+/**
+ * @brief Makes sure a string's gap holds a number of bytes.
+ * 
+ * @param str The string
+ * @param gap Minimum gap size in bytes
+ * @return 0 on success, or else on error
+ */
+static int ensureGap(TLog_String* str, size_t gap);
+
+/**
+ * @brief Moves a string's gap.
+ * 
+ * @param str The string
+ * @param offset New byte position of the gap
+ */
+static void moveGap(TLog_String* str, size_t offset);
+
+/**
+ * @brief Resizes a string's buffer, keeping the text.
+ * 
+ * @param str The string
+ * @param capacity New capacity, must hold the string's text
+ * @return 0 on success, or else on error
+ */
+static int resize(TLog_String* str, size_t capacity);
+
+/**
+ * @brief Halves a string's buffer while it's less than a quarter full.
+ * 
+ * @param str The string
+ */
+static void shrink(TLog_String* str);
 
 int TLog_String_Init(TLog_String* str, apr_pool_t* pool) {
     if (!str || !pool) {
@@ -17,22 +60,24 @@ int TLog_String_Init(TLog_String* str, apr_pool_t* pool) {
 
     str->pool = pool;
 
-    str->buffer = apr_palloc(pool, INIT_CAP * sizeof(char));
+    str->buffer = malloc(INIT_CAP * sizeof(char));
     if (!str->buffer) {
         return -1;
     }
+    apr_pool_cleanup_register(pool, str, freeBuffer, apr_pool_cleanup_null);
 
     str->capacity = INIT_CAP;
-    str->buffer[0] = 0;
-    str->len = str->utf8len = 0;
+    TLog_String_Clear(str);
 
     return 0;
 }
 
 void TLog_String_Clear(TLog_String* str) {
     if (str) {
-        str->buffer[0] = 0;
-        str->len = str->utf8len = 0;
+        str->gapStart = 0;
+        str->gapEnd = str->capacity;
+        str->len = str->utf8len = str->utf8cursor = 0;
+        shrink(str);
     }
 }
 
@@ -42,54 +87,266 @@ int TLog_String_Set(TLog_String* str, char* value) {
             TLog_String_Clear(str);
         } else {
             size_t newLen = strlen(value);
-            if (ensureCapacity(str, newLen + 1)) {
+            if (!TLog_UTF8_Validate(value, value + newLen)) {
                 return -1;
             }
 
-            memcpy(str->buffer, value, sizeof(char) * (newLen + 1));
-            str->len = newLen;
-            
-            char* ch;
-            for (ch = str->buffer, str->utf8len = 0; *ch != 0; ++str->utf8len, ch = TLog_UTF8_NextChar(ch));
+            TLog_String_Clear(str);
+            if (ensureGap(str, newLen)) {
+                return -1;
+            }
+
+            memcpy(str->buffer, value, sizeof(char) * newLen);
+            str->gapStart = str->len = newLen;
+            str->utf8len = str->utf8cursor = TLog_UTF8_Count(str->buffer, str->buffer + newLen);
         }
     }
     return 0;
 }
 
-int TLog_String_AppendASCII(TLog_String* str, char ch) {
+int TLog_String_InsertASCII(TLog_String* str, char ch) {
     if (str && ch >= ' ') {
-        if (ensureCapacity(str, str->len + 2)) {
+        if (ensureGap(str, 1)) {
             return -1;
         }
-        
-        str->buffer[str->len] = ch;
+
+        str->buffer[str->gapStart] = ch;
+        ++str->gapStart;
         ++str->len;
         ++str->utf8len;
-        str->buffer[str->len] = 0;
+        ++str->utf8cursor;
     }
     return 0;
 }
 
-void TLog_String_Pop(TLog_String* str) {
-    if (str && str->utf8len > 0) {
-        char* last = TLog_UTF8_PrevChar(&str->buffer[str->len]);
-        str->len = last - str->buffer;
-        str->buffer[str->len] = 0;
-        --str->utf8len;
+int TLog_String_InsertASCIIText(TLog_String* str, const char* text, size_t len) {
+    if (!str || !text) {
+        return -1;
+    }
+
+    if (ensureGap(str, len)) {
+        return -1;
+    }
+
+    char* gap = &str->buffer[str->gapStart];
+    for (const char* end = text + len; text < end; ++text) {
+        if (*text >= ' ') {
+            *gap++ = *text;
+        }
     }
+
+    size_t inserted = gap - &str->buffer[str->gapStart];
+    str->gapStart += inserted;
+    str->len += inserted;
+    str->utf8len += inserted;
+    str->utf8cursor += inserted;
+
+    return 0;
 }
 
-static int ensureCapacity(TLog_String* str, size_t capacity) {
-    if (capacity > str->capacity) {
+int TLog_String_Insert(TLog_String* str, const char* text, size_t len) {
+    if (!str || !text) {
+        return -1;
+    }
+
+    if (ensureGap(str, len)) {
+        return -1;
+    }
+
+    size_t count = TLog_UTF8_Count(text, text + len);
+    memcpy(str->buffer + str->gapStart, text, sizeof(char) * len);
+    str->gapStart += len;
+    str->len += len;
+    str->utf8len += count;
+    str->utf8cursor += count;
+
+    return 0;
+}
+
+bool TLog_String_DeleteBackward(TLog_String* str) {
+    if (!str || str->utf8cursor == 0) {
+        return false;
+    }
+
+    size_t start = str->gapStart - 1;
+    while (start > 0 && IS_CONTINUATION(str->buffer[start])) {
+        --start;
+    }
+
+    str->len -= str->gapStart - start;
+    str->gapStart = start;
+    --str->utf8len;
+    --str->utf8cursor;
+    shrink(str);
+
+    return true;
+}
+
+bool TLog_String_DeleteForward(TLog_String* str) {
+    if (!str || str->utf8cursor == str->utf8len) {
+        return false;
+    }
+
+    size_t end = str->gapEnd + 1;
+    while (end < str->capacity && IS_CONTINUATION(str->buffer[end])) {
+        ++end;
+    }
+
+    str->len -= end - str->gapEnd;
+    str->gapEnd = end;
+    --str->utf8len;
+    shrink(str);
+
+    return true;
+}
+
+void TLog_String_Delete(TLog_String* str, size_t count) {
+    if (str && count > 0) {
+        count = count < str->utf8len - str->utf8cursor ? count : str->utf8len - str->utf8cursor;
+        const char* afterGap = str->buffer + str->gapEnd;
+        size_t end = TLog_UTF8_Seek(afterGap, str->buffer + str->capacity, count) - str->buffer;
+
+        str->len -= end - str->gapEnd;
+        str->gapEnd = end;
+        str->utf8len -= count;
+        shrink(str);
+    }
+}
+
+void TLog_String_Truncate(TLog_String* str, size_t utf8len) {
+    if (str && utf8len < str->utf8len) {
+        TLog_String_MoveCursor(str, utf8len);
+        str->gapEnd = str->capacity;
+        str->len = str->gapStart;
+        str->utf8len = utf8len;
+        shrink(str);
+    }
+}
+
+void TLog_String_MoveCursor(TLog_String* str, size_t utf8cursor) {
+    if (str) {
+        utf8cursor = utf8cursor < str->utf8len ? utf8cursor : str->utf8len;
+        moveGap(str, TLog_String_Offset(str, utf8cursor));
+        str->utf8cursor = utf8cursor;
+    }
+}
+
+size_t TLog_String_Offset(TLog_String* str, size_t index) {
+    if (index >= str->utf8len) {
+        return str->len;
+    } else if (index < str->utf8cursor / 2) {
+        return TLog_UTF8_Seek(str->buffer, str->buffer + str->gapStart, index) - str->buffer;
+    } else if (index < str->utf8cursor) {
+        /* Closer to the cursor than to the start, so walk back from the gap */
+        size_t offset = str->gapStart;
+        size_t todo = str->utf8cursor - index;
+        while (todo > 0) {
+            --offset;
+            if (!IS_CONTINUATION(str->buffer[offset])) {
+                --todo;
+            }
+        }
+        return offset;
+    } else {
+        const char* afterGap = str->buffer + str->gapEnd;
+        return str->gapStart
+                + (TLog_UTF8_Seek(afterGap, str->buffer + str->capacity, index - str->utf8cursor) - afterGap);
+    }
+}
+
+void TLog_String_GetRange(TLog_String* str, size_t from, size_t to,
+        const char** first, size_t* firstLen, const char** second, size_t* secondLen) {
+    to = to < str->len ? to : str->len;
+    from = from < to ? from : to;
+
+    *first = str->buffer + from;
+    *firstLen = from < str->gapStart ? (to < str->gapStart ? to : str->gapStart) - from : 0;
+
+    size_t secondFrom = from > str->gapStart ? from : str->gapStart;
+    *second = str->buffer + str->gapEnd + (secondFrom - str->gapStart);
+    *secondLen = to > secondFrom ? to - secondFrom : 0;
+}
+
+size_t TLog_String_GetWaste(TLog_String* str) {
+    return str->capacity - str->len;
+}
+
+char* TLog_String_Dup(TLog_String* str, apr_pool_t* pool) {
+    char* copy = apr_palloc(pool, (str->len + 1) * sizeof(char));
+    if (copy) {
+        size_t afterGapLen = str->capacity - str->gapEnd;
+        memcpy(copy, str->buffer, sizeof(char) * str->gapStart);
+        memcpy(copy + str->gapStart, str->buffer + str->gapEnd, sizeof(char) * afterGapLen);
+        copy[str->len] = 0;
+    }
+    return copy;
+}
+
+static apr_status_t freeBuffer(void* data) {
+    TLog_String* str = data;
+    free(str->buffer);
+    str->buffer = NULL;
+    str->capacity = 0;
+    return APR_SUCCESS;
+}
+
+static int ensureGap(TLog_String* str, size_t gap) {
+    if (str->gapEnd - str->gapStart < gap) {
         size_t newCapacity;
-        for (newCapacity = str->capacity; newCapacity < capacity; newCapacity *= 2);
-        
-        char* newBuffer = apr_palloc(str->pool, newCapacity * sizeof(char));
+        for (newCapacity = str->capacity; newCapacity - str->len < gap; newCapacity *= 2);
+        return resize(str, newCapacity);
+    }
+    return 0;
+}
+
+static void moveGap(TLog_String* str, size_t offset) {
+    if (offset < str->gapStart) {
+        size_t count = str->gapStart - offset;
+        memmove(str->buffer + str->gapEnd - count, str->buffer + offset, sizeof(char) * count);
+        str->gapStart -= count;
+        str->gapEnd -= count;
+    } else if (offset > str->gapStart) {
+        size_t count = offset - str->gapStart;
+        memmove(str->buffer + str->gapStart, str->buffer + str->gapEnd, sizeof(char) * count);
+        str->gapStart += count;
+        str->gapEnd += count;
+    }
+}
+
+static int resize(TLog_String* str, size_t capacity) {
+    size_t afterGapLen = str->capacity - str->gapEnd;
+
+    if (capacity < str->capacity) {
+        /* Keep the text after the gap at the end of the buffer */
+        memmove(str->buffer + capacity - afterGapLen, str->buffer + str->gapEnd, sizeof(char) * afterGapLen);
+        str->gapEnd = capacity - afterGapLen;
+        str->capacity = capacity;
+
+        /* If shrinking fails, the old buffer will just not be used completely */
+        char* newBuffer = realloc(str->buffer, capacity * sizeof(char));
+        str->buffer = newBuffer ? newBuffer : str->buffer;
+    } else if (capacity > str->capacity) {
+        char* newBuffer = realloc(str->buffer, capacity * sizeof(char));
         if (!newBuffer) {
             return -1;
         }
 
-        memcpy(newBuffer, str->buffer, sizeof(char) * (str->len + 1));
+        /* Keep the text after the gap at the end of the buffer */
+        memmove(newBuffer + capacity - afterGapLen, newBuffer + str->gapEnd, sizeof(char) * afterGapLen);
+        str->buffer = newBuffer;
+        str->gapEnd = capacity - afterGapLen;
+        str->capacity = capacity;
     }
+
     return 0;
 }
+
+static void shrink(TLog_String* str) {
+    size_t newCapacity = str->capacity;
+    while (newCapacity > INIT_CAP && str->len < newCapacity / 4) {
+        newCapacity /= 2;
+    }
+    if (newCapacity < str->capacity) {
+        resize(str, newCapacity);
+    }
+}
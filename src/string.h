@@ -1,3 +1,9 @@
+/**
+ * @file string.h
+ * @author Tobias Heukäufer
+ * @brief A gap buffer string.
+ */
+
 #ifndef TLOG_SRC_STRING_H
 #define TLOG_SRC_STRING_H
 
@@ -6,28 +12,176 @@
 #include <apr_pools.h>
 #include <apr_tables.h>
 
+/**
+ * @brief A UTF-8 string with a cursor.
+ * 
+ * The text is stored with a gap at the cursor, i.e. in buffer[0, gapStart) and buffer[gapEnd, capacity),
+ * so inserting and deleting at the cursor only moves bytes when the cursor moves.
+ */
 typedef struct tlog_string {
+    /** @brief Memory pool, the buffer is freed on its cleanup. */
     apr_pool_t* pool;
 
+    /** @brief Buffer (allocated with malloc). */
     char* buffer;
+    /** @brief Buffer's size in bytes. */
     size_t capacity;
+    /** @brief First byte of the gap, i.e. the cursor's byte position. */
+    size_t gapStart;
+    /** @brief The byte after the gap. */
+    size_t gapEnd;
+
+    /** @brief Length in bytes. */
     size_t len;
+    /** @brief Length in codepoints. */
     size_t utf8len;
+    /** @brief The cursor's position in codepoints. */
+    size_t utf8cursor;
 } TLog_String;
 
-// TODO Document
+/**
+ * @brief Initializes an empty string.
+ * 
+ * @param str The string
+ * @param pool Memory pool
+ * @return 0 on success, or else on error
+ */
 int TLog_String_Init(TLog_String* str, apr_pool_t* pool);
 
-// TODO Document
+/**
+ * @brief Empties a string.
+ * 
+ * @param str The string
+ */
 void TLog_String_Clear(TLog_String* str);
 
-// TODO Document
+/**
+ * @brief Sets a string's text and puts the cursor at its end.
+ * 
+ * @param str The string
+ * @param value The text, or NULL to empty the string
+ * @return 0 on success, or else on error (e.g. malformed UTF-8)
+ */
 int TLog_String_Set(TLog_String* str, char* value);
 
-// TODO Document
-int TLog_String_AppendASCII(TLog_String* str, char ch);
+/**
+ * @brief Inserts an ASCII character at the cursor and moves the cursor behind it.
+ * 
+ * Control characters are ignored.
+ * 
+ * @param str The string
+ * @param ch The character
+ * @return 0 on success, or else on error
+ */
+int TLog_String_InsertASCII(TLog_String* str, char ch);
+
+/**
+ * @brief Inserts ASCII characters at the cursor and moves the cursor behind them.
+ * 
+ * Control characters are ignored.
+ * 
+ * @param str The string
+ * @param text The characters (not NUL-terminated)
+ * @param len Number of characters
+ * @return 0 on success, or else on error
+ */
+int TLog_String_InsertASCIIText(TLog_String* str, const char* text, size_t len);
+
+/**
+ * @brief Inserts UTF-8 text at the cursor and moves the cursor behind it.
+ * 
+ * Unlike typed characters, the text is inserted as it is, so it must be well-formed.
+ * 
+ * @param str The string
+ * @param text The UTF-8 text (not NUL-terminated)
+ * @param len Length of the text in bytes
+ * @return 0 on success, or else on error
+ */
+int TLog_String_Insert(TLog_String* str, const char* text, size_t len);
+
+/**
+ * @brief Deletes the character before the cursor.
+ * 
+ * @param str The string
+ * @return TRUE if a character was deleted, or FALSE else
+ */
+bool TLog_String_DeleteBackward(TLog_String* str);
+
+/**
+ * @brief Deletes the character after the cursor.
+ * 
+ * @param str The string
+ * @return TRUE if a character was deleted, or FALSE else
+ */
+bool TLog_String_DeleteForward(TLog_String* str);
+
+/**
+ * @brief Deletes characters after the cursor.
+ * 
+ * @param str The string
+ * @param count Number of characters, will be clamped to the characters after the cursor
+ */
+void TLog_String_Delete(TLog_String* str, size_t count);
+
+/**
+ * @brief Drops every character from an index on.
+ * 
+ * @param str The string
+ * @param utf8len New maximum length in codepoints
+ */
+void TLog_String_Truncate(TLog_String* str, size_t utf8len);
+
+/**
+ * @brief Moves a string's cursor.
+ * 
+ * @param str The string
+ * @param utf8cursor New cursor position in codepoints, will be clamped to the string's length
+ */
+void TLog_String_MoveCursor(TLog_String* str, size_t utf8cursor);
+
+/**
+ * @brief Returns the byte position of a character.
+ * 
+ * @param str The string
+ * @param index Index of the character in codepoints
+ * @return The character's byte position (ignoring the gap), or the string's length if out of range
+ */
+size_t TLog_String_Offset(TLog_String* str, size_t index);
+
+/**
+ * @brief Returns a byte range of a string.
+ * 
+ * As the range may span the gap, it is returned as two parts.
+ * 
+ * @param str The string
+ * @param from First byte position of the range
+ * @param to The byte position after the range
+ * @param first Where to store the first part
+ * @param firstLen Where to store the first part's length
+ * @param second Where to store the second part
+ * @param secondLen Where to store the second part's length
+ */
+void TLog_String_GetRange(TLog_String* str, size_t from, size_t to,
+        const char** first, size_t* firstLen, const char** second, size_t* secondLen);
+
+/**
+ * @brief Returns the number of bytes a string's buffer holds but doesn't use.
+ * 
+ * A string's buffer grows by doubling and shrinks by halving while less than a quarter is used,
+ * so the waste is bounded by three times the string's length (or the initial capacity).
+ * 
+ * @param str The string
+ * @return Unused bytes
+ */
+size_t TLog_String_GetWaste(TLog_String* str);
 
-// TODO Document
-void TLog_String_Pop(TLog_String* str);
+/**
+ * @brief Returns a NUL-terminated copy of a string's text.
+ * 
+ * @param str The string
+ * @param pool Memory pool for the copy
+ * @return The copy, or NULL on error
+ */
+char* TLog_String_Dup(TLog_String* str, apr_pool_t* pool);
 
 #endif
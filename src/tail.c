@@ -0,0 +1,363 @@
+/**
+ * @file tail.c
+ * @author Tobias Heukäufer
+ * @brief A tail implementation.
+ */
+
+#include "../include/tail.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../include/draw.h"
+#include "utf8.h"
+
+/* Thanks! https://stackoverflow.com/a/3599170 */
+/** @brief Marks unused function parameters to prevent unused warnings. */
+#define UNUSED(x) (void)(x)
+
+/** @brief Minimum number of bytes a tail keeps. */
+#define MIN_CAPACITY 4096
+
+/** @brief Average line length a tail's line index is sized for. */
+#define AVERAGE_LINE_LEN 32
+
+/** @brief Maximum number of bytes read per update, so input is still handled while the tail is flooded. */
+#define MAX_UPDATE_LEN (16 * 1024 * 1024)
+
+/** @brief Maximum number of bytes of a line that are drawn. */
+#define MAX_DRAWN_LEN 4096
+
+struct tlog_tail {
+    /** @brief Widget data. */
+    const TLog_Widget_Data* data;
+
+    /** @brief File descriptor to read from. */
+    int fd;
+    /** @brief Wether the file descriptor reached its end. */
+    bool finished;
+
+    /** @brief Ring of the last bytes read. */
+    char* buffer;
+    /** @brief Size of the byte ring minus 1, its size is a power of 2. */
+    size_t mask;
+    /** @brief Number of bytes read in total. */
+    uint64_t written;
+
+    /** @brief Ring of the last lines' starts, as offsets into all bytes read. */
+    uint64_t* lineStarts;
+    /** @brief Size of the line ring minus 1, its size is a power of 2. */
+    size_t lineMask;
+    /** @brief Number of lines started in total, the last one is still being read. */
+    uint64_t lineCount;
+
+    /** @brief Number of lines shown. */
+    uint32_t rows;
+    /** @brief Width. */
+    uint32_t width;
+    /** @brief Wether the newest lines are shown. */
+    bool follow;
+    /** @brief Index of the first line shown, if not following. */
+    uint64_t top;
+
+    /** @brief Buffer to put together lines wrapping around the byte ring's end. */
+    char* scratch;
+};
+
+static uint32_t getPreferedWidth(TLog_Widget* widget);
+static uint32_t setMaximumWidth(TLog_Widget* widget, uint32_t maxWidth, uint32_t screenHeight);
+static void drawLine(TLog_Widget* widget, uint32_t lineY);
+static void update(TLog_Widget* widget, uint32_t* dirtyStart, uint32_t* dirtyEnd);
+
+/**
+ * @brief Adds the lines started in bytes just read to a tail's line index.
+ *
+ * @param tail The tail
+ * @param bytes The bytes
+ * @param len Number of bytes
+ */
+static void indexLines(TLog_Tail* tail, const char* bytes, size_t len);
+
+/**
+ * @brief Returns the offset of a tail's oldest byte still kept.
+ *
+ * @param tail The tail
+ * @return Offset into all bytes read
+ */
+static uint64_t getOldestByte(TLog_Tail* tail);
+
+/**
+ * @brief Returns where a line starts, or the oldest byte kept if its start was dropped.
+ *
+ * @param tail The tail
+ * @param line Index of the line
+ * @return Offset into all bytes read
+ */
+static uint64_t getLineStart(TLog_Tail* tail, uint64_t line);
+
+/**
+ * @brief Returns where a line ends, excluding its newline.
+ *
+ * @param tail The tail
+ * @param line Index of the line
+ * @return Offset into all bytes read
+ */
+static uint64_t getLineEnd(TLog_Tail* tail, uint64_t line);
+
+/**
+ * @brief Returns the index of a tail's oldest line of which bytes are kept.
+ *
+ * @param tail The tail
+ * @return Index of the line
+ */
+static uint64_t getFirstLine(TLog_Tail* tail);
+
+/**
+ * @brief Returns the index after a tail's newest line, not counting an empty line still being read.
+ *
+ * @param tail The tail
+ * @return Index after the line
+ */
+static uint64_t getEndLine(TLog_Tail* tail);
+
+/**
+ * @brief Returns the index of the first line a tail shows.
+ *
+ * @param tail The tail
+ * @return Index of the line
+ */
+static uint64_t getTop(TLog_Tail* tail);
+
+/** @brief Tail widget functions. */
+static const TLog_Widget_Data TLOG_TAIL_DATA = {
+    &getPreferedWidth,
+    &setMaximumWidth,
+    &drawLine,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    &update
+};
+
+TLog_Tail* TLog_Tail_Create(apr_pool_t* pool, int fd, uint32_t rows, size_t capacity) {
+    if (fd < 0 || rows == 0) {
+        goto fail;
+    }
+
+    /* Reading must never keep Tobylog from handling input */
+    int flags = fcntl(fd, F_GETFL);
+    if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0) {
+        goto fail;
+    }
+
+    TLog_Tail* tail = apr_palloc(pool, sizeof(TLog_Tail));
+    if (!tail) {
+        goto fail;
+    }
+
+    tail->data = &TLOG_TAIL_DATA;
+
+    tail->fd = fd;
+    tail->finished = false;
+
+    size_t size = MIN_CAPACITY;
+    while (size < capacity) {
+        size *= 2;
+    }
+    tail->buffer = apr_palloc(pool, size);
+    if (!tail->buffer) {
+        goto fail;
+    }
+    tail->mask = size - 1;
+    tail->written = 0;
+
+    size_t lineSize = size / AVERAGE_LINE_LEN;
+    while (lineSize <= rows) {
+        lineSize *= 2;
+    }
+    tail->lineStarts = apr_palloc(pool, sizeof(uint64_t) * lineSize);
+    if (!tail->lineStarts) {
+        goto fail;
+    }
+    tail->lineMask = lineSize - 1;
+    tail->lineStarts[0] = 0;
+    tail->lineCount = 1;
+
+    tail->rows = rows;
+    tail->width = 1;
+    tail->follow = true;
+    tail->top = 0;
+
+    tail->scratch = apr_palloc(pool, MAX_DRAWN_LEN);
+    if (!tail->scratch) {
+        goto fail;
+    }
+
+    return tail;
+
+    fail:
+    return NULL;
+}
+
+void TLog_Tail_SetFollow(TLog_Tail* tail, bool follow) {
+    if (tail && tail->follow != follow) {
+        /* Stay where following got to */
+        tail->top = getTop(tail);
+        tail->follow = follow;
+    }
+}
+
+bool TLog_Tail_IsFinished(TLog_Tail* tail) {
+    return !tail || tail->finished;
+}
+
+uint64_t TLog_Tail_GetBytesRead(TLog_Tail* tail) {
+    return tail ? tail->written : 0;
+}
+
+static uint32_t getPreferedWidth(TLog_Widget* widget) {
+    UNUSED(widget);
+    return UINT32_MAX;
+}
+
+static uint32_t setMaximumWidth(TLog_Widget* widget, uint32_t maxWidth, uint32_t screenHeight) {
+    UNUSED(screenHeight);
+
+    TLog_Tail* tail = (TLog_Tail*) widget;
+    tail->width = maxWidth > 0 ? maxWidth : 1;
+
+    return tail->rows;
+}
+
+static void drawLine(TLog_Widget* widget, uint32_t lineY) {
+    TLog_Tail* tail = (TLog_Tail*) widget;
+    uint64_t line = getTop(tail) + lineY;
+    if (line >= getEndLine(tail)) {
+        return;
+    }
+
+    uint64_t start = getLineStart(tail, line);
+    uint64_t end = getLineEnd(tail, line);
+
+    /* A line whose start was dropped may start within a character */
+    if (start > tail->lineStarts[line & tail->lineMask]) {
+        for (; start < end && (tail->buffer[start & tail->mask] & 0xc0) == 0x80; ++start);
+    }
+
+    size_t len = end - start < MAX_DRAWN_LEN ? end - start : MAX_DRAWN_LEN;
+    size_t offset = start & tail->mask;
+    const char* text = tail->buffer + offset;
+    if (offset + len > tail->mask + 1) {
+        size_t firstLen = tail->mask + 1 - offset;
+        memcpy(tail->scratch, text, firstLen);
+        memcpy(tail->scratch + firstLen, tail->buffer, len - firstLen);
+        text = tail->scratch;
+    }
+
+    const char* cut = TLog_UTF8_SeekWidth(text, text + len, tail->width, NULL);
+    TLog_Draw_Text(text, cut - text);
+}
+
+static void update(TLog_Widget* widget, uint32_t* dirtyStart, uint32_t* dirtyEnd) {
+    TLog_Tail* tail = (TLog_Tail*) widget;
+
+    *dirtyStart = *dirtyEnd = 0;
+    if (tail->finished) {
+        return;
+    }
+
+    uint64_t oldWritten = tail->written;
+    uint64_t oldTop = getTop(tail);
+    uint64_t oldLast = tail->lineCount - 1;
+
+    for (size_t budget = MAX_UPDATE_LEN; budget > 0; ) {
+        size_t offset = tail->written & tail->mask;
+        size_t len = tail->mask + 1 - offset;
+        len = len < budget ? len : budget;
+
+        ssize_t got = read(tail->fd, tail->buffer + offset, len);
+        if (got > 0) {
+            indexLines(tail, tail->buffer + offset, got);
+            tail->written += got;
+            budget -= got;
+        } else if (got < 0 && errno == EINTR) {
+            continue;
+        } else {
+            tail->finished = got == 0 || (errno != EAGAIN && errno != EWOULDBLOCK);
+            break;
+        }
+    }
+
+    if (tail->written == oldWritten) {
+        return;
+    }
+
+    /* Lines from the one being read on changed, or all of them if they moved */
+    uint64_t top = getTop(tail);
+    uint64_t firstDirty = oldLast;
+    if (top != oldTop || getLineStart(tail, top) > tail->lineStarts[top & tail->lineMask]) {
+        firstDirty = top;
+    }
+    if (firstDirty < top + tail->rows) {
+        *dirtyStart = firstDirty > top ? firstDirty - top : 0;
+        *dirtyEnd = tail->rows;
+    }
+}
+
+static void indexLines(TLog_Tail* tail, const char* bytes, size_t len) {
+    const char* end = bytes + len;
+    for (const char* newline = memchr(bytes, '\n', len); newline;
+            newline = memchr(newline + 1, '\n', end - newline - 1)) {
+        tail->lineStarts[tail->lineCount & tail->lineMask] = tail->written + (newline - bytes) + 1;
+        ++tail->lineCount;
+    }
+}
+
+static uint64_t getOldestByte(TLog_Tail* tail) {
+    return tail->written > tail->mask + 1 ? tail->written - (tail->mask + 1) : 0;
+}
+
+static uint64_t getLineStart(TLog_Tail* tail, uint64_t line) {
+    uint64_t start = tail->lineStarts[line & tail->lineMask];
+    uint64_t oldest = getOldestByte(tail);
+    return start > oldest ? start : oldest;
+}
+
+static uint64_t getLineEnd(TLog_Tail* tail, uint64_t line) {
+    return line + 1 < tail->lineCount ? tail->lineStarts[(line + 1) & tail->lineMask] - 1 : tail->written;
+}
+
+static uint64_t getFirstLine(TLog_Tail* tail) {
+    uint64_t oldest = getOldestByte(tail);
+    uint64_t first = tail->lineCount > tail->lineMask + 1 ? tail->lineCount - (tail->lineMask + 1) : 0;
+    uint64_t last = tail->lineCount - 1;
+
+    /* Line starts only grow, so search for the first line whose newline is kept */
+    while (first < last) {
+        uint64_t middle = first + (last - first) / 2;
+        if (tail->lineStarts[(middle + 1) & tail->lineMask] > oldest) {
+            last = middle;
+        } else {
+            first = middle + 1;
+        }
+    }
+
+    return first;
+}
+
+static uint64_t getEndLine(TLog_Tail* tail) {
+    uint64_t last = tail->lineCount - 1;
+    return tail->lineStarts[last & tail->lineMask] < tail->written ? last + 1 : last;
+}
+
+static uint64_t getTop(TLog_Tail* tail) {
+    uint64_t first = getFirstLine(tail);
+    if (tail->follow) {
+        uint64_t end = getEndLine(tail);
+        return end > first + tail->rows ? end - tail->rows : first;
+    }
+    return tail->top > first ? tail->top : first;
+}
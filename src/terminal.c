@@ -0,0 +1,219 @@
+/**
+ * @file terminal.c
+ * @author Tobias Heukäufer
+ * @brief The ncurses backend implementation.
+ */
+
+#include "terminal.h"
+
+#include <unistd.h>
+
+#include <ncurses.h>
+
+/* Thanks! https://stackoverflow.com/a/3599170 */
+/** @brief Marks unused function parameters to prevent unused warnings. */
+#define UNUSED(x) (void)(x)
+
+/** @brief Key code for the start of bracketed paste. */
+#define KEY_PASTE_START (KEY_MAX + 1)
+/** @brief Key code for the end of bracketed paste. */
+#define KEY_PASTE_END (KEY_MAX + 2)
+
+/** @brief An ncurses backend. */
+typedef struct tlog_terminal {
+    /** @brief Backend data. */
+    const TLog_Backend_Data* data;
+} TLog_Terminal;
+
+static bool start(TLog_Backend* backend);
+static void stop(TLog_Backend* backend);
+static void getSize(TLog_Backend* backend, uint32_t* width, uint32_t* height);
+static void moveCursor(TLog_Backend* backend, uint32_t y, uint32_t x);
+static void addText(TLog_Backend* backend, const char* text, size_t len);
+static void setAttribute(TLog_Backend* backend, TLog_Attribute attribute);
+static void clearToEol(TLog_Backend* backend);
+static void clearScreen(TLog_Backend* backend);
+static void scrollScreen(TLog_Backend* backend, int lines);
+static void flush(TLog_Backend* backend);
+static void getInput(TLog_Backend* backend, int timeout, TLog_Input* input);
+static int getFd(TLog_Backend* backend);
+
+/**
+ * @brief Derives an action value from an ncurses input.
+ * 
+ * @param input ncurses input
+ * @param action Where to put the action value
+ * @return TRUE if an action value was derived, or FALSE else 
+ */
+static bool getAction(int input, TLog_Widget_Action* action);
+
+/** @brief ncurses backend functions. */
+static const TLog_Backend_Data TLOG_TERMINAL_DATA = {
+    &start,
+    &stop,
+    &getSize,
+    &moveCursor,
+    &addText,
+    &setAttribute,
+    &clearToEol,
+    &clearScreen,
+    &scrollScreen,
+    &flush,
+    NULL,
+    &getInput,
+    &getFd
+};
+
+TLog_Backend* TLog_Terminal_Create(apr_pool_t* pool) {
+    TLog_Terminal* terminal = apr_palloc(pool, sizeof(TLog_Terminal));
+    if (!terminal) {
+        goto fail;
+    }
+
+    terminal->data = &TLOG_TERMINAL_DATA;
+
+    return (TLog_Backend*) terminal;
+
+    fail:
+    return NULL;
+}
+
+static bool start(TLog_Backend* backend) {
+    UNUSED(backend);
+
+    if (!initscr()) {
+        return false;
+    }
+
+    cbreak();
+    keypad(stdscr, TRUE);
+    noecho();
+    scrollok(stdscr, TRUE);
+    /* Let ncurses scroll by the terminal's line insertion and deletion instead of redrawing */
+    idlok(stdscr, TRUE);
+
+    /* Have the terminal enclose pasted text, so it isn't taken for typed keys */
+    define_key("\033[200~", KEY_PASTE_START);
+    define_key("\033[201~", KEY_PASTE_END);
+    putp("\033[?2004h");
+    fflush(stdout);
+
+    return true;
+}
+
+static void stop(TLog_Backend* backend) {
+    UNUSED(backend);
+    putp("\033[?2004l");
+    fflush(stdout);
+    endwin();
+}
+
+static void getSize(TLog_Backend* backend, uint32_t* width, uint32_t* height) {
+    UNUSED(backend);
+    *width = COLS;
+    *height = LINES;
+}
+
+static void moveCursor(TLog_Backend* backend, uint32_t y, uint32_t x) {
+    UNUSED(backend);
+    move(y, x);
+}
+
+static void addText(TLog_Backend* backend, const char* text, size_t len) {
+    UNUSED(backend);
+    addnstr(text, len);
+}
+
+static void setAttribute(TLog_Backend* backend, TLog_Attribute attribute) {
+    UNUSED(backend);
+    attrset(attribute == TLOG_ATTRIBUTE_REVERSE ? A_REVERSE : A_NORMAL);
+}
+
+static void clearToEol(TLog_Backend* backend) {
+    UNUSED(backend);
+    clrtoeol();
+}
+
+static void clearScreen(TLog_Backend* backend) {
+    UNUSED(backend);
+    clear();
+}
+
+static void scrollScreen(TLog_Backend* backend, int lines) {
+    UNUSED(backend);
+    scrl(lines);
+}
+
+static void flush(TLog_Backend* backend) {
+    UNUSED(backend);
+    refresh();
+}
+
+static void getInput(TLog_Backend* backend, int waitTimeout, TLog_Input* input) {
+    UNUSED(backend);
+
+    timeout(waitTimeout);
+    int ch = getch();
+    if (ch >= 32 && ch <= 126) {
+        input->type = TLOG_INPUT_CHAR;
+        input->ch = (char) ch;
+    } else if (getAction(ch, &input->action)) {
+        input->type = TLOG_INPUT_ACTION;
+    } else if (ch == ERR) {
+        input->type = waitTimeout < 0 ? TLOG_INPUT_END : TLOG_INPUT_NONE;
+    } else if (ch == KEY_PASTE_START) {
+        input->type = TLOG_INPUT_PASTE_START;
+    } else if (ch == KEY_PASTE_END) {
+        input->type = TLOG_INPUT_PASTE_END;
+    } else if (ch == KEY_RESIZE) {
+        /* ncurses caught SIGWINCH and updated COLS and LINES */
+        input->type = TLOG_INPUT_RESIZE;
+    } else {
+        input->type = TLOG_INPUT_OTHER;
+    }
+}
+
+static int getFd(TLog_Backend* backend) {
+    UNUSED(backend);
+    return STDIN_FILENO;
+}
+
+static bool getAction(int input, TLog_Widget_Action* action) {
+    if (input == '\n') {
+        *action = TLOG_WIDGET_ACTION_RETURN;
+    } else if (input == 0x1b) {
+        *action = TLOG_WIDGET_ACTION_ESC;
+    } else if (input == '\t') {
+        *action = TLOG_WIDGET_ACTION_TAB;
+    } else if (input == KEY_BTAB) {
+        *action = TLOG_WIDGET_ACTION_SHIFT_TAB;
+    } else if (input == KEY_BACKSPACE) {
+        *action = TLOG_WIDGET_ACTION_BACKSPACE;
+    } else if (input == KEY_UP) {
+        *action = TLOG_WIDGET_ACTION_UP;
+    } else if (input == KEY_DOWN) {
+        *action = TLOG_WIDGET_ACTION_DOWN;
+    } else if (input == KEY_LEFT) {
+        *action = TLOG_WIDGET_ACTION_LEFT;
+    } else if (input == KEY_RIGHT) {
+        *action = TLOG_WIDGET_ACTION_RIGHT;
+    } else if (input == KEY_DC) {
+        *action = TLOG_WIDGET_ACTION_DELETE;
+    } else if (input == KEY_HOME) {
+        *action = TLOG_WIDGET_ACTION_HOME;
+    } else if (input == KEY_END) {
+        *action = TLOG_WIDGET_ACTION_END;
+    } else if (input == KEY_PPAGE) {
+        *action = TLOG_WIDGET_ACTION_PAGE_UP;
+    } else if (input == KEY_NPAGE) {
+        *action = TLOG_WIDGET_ACTION_PAGE_DOWN;
+    } else if (input == 0x1f) {
+        /* Ctrl+Z would suspend the process, so undo takes the key readline and Emacs use */
+        *action = TLOG_WIDGET_ACTION_UNDO;
+    } else if (input == 0x12) {
+        *action = TLOG_WIDGET_ACTION_REDO;
+    } else {
+        return false;
+    }
+    return true;
+}
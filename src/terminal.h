@@ -0,0 +1,22 @@
+/**
+ * @file terminal.h
+ * @author Tobias Heukäufer
+ * @brief The ncurses backend.
+ */
+
+#ifndef TLOG_SRC_TERMINAL_H
+#define TLOG_SRC_TERMINAL_H
+
+#include <apr_pools.h>
+
+#include "../include/backend.h"
+
+/**
+ * @brief Creates an ncurses backend.
+ * 
+ * @param pool Memory pool
+ * @return A new ncurses backend, or NULL on error
+ */
+TLog_Backend* TLog_Terminal_Create(apr_pool_t* pool);
+
+#endif
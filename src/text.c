@@ -11,8 +11,8 @@
 
 #include <apr_strings.h>
 
-#include <ncurses.h>
-
+#include "../include/draw.h"
+#include "history.h"
 #include "string.h"
 #include "utf8.h"
 
@@ -20,6 +20,9 @@
 /** @brief Marks unused function parameters to prevent unused warnings. */
 #define UNUSED(x) (void)(x)
 
+/** @brief Default number of bytes the undo history takes at most. */
+#define DEFAULT_HISTORY_BUDGET (1024 * 1024)
+
 struct tlog_text {
     /** @brief Widget data. */
     const TLog_Widget_Data* data;
@@ -32,10 +35,14 @@ struct tlog_text {
 
     /** @brief Text. */
     TLog_String text;
-    /** @brief Index of the first visible character. */
+    /** @brief Index of the first visible character in codepoints. */
     size_t firstVis;
     /** @brief Maximum text length. */
     size_t maxLen;
+    /** @brief Wether the text is printable ASCII only, so every character takes one column. */
+    bool isASCII;
+    /** @brief Undo history. */
+    TLog_History history;
 
     /** @brief Wether to consume Return input (true) or not (false). */
     bool consumeReturn;
@@ -47,16 +54,48 @@ static void drawLine(TLog_Widget* widget, uint32_t lineY);
 static void setFocus(TLog_Widget* widget, bool fromAbove, uint32_t* cursorX, uint32_t* cursorY);
 static void putChar(TLog_Widget* widget, char ch,
         uint32_t* cursorX, uint32_t* cursorY, uint32_t* dirtyStart, uint32_t* dirtyEnd);
+static void putText(TLog_Widget* widget, const char* chars, size_t len,
+        uint32_t* cursorX, uint32_t* cursorY, uint32_t* dirtyStart, uint32_t* dirtyEnd);
 static bool putAction(TLog_Widget* widget, TLog_Widget_Action action,
         uint32_t* cursorX, uint32_t* cursorY, uint32_t* dirtyStart, uint32_t* dirtyEnd);
 
+/**
+ * @brief Scrolls a text field so its cursor is visible and as much text as possible is shown.
+ * 
+ * @param text The text field
+ */
+static void scrollToCursor(TLog_Text* text);
+
+/**
+ * @brief Counts the columns a text field's characters take, up to a limit.
+ * 
+ * @param text The text field
+ * @param from Index of the first character in codepoints
+ * @param to Index after the last character in codepoints
+ * @param limit Maximum number of columns to count
+ * @return Number of columns, or limit + 1 if the characters take more than limit columns
+ */
+static size_t getColumns(TLog_Text* text, size_t from, size_t to, size_t limit);
+
+/**
+ * @brief Finds where the characters before an index that fit some columns start.
+ * 
+ * @param text The text field
+ * @param to Index after the last character in codepoints
+ * @param columns Number of columns
+ * @return Index of the first fitting character in codepoints
+ */
+static size_t seekColumnsBackward(TLog_Text* text, size_t to, size_t columns);
+
 static const TLog_Widget_Data TLOG_TEXT_DATA = {
     &getPreferedWidth,
     &setMaximumWidth,
     &drawLine,
     &setFocus,
     &putChar,
-    &putAction
+    &putAction,
+    &putText,
+    NULL
 };
 
 TLog_Text* TLog_Text_Create(apr_pool_t* pool, size_t maximumWidth) {
@@ -69,8 +108,15 @@ TLog_Text* TLog_Text_Create(apr_pool_t* pool, size_t maximumWidth) {
 
     text->pool = pool;
 
-    TLog_String_Init(&text->text, text->pool);
+    text->width = 1;
+    text->firstVis = 0;
+
+    if (TLog_String_Init(&text->text, text->pool)) {
+        goto fail;
+    }
     text->maxLen = maximumWidth;
+    text->isASCII = true;
+    TLog_History_Init(&text->history, text->pool, DEFAULT_HISTORY_BUDGET);
 
     text->consumeReturn = 0;
 
@@ -89,11 +135,40 @@ void TLog_Text_SetConsumeReturn(TLog_Text* text, bool consumeReturn) {
 void TLog_Text_SetText(TLog_Text* text, char* value) {
     if (text) {
         TLog_String_Set(&text->text, value);
+        TLog_String_Truncate(&text->text, text->maxLen);
+        TLog_History_Clear(&text->history);
+
+        /* Typed characters are ASCII, so only set text may hold anything else */
+        const char* first;
+        const char* second;
+        size_t firstLen, secondLen;
+        TLog_String_GetRange(&text->text, 0, text->text.len, &first, &firstLen, &second, &secondLen);
+        text->isASCII = TLog_UTF8_SkipASCII(first, first + firstLen) == first + firstLen
+                && TLog_UTF8_SkipASCII(second, second + secondLen) == second + secondLen;
+
+        scrollToCursor(text);
     }
 }
 
 char* TLog_Text_GetText(TLog_Text* text, apr_pool_t* pool) {
-    return text ? apr_pstrdup(pool, text->text.buffer) : NULL;
+    return text ? TLog_String_Dup(&text->text, pool) : NULL;
+}
+
+void TLog_Text_SetHistoryBudget(TLog_Text* text, size_t budget) {
+    if (text) {
+        TLog_History_SetBudget(&text->history, budget);
+    }
+}
+
+void TLog_Text_GetMemoryUsage(TLog_Text* text, size_t* capacity, size_t* wasted) {
+    if (text) {
+        if (capacity) {
+            *capacity = text->text.capacity;
+        }
+        if (wasted) {
+            *wasted = TLog_String_GetWaste(&text->text);
+        }
+    }
 }
 
 static uint32_t getPreferedWidth(TLog_Widget* widget) {
@@ -106,12 +181,8 @@ static uint32_t setMaximumWidth(TLog_Widget* widget, uint32_t maxWidth, uint32_t
     TLog_Text* text = (TLog_Text*) widget;
 
     text->width = maxWidth < text->maxLen + 1 ? maxWidth : text->maxLen + 1;
-
-    char* ch = &text->text.buffer[text->text.len];
-    for (size_t i = 0;
-        i < text->width - 1 && ch != &text->text.buffer[0];
-        ++i, ch = TLog_UTF8_PrevChar(ch));
-    text->firstVis = ch - &text->text.buffer[0];
+    text->width = text->width > 0 ? text->width : 1;
+    scrollToCursor(text);
 
     return 1;
 }
@@ -120,22 +191,35 @@ static void drawLine(TLog_Widget* widget, uint32_t lineY) {
     UNUSED(lineY);
 
     TLog_Text* text = (TLog_Text*) widget;
+    TLog_String* str = &text->text;
+
+    const char* first;
+    const char* second;
+    size_t firstLen, secondLen;
+    TLog_String_GetRange(str, TLog_String_Offset(str, text->firstVis), str->len,
+            &first, &firstLen, &second, &secondLen);
+
+    /* Show as many characters as fit, a wide character that doesn't fit completely is left out */
+    size_t firstWidth, secondWidth = 0;
+    const char* firstEnd = TLog_UTF8_SeekWidth(first, first + firstLen, text->width, &firstWidth);
+    const char* secondEnd = second;
+    if (firstEnd == first + firstLen) {
+        secondEnd = TLog_UTF8_SeekWidth(second, second + secondLen, text->width - firstWidth, &secondWidth);
+    }
 
-    attrset(A_REVERSE);
+    TLog_Draw_SetAttribute(TLOG_ATTRIBUTE_REVERSE);
 
-    addstr(&text->text.buffer[text->firstVis]);
-    addch(' ');
+    TLog_Draw_Text(first, firstEnd - first);
+    TLog_Draw_Text(second, secondEnd - second);
 
-    for (size_t done = text->text.utf8len + 1; done < text->width; ++done) {
-        addch(' ');
-    }
+    TLog_Draw_Fill(' ', text->width - firstWidth - secondWidth);
 }
 
 static void setFocus(TLog_Widget* widget, bool fromAbove, uint32_t* cursorX, uint32_t* cursorY) {
     UNUSED(fromAbove);
 
     TLog_Text* text = (TLog_Text*) widget;
-    *cursorX = text->text.utf8len < text->width ? text->text.utf8len : text->width - 1;
+    *cursorX = getColumns(text, text->firstVis, text->text.utf8cursor, text->width - 1);
     *cursorY = 0;
 }
 
@@ -146,41 +230,148 @@ static void putChar(TLog_Widget* widget, char ch,
     *dirtyStart = *dirtyEnd = 0;
 
     if (text->text.utf8len < text->maxLen) {
-        TLog_String_AppendASCII(&text->text, ch);
-
-        if (text->text.utf8len >= text->width) {
-            text->firstVis += TLog_UTF8_CharLen(&text->text.buffer[text->firstVis]);
-        }
+        size_t from = text->text.utf8cursor;
+        TLog_String_InsertASCII(&text->text, ch);
+        TLog_History_AddInsert(&text->history, &text->text, from);
+        scrollToCursor(text);
 
         setFocus(widget, 0, cursorX, cursorY);
         
         *dirtyEnd = 1;
     }
 }
+
+static void putText(TLog_Widget* widget, const char* chars, size_t len,
+        uint32_t* cursorX, uint32_t* cursorY, uint32_t* dirtyStart, uint32_t* dirtyEnd) {
+    TLog_Text* text = (TLog_Text*) widget;
+
+    *dirtyStart = *dirtyEnd = 0;
+
+    /* Characters beyond the maximum length are dropped, as they would be one by one */
+    size_t room = text->maxLen - text->text.utf8len;
+    len = len < room ? len : room;
+    if (len > 0) {
+        size_t from = text->text.utf8cursor;
+        TLog_String_InsertASCIIText(&text->text, chars, len);
+        TLog_History_AddInsert(&text->history, &text->text, from);
+        scrollToCursor(text);
+
+        setFocus(widget, 0, cursorX, cursorY);
+
+        *dirtyEnd = 1;
+    }
+}
         
 static bool putAction(TLog_Widget* widget, TLog_Widget_Action action,
         uint32_t* cursorX, uint32_t* cursorY, uint32_t* dirtyStart, uint32_t* dirtyEnd) {
     TLog_Text* text = (TLog_Text*) widget;
-    bool consumed = false;
+    TLog_String* str = &text->text;
+    bool consumed = true;
+    bool changed = false;
 
     *dirtyStart = *dirtyEnd = 0;
 
+    /* Typing or deleting goes on as one edit until the cursor moves */
+    if (action != TLOG_WIDGET_ACTION_BACKSPACE && action != TLOG_WIDGET_ACTION_DELETE) {
+        TLog_History_Break(&text->history);
+    }
+
     if (action == TLOG_WIDGET_ACTION_BACKSPACE) {
-        if (text->text.utf8len > 0) {
-            TLog_String_Pop(&text->text);
+        changed = TLog_History_DeleteBackward(&text->history, str);
+    } else if (action == TLOG_WIDGET_ACTION_DELETE) {
+        changed = TLog_History_DeleteForward(&text->history, str);
+    } else if (action == TLOG_WIDGET_ACTION_UNDO) {
+        changed = TLog_History_Undo(&text->history, str);
+    } else if (action == TLOG_WIDGET_ACTION_REDO) {
+        changed = TLog_History_Redo(&text->history, str);
+    } else if (action == TLOG_WIDGET_ACTION_LEFT) {
+        if (str->utf8cursor > 0) {
+            TLog_String_MoveCursor(str, str->utf8cursor - 1);
+            changed = true;
+        }
+    } else if (action == TLOG_WIDGET_ACTION_RIGHT) {
+        if (str->utf8cursor < str->utf8len) {
+            TLog_String_MoveCursor(str, str->utf8cursor + 1);
+            changed = true;
+        }
+    } else if (action == TLOG_WIDGET_ACTION_HOME) {
+        /* If the cursor can't move, Home and End move through the widgets instead */
+        changed = consumed = str->utf8cursor > 0;
+        TLog_String_MoveCursor(str, 0);
+    } else if (action == TLOG_WIDGET_ACTION_END) {
+        changed = consumed = str->utf8cursor < str->utf8len;
+        TLog_String_MoveCursor(str, str->utf8len);
+    } else {
+        consumed = text->consumeReturn && action == TLOG_WIDGET_ACTION_RETURN;
+    }
+
+    if (changed) {
+        scrollToCursor(text);
+        setFocus(widget, 0, cursorX, cursorY);
+        *dirtyEnd = 1;
+    }
+
+    return consumed;
+}
 
-            if (text->firstVis > 0) {
-                text->firstVis -= TLog_UTF8_CharLen(TLog_UTF8_PrevChar(&text->text.buffer[text->firstVis]));
-            }
+static void scrollToCursor(TLog_Text* text) {
+    size_t cursor = text->text.utf8cursor;
+    size_t lastCol = text->width - 1;
 
-            setFocus(widget, 0, cursorX, cursorY);
+    /* Don't leave empty space at the end while there's hidden text at the start */
+    size_t maxFirstVis = seekColumnsBackward(text, text->text.utf8len, lastCol);
+    text->firstVis = text->firstVis < maxFirstVis ? text->firstVis : maxFirstVis;
 
-            *dirtyEnd = 1;
-        }
-        consumed = true;
-    } else if (text->consumeReturn && action == TLOG_WIDGET_ACTION_RETURN) {
-        consumed = true;
+    if (cursor < text->firstVis) {
+        text->firstVis = cursor;
+    } else if (getColumns(text, text->firstVis, cursor, lastCol) > lastCol) {
+        text->firstVis = seekColumnsBackward(text, cursor, lastCol);
     }
+}
 
-    return consumed;
+static size_t getColumns(TLog_Text* text, size_t from, size_t to, size_t limit) {
+    TLog_String* str = &text->text;
+
+    if (text->isASCII) {
+        return to - from <= limit ? to - from : limit + 1;
+    }
+
+    const char* first;
+    const char* second;
+    size_t firstLen, secondLen;
+    TLog_String_GetRange(str, TLog_String_Offset(str, from), TLog_String_Offset(str, to),
+            &first, &firstLen, &second, &secondLen);
+
+    size_t firstWidth, secondWidth;
+    if (TLog_UTF8_SeekWidth(first, first + firstLen, limit, &firstWidth) != first + firstLen
+            || TLog_UTF8_SeekWidth(second, second + secondLen, limit - firstWidth, &secondWidth)
+                    != second + secondLen) {
+        return limit + 1;
+    }
+
+    return firstWidth + secondWidth;
+}
+
+static size_t seekColumnsBackward(TLog_Text* text, size_t to, size_t columns) {
+    TLog_String* str = &text->text;
+
+    if (text->isASCII) {
+        return to > columns ? to - columns : 0;
+    }
+
+    const char* first;
+    const char* second;
+    size_t firstLen, secondLen;
+    TLog_String_GetRange(str, 0, TLog_String_Offset(str, to), &first, &firstLen, &second, &secondLen);
+
+    /* Walk back over the part after the gap, then over the part before it */
+    size_t secondWidth;
+    const char* fit = TLog_UTF8_SeekWidthBackward(second, second + secondLen, columns, &secondWidth);
+    size_t count = TLog_UTF8_Count(fit, second + secondLen);
+    if (fit == second) {
+        fit = TLog_UTF8_SeekWidthBackward(first, first + firstLen, columns - secondWidth, NULL);
+        count += TLog_UTF8_Count(fit, first + firstLen);
+    }
+
+    return to - count;
 }
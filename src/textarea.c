@@ -0,0 +1,520 @@
+/**
+ * @file textarea.c
+ * @author Tobias Heukäufer
+ * @brief A text area implementation.
+ */
+
+#include "../include/textarea.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "../include/draw.h"
+#include "pieces.h"
+#include "utf8.h"
+
+/* Thanks! https://stackoverflow.com/a/3599170 */
+/** @brief Marks unused function parameters to prevent unused warnings. */
+#define UNUSED(x) (void)(x)
+
+/** @brief TRUE if a byte continues a character, or FALSE if it starts one. */
+#define IS_CONTINUATION(b) (((b) & 0xc0) == 0x80)
+
+/** @brief Maximum length of a UTF-8 character in bytes. */
+#define MAX_CHAR_LEN 4
+
+/** @brief Initial size of the line buffer in bytes. */
+#define INIT_LINE_CAPACITY 256
+
+/** @brief Stands for all lines after an edited line, as the lines below it moved. */
+#define ALL_LINES UINT64_MAX
+
+struct tlog_text_area {
+    /** @brief Widget data. */
+    const TLog_Widget_Data* data;
+
+    /** @brief Pool. */
+    apr_pool_t* pool;
+
+    /** @brief Text. */
+    TLog_Pieces text;
+
+    /** @brief Number of lines shown. */
+    uint32_t rows;
+    /** @brief Prefered width. */
+    uint32_t preferedWidth;
+    /** @brief Width. */
+    uint32_t width;
+
+    /** @brief Cursor's byte position. */
+    uint64_t cursor;
+    /** @brief Line the cursor is in. */
+    uint64_t cursorLine;
+    /** @brief Column Up and Down try to keep the cursor in. */
+    size_t goalColumn;
+
+    /** @brief Index of the first line shown. */
+    uint64_t top;
+    /** @brief First column shown. */
+    size_t left;
+
+    /** @brief Buffer a line is copied to, to measure and draw it (allocated with malloc). */
+    char* line;
+    /** @brief Line buffer's size in bytes. */
+    size_t lineCapacity;
+};
+
+static uint32_t getPreferedWidth(TLog_Widget* widget);
+static uint32_t setMaximumWidth(TLog_Widget* widget, uint32_t maxWidth, uint32_t screenHeight);
+static void drawLine(TLog_Widget* widget, uint32_t lineY);
+static void setFocus(TLog_Widget* widget, bool fromAbove, uint32_t* cursorX, uint32_t* cursorY);
+static void putChar(TLog_Widget* widget, char ch,
+        uint32_t* cursorX, uint32_t* cursorY, uint32_t* dirtyStart, uint32_t* dirtyEnd);
+static void putText(TLog_Widget* widget, const char* chars, size_t len,
+        uint32_t* cursorX, uint32_t* cursorY, uint32_t* dirtyStart, uint32_t* dirtyEnd);
+static bool putAction(TLog_Widget* widget, TLog_Widget_Action action,
+        uint32_t* cursorX, uint32_t* cursorY, uint32_t* dirtyStart, uint32_t* dirtyEnd);
+
+/**
+ * @brief Frees a text area's line buffer.
+ *
+ * @param data The text area
+ * @return Always APR_SUCCESS
+ */
+static apr_status_t freeLine(void* data);
+
+/**
+ * @brief Copies a range of a text area's text to its line buffer.
+ *
+ * @param area The text area
+ * @param from First byte position of the range
+ * @param to The byte position after the range
+ * @param len Where to store the number of bytes copied, less than the range's if the buffer can't grow
+ * @return The line buffer
+ */
+static const char* copyRange(TLog_TextArea* area, uint64_t from, uint64_t to, size_t* len);
+
+/**
+ * @brief Returns the column a byte position of the cursor's line is in.
+ *
+ * @param area The text area
+ * @param offset The byte position
+ * @return The column
+ */
+static size_t getColumn(TLog_TextArea* area, uint64_t offset);
+
+/**
+ * @brief Moves the cursor to a line, as close to a column as the line allows.
+ *
+ * @param area The text area
+ * @param line Index of the line
+ * @param column The column
+ */
+static void moveToColumn(TLog_TextArea* area, uint64_t line, size_t column);
+
+/**
+ * @brief Moves the cursor.
+ *
+ * @param area The text area
+ * @param offset New byte position
+ * @param keepGoal Wether Up and Down keep aiming for the same column (true) or the cursor's new one (false)
+ */
+static void moveCursor(TLog_TextArea* area, uint64_t offset, bool keepGoal);
+
+/**
+ * @brief Returns where the character before a byte position starts.
+ *
+ * @param area The text area
+ * @param offset The byte position, after the text's start
+ * @return Byte position of the character
+ */
+static uint64_t getPrevChar(TLog_TextArea* area, uint64_t offset);
+
+/**
+ * @brief Returns where the character after a byte position ends.
+ *
+ * @param area The text area
+ * @param offset The byte position, before the text's end
+ * @return Byte position after the character
+ */
+static uint64_t getNextChar(TLog_TextArea* area, uint64_t offset);
+
+/**
+ * @brief Scrolls a text area to show its cursor, and tells the layout manager what to draw.
+ *
+ * @param area The text area
+ * @param firstEdited Index of the first edited line
+ * @param endEdited Index after the last edited line, or @ref ALL_LINES
+ * @param cursorX Where to store the cursor X position in widget space
+ * @param cursorY Where to store the cursor Y position in widget space
+ * @param dirtyStart Index of first dirty line
+ * @param dirtyEnd Index after last dirty line
+ */
+static void showCursor(TLog_TextArea* area, uint64_t firstEdited, uint64_t endEdited,
+        uint32_t* cursorX, uint32_t* cursorY, uint32_t* dirtyStart, uint32_t* dirtyEnd);
+
+/** @brief Text area widget functions. */
+static const TLog_Widget_Data TLOG_TEXT_AREA_DATA = {
+    &getPreferedWidth,
+    &setMaximumWidth,
+    &drawLine,
+    &setFocus,
+    &putChar,
+    &putAction,
+    &putText,
+    NULL
+};
+
+TLog_TextArea* TLog_TextArea_Create(apr_pool_t* pool, uint32_t rows, uint32_t width) {
+    if (rows == 0) {
+        goto fail;
+    }
+
+    TLog_TextArea* area = apr_palloc(pool, sizeof(TLog_TextArea));
+    if (!area) {
+        goto fail;
+    }
+
+    area->data = &TLOG_TEXT_AREA_DATA;
+
+    area->pool = pool;
+
+    if (TLog_Pieces_Init(&area->text, pool)) {
+        goto fail;
+    }
+
+    area->rows = rows;
+    area->preferedWidth = width > 0 ? width : UINT32_MAX;
+    area->width = 1;
+
+    area->cursor = area->cursorLine = 0;
+    area->goalColumn = 0;
+    area->top = 0;
+    area->left = 0;
+
+    area->line = malloc(INIT_LINE_CAPACITY);
+    if (!area->line) {
+        goto fail;
+    }
+    area->lineCapacity = INIT_LINE_CAPACITY;
+    apr_pool_cleanup_register(pool, area, freeLine, apr_pool_cleanup_null);
+
+    return area;
+
+    fail:
+    return NULL;
+}
+
+bool TLog_TextArea_SetText(TLog_TextArea* area, const char* text, size_t len) {
+    if (!area) {
+        return false;
+    }
+
+    area->cursor = area->cursorLine = 0;
+    area->goalColumn = 0;
+    area->top = 0;
+    area->left = 0;
+
+    if ((len > 0 && !TLog_UTF8_Validate(text, text + len)) || TLog_Pieces_Set(&area->text, text, len)) {
+        TLog_Pieces_Set(&area->text, NULL, 0);
+        return false;
+    }
+
+    return true;
+}
+
+char* TLog_TextArea_GetText(TLog_TextArea* area, apr_pool_t* pool) {
+    if (!area) {
+        return NULL;
+    }
+
+    uint64_t len = TLog_Pieces_GetLen(&area->text);
+    char* text = apr_palloc(pool, len + 1);
+    if (!text) {
+        return NULL;
+    }
+    TLog_Pieces_Copy(&area->text, 0, len, text);
+    text[len] = '\0';
+
+    return text;
+}
+
+uint64_t TLog_TextArea_GetLineCount(TLog_TextArea* area) {
+    return area ? TLog_Pieces_GetLineCount(&area->text) : 1;
+}
+
+void TLog_TextArea_GoToLine(TLog_TextArea* area, uint64_t line) {
+    if (area) {
+        uint64_t lastLine = TLog_Pieces_GetLineCount(&area->text) - 1;
+        moveCursor(area, TLog_Pieces_GetLineStart(&area->text, line < lastLine ? line : lastLine), false);
+
+        uint32_t cursorX, cursorY, dirtyStart, dirtyEnd;
+        showCursor(area, 0, 0, &cursorX, &cursorY, &dirtyStart, &dirtyEnd);
+    }
+}
+
+uint64_t TLog_TextArea_GetCursorLine(TLog_TextArea* area) {
+    return area ? area->cursorLine : 0;
+}
+
+static uint32_t getPreferedWidth(TLog_Widget* widget) {
+    return ((TLog_TextArea*) widget)->preferedWidth;
+}
+
+static uint32_t setMaximumWidth(TLog_Widget* widget, uint32_t maxWidth, uint32_t screenHeight) {
+    UNUSED(screenHeight);
+
+    TLog_TextArea* area = (TLog_TextArea*) widget;
+    area->width = maxWidth < area->preferedWidth ? maxWidth : area->preferedWidth;
+    area->width = area->width > 0 ? area->width : 1;
+
+    uint32_t cursorX, cursorY, dirtyStart, dirtyEnd;
+    showCursor(area, 0, 0, &cursorX, &cursorY, &dirtyStart, &dirtyEnd);
+
+    return area->rows;
+}
+
+static void drawLine(TLog_Widget* widget, uint32_t lineY) {
+    TLog_TextArea* area = (TLog_TextArea*) widget;
+    uint64_t line = area->top + lineY;
+
+    TLog_Draw_SetAttribute(TLOG_ATTRIBUTE_REVERSE);
+    if (line >= TLog_Pieces_GetLineCount(&area->text)) {
+        TLog_Draw_Fill(' ', area->width);
+        return;
+    }
+
+    size_t len;
+    const char* text = copyRange(area, TLog_Pieces_GetLineStart(&area->text, line),
+            TLog_Pieces_GetLineEnd(&area->text, line), &len);
+    const char* end = text + len;
+
+    /* Skip the columns scrolled away, a wide character cut by them leaves blanks */
+    size_t taken;
+    const char* start = TLog_UTF8_SeekWidth(text, end, area->left, &taken);
+    size_t pad = 0;
+    if (taken < area->left && start < end) {
+        pad = taken + TLog_UTF8_CharWidth(start, end, &start) - area->left;
+    }
+    pad = pad < area->width ? pad : area->width;
+    TLog_Draw_Fill(' ', pad);
+
+    const char* cut = TLog_UTF8_SeekWidth(start, end, area->width - pad, &taken);
+    TLog_Draw_Text(start, cut - start);
+    TLog_Draw_Fill(' ', area->width - pad - taken);
+}
+
+static void setFocus(TLog_Widget* widget, bool fromAbove, uint32_t* cursorX, uint32_t* cursorY) {
+    UNUSED(fromAbove);
+
+    TLog_TextArea* area = (TLog_TextArea*) widget;
+    *cursorX = getColumn(area, area->cursor) - area->left;
+    *cursorY = area->cursorLine - area->top;
+}
+
+static void putChar(TLog_Widget* widget, char ch,
+        uint32_t* cursorX, uint32_t* cursorY, uint32_t* dirtyStart, uint32_t* dirtyEnd) {
+    putText(widget, &ch, 1, cursorX, cursorY, dirtyStart, dirtyEnd);
+}
+
+static void putText(TLog_Widget* widget, const char* chars, size_t len,
+        uint32_t* cursorX, uint32_t* cursorY, uint32_t* dirtyStart, uint32_t* dirtyEnd) {
+    TLog_TextArea* area = (TLog_TextArea*) widget;
+    uint64_t line = area->cursorLine;
+
+    *dirtyStart = *dirtyEnd = 0;
+    if (TLog_Pieces_Insert(&area->text, area->cursor, chars, len)) {
+        return;
+    }
+
+    /* Pasted line breaks move all lines below */
+    moveCursor(area, area->cursor + len, false);
+    showCursor(area, line, memchr(chars, '\n', len) ? ALL_LINES : line + 1, cursorX, cursorY, dirtyStart, dirtyEnd);
+}
+
+static bool putAction(TLog_Widget* widget, TLog_Widget_Action action,
+        uint32_t* cursorX, uint32_t* cursorY, uint32_t* dirtyStart, uint32_t* dirtyEnd) {
+    TLog_TextArea* area = (TLog_TextArea*) widget;
+    TLog_Pieces* text = &area->text;
+    uint64_t len = TLog_Pieces_GetLen(text);
+    uint64_t line = area->cursorLine;
+    uint64_t lastLine = TLog_Pieces_GetLineCount(text) - 1;
+    uint64_t firstEdited = 0;
+    uint64_t endEdited = 0;
+
+    *dirtyStart = *dirtyEnd = 0;
+
+    if (action == TLOG_WIDGET_ACTION_RETURN) {
+        if (TLog_Pieces_Insert(text, area->cursor, "\n", 1) == 0) {
+            moveCursor(area, area->cursor + 1, false);
+            firstEdited = line;
+            endEdited = ALL_LINES;
+        }
+    } else if (action == TLOG_WIDGET_ACTION_BACKSPACE) {
+        if (area->cursor > 0) {
+            uint64_t prev = getPrevChar(area, area->cursor);
+            if (TLog_Pieces_Delete(text, prev, area->cursor) == 0) {
+                moveCursor(area, prev, false);
+                firstEdited = area->cursorLine;
+                endEdited = area->cursorLine != line ? ALL_LINES : line + 1;
+            }
+        }
+    } else if (action == TLOG_WIDGET_ACTION_DELETE) {
+        if (area->cursor < len) {
+            uint64_t next = getNextChar(area, area->cursor);
+            if (TLog_Pieces_Delete(text, area->cursor, next) == 0) {
+                firstEdited = line;
+                endEdited = TLog_Pieces_GetLineCount(text) - 1 != lastLine ? ALL_LINES : line + 1;
+                moveCursor(area, area->cursor, false);
+            }
+        }
+    } else if (action == TLOG_WIDGET_ACTION_LEFT) {
+        if (area->cursor > 0) {
+            moveCursor(area, getPrevChar(area, area->cursor), false);
+        }
+    } else if (action == TLOG_WIDGET_ACTION_RIGHT) {
+        if (area->cursor < len) {
+            moveCursor(area, getNextChar(area, area->cursor), false);
+        }
+    } else if (action == TLOG_WIDGET_ACTION_UP) {
+        /* At the text's ends, Up and Down move through the widgets instead */
+        if (line == 0) {
+            return false;
+        }
+        moveToColumn(area, line - 1, area->goalColumn);
+    } else if (action == TLOG_WIDGET_ACTION_DOWN) {
+        if (line == lastLine) {
+            return false;
+        }
+        moveToColumn(area, line + 1, area->goalColumn);
+    } else if (action == TLOG_WIDGET_ACTION_PAGE_UP) {
+        moveToColumn(area, line > area->rows ? line - area->rows : 0, area->goalColumn);
+    } else if (action == TLOG_WIDGET_ACTION_PAGE_DOWN) {
+        moveToColumn(area, lastLine - line > area->rows ? line + area->rows : lastLine, area->goalColumn);
+    } else if (action == TLOG_WIDGET_ACTION_HOME) {
+        /* If the cursor can't move, Home and End move through the widgets instead */
+        uint64_t start = TLog_Pieces_GetLineStart(text, line);
+        if (area->cursor == start) {
+            return false;
+        }
+        moveCursor(area, start, false);
+    } else if (action == TLOG_WIDGET_ACTION_END) {
+        uint64_t end = TLog_Pieces_GetLineEnd(text, line);
+        if (area->cursor == end) {
+            return false;
+        }
+        moveCursor(area, end, false);
+    } else {
+        return false;
+    }
+
+    showCursor(area, firstEdited, endEdited, cursorX, cursorY, dirtyStart, dirtyEnd);
+
+    return true;
+}
+
+static apr_status_t freeLine(void* data) {
+    TLog_TextArea* area = data;
+
+    free(area->line);
+
+    return APR_SUCCESS;
+}
+
+static const char* copyRange(TLog_TextArea* area, uint64_t from, uint64_t to, size_t* len) {
+    if (to - from > area->lineCapacity) {
+        size_t capacity = area->lineCapacity;
+        while (capacity < to - from) {
+            capacity *= 2;
+        }
+
+        /* Lines are drawn after errors can be reported, so a line too long to copy is cut off */
+        char* line = realloc(area->line, capacity);
+        if (line) {
+            area->line = line;
+            area->lineCapacity = capacity;
+        }
+    }
+
+    to = to - from < area->lineCapacity ? to : from + area->lineCapacity;
+    TLog_Pieces_Copy(&area->text, from, to, area->line);
+    *len = to - from;
+
+    return area->line;
+}
+
+static size_t getColumn(TLog_TextArea* area, uint64_t offset) {
+    size_t len;
+    const char* text = copyRange(area, TLog_Pieces_GetLineStart(&area->text, area->cursorLine), offset, &len);
+    return TLog_UTF8_Width(text, text + len);
+}
+
+static void moveToColumn(TLog_TextArea* area, uint64_t line, size_t column) {
+    uint64_t start = TLog_Pieces_GetLineStart(&area->text, line);
+
+    size_t len;
+    const char* text = copyRange(area, start, TLog_Pieces_GetLineEnd(&area->text, line), &len);
+    const char* fit = TLog_UTF8_SeekWidth(text, text + len, column, NULL);
+
+    moveCursor(area, start + (fit - text), true);
+}
+
+static void moveCursor(TLog_TextArea* area, uint64_t offset, bool keepGoal) {
+    area->cursor = offset;
+    area->cursorLine = TLog_Pieces_GetLine(&area->text, offset);
+    if (!keepGoal) {
+        area->goalColumn = getColumn(area, offset);
+    }
+}
+
+static uint64_t getPrevChar(TLog_TextArea* area, uint64_t offset) {
+    char bytes[MAX_CHAR_LEN];
+    uint64_t from = offset > MAX_CHAR_LEN ? offset - MAX_CHAR_LEN : 0;
+    TLog_Pieces_Copy(&area->text, from, offset, bytes);
+
+    size_t i = offset - from - 1;
+    for (; i > 0 && IS_CONTINUATION(bytes[i]); --i);
+    return from + i;
+}
+
+static uint64_t getNextChar(TLog_TextArea* area, uint64_t offset) {
+    char bytes[MAX_CHAR_LEN];
+    uint64_t len = TLog_Pieces_GetLen(&area->text);
+    uint64_t to = len - offset > MAX_CHAR_LEN ? offset + MAX_CHAR_LEN : len;
+    TLog_Pieces_Copy(&area->text, offset, to, bytes);
+
+    size_t i = 1;
+    for (; i < to - offset && IS_CONTINUATION(bytes[i]); ++i);
+    return offset + i;
+}
+
+static void showCursor(TLog_TextArea* area, uint64_t firstEdited, uint64_t endEdited,
+        uint32_t* cursorX, uint32_t* cursorY, uint32_t* dirtyStart, uint32_t* dirtyEnd) {
+    uint64_t oldTop = area->top;
+    size_t oldLeft = area->left;
+
+    if (area->cursorLine < area->top) {
+        area->top = area->cursorLine;
+    } else if (area->cursorLine - area->top >= area->rows) {
+        area->top = area->cursorLine - area->rows + 1;
+    }
+
+    /* The cursor takes the last column when at a line's end */
+    size_t column = getColumn(area, area->cursor);
+    if (column < area->left) {
+        area->left = column;
+    } else if (column - area->left >= area->width) {
+        area->left = column - area->width + 1;
+    }
+
+    *dirtyStart = *dirtyEnd = 0;
+    if (area->top != oldTop || area->left != oldLeft) {
+        *dirtyEnd = area->rows;
+    } else if (firstEdited < endEdited && firstEdited < area->top + area->rows && endEdited > area->top) {
+        *dirtyStart = firstEdited > area->top ? firstEdited - area->top : 0;
+        *dirtyEnd = endEdited - area->top < area->rows ? endEdited - area->top : area->rows;
+    }
+
+    *cursorX = column - area->left;
+    *cursorY = area->cursorLine - area->top;
+}
@@ -6,10 +6,18 @@
 
 #include "../include/tobylog.h"
 
-#include <ncurses.h>
 #include <string.h>
+#include <unistd.h>
 
+#include <apr_atomic.h>
 #include <apr_tables.h>
+#include <apr_thread_proc.h>
+
+#include "../include/draw.h"
+#include "loop.h"
+#include "stats.h"
+#include "terminal.h"
+#include "utf8.h"
 
 /* Thanks! https://stackoverflow.com/a/3599170 */
 /** @brief Marks unused function parameters to prevent unused warnings. */
@@ -17,76 +25,559 @@
 
 #define DEFAULT_WIDGET_COUNT 12
 
+/** @brief Initial capacity of the input batch. */
+#define INIT_BATCH_CAPACITY 64
+
+/** @brief Maximum length of a cell's text in bytes, a character and zero width characters following it. */
+#define MAX_CELL_LEN 8
+
+/** @brief Length of the cell right of a wide character, which is written along with it. */
+#define CONTINUATION_LEN UINT8_MAX
+
+/** @brief Milliseconds to wait for input at most, while widgets take in outside changes. */
+#define UPDATE_INTERVAL 20
+
+/** @brief Minimum number of unchanged cells worth moving the cursor over instead of writing them again. */
+#define MIN_SKIP 8
+
+/**
+ * @brief A screen cell.
+ * 
+ * Unused bytes are 0, so cells can be compared by memcmp(). All-zero cells are blank.
+ */
+typedef struct tlog_shadow_cell {
+    /** @brief The cell's text. */
+    char ch[MAX_CELL_LEN];
+    /** @brief Length of the cell's text in bytes, 0 if blank, or @ref CONTINUATION_LEN. */
+    uint8_t len;
+    /** @brief The cell's attribute. */
+    uint8_t attribute;
+} TLog_Shadow_Cell;
+
+/** @brief A copy of what the screen shows, so only changed cells are written. */
+typedef struct tlog_shadow {
+    /** @brief Screen width. */
+    uint32_t width;
+    /** @brief Screen height. */
+    uint32_t height;
+    /** @brief Cells on screen, row by row. */
+    TLog_Shadow_Cell* cells;
+
+    /** @brief The line being drawn. */
+    TLog_Shadow_Cell* line;
+    /** @brief Number of cells drawn to the line. */
+    uint32_t lineLen;
+    /** @brief Attribute of cells drawn to the line. */
+    TLog_Attribute lineAttribute;
+
+    /** @brief Attribute last set at the backend. */
+    TLog_Attribute attribute;
+    /** @brief Buffer to collect characters to write at once. */
+    char* text;
+} TLog_Shadow;
+
+/** @brief Statistics on output sent to the terminal. */
+typedef struct tlog_output_stats {
+    /** @brief Number of frames. */
+    size_t frames;
+    /** @brief Number of bytes of the last frame. */
+    size_t lastFrameBytes;
+    /** @brief Number of bytes of all frames. */
+    size_t totalBytes;
+    /** @brief The backend's written bytes at the last frame's end. */
+    size_t backendBytes;
+} TLog_Output_Stats;
+
+/** @brief The part of the widgets' lines on screen. */
+typedef struct tlog_view {
+    /** @brief NULL-terminated array of widgets. */
+    TLog_Widget** widgets;
+    /** @brief Screen height. */
+    uint32_t screenHeight;
+    /** @brief Width the widgets were laid out for. */
+    uint32_t maxWidth;
+    /** @brief Largest prefered width of all widgets. */
+    uint32_t preferedWidth;
+    /** @brief Sum of all widgets' heights. */
+    uint64_t height;
+
+    /** @brief Row (in widget space, i.e. of all widgets' lines stacked) shown at the screen's top. */
+    uint64_t top;
+    /** @brief Widget holding the row at the screen's top. */
+    TLog_Widget** topWidget;
+    /** @brief Row of the top widget's first line. */
+    uint64_t topWidgetY;
+
+    /** @brief Event loop the run waits in, or NULL. */
+    TLog_Loop* loop;
+} TLog_View;
+
+/** @brief A layout phase, i.e. asking every widget for its prefered width or laying every widget out. */
+typedef struct tlog_layout_phase {
+    /** @brief Widgets. */
+    TLog_Widget** widgets;
+    /** @brief Number of widgets. */
+    int count;
+    /** @brief Wether to ask for prefered widths (true) or lay out (false). */
+    bool measure;
+    /** @brief Maximum width to lay out for. */
+    uint32_t maxWidth;
+    /** @brief Screen height to lay out for. */
+    uint32_t screenHeight;
+
+    /** @brief Per widget, its prefered width or height. */
+    uint32_t* results;
+    /** @brief Per widget, nanoseconds its call took, or NULL if statistics are disabled. */
+    uint64_t* ns;
+    /** @brief Index of the next widget to take. */
+    volatile apr_uint32_t next;
+} TLog_Layout_Phase;
+
+/** @brief A thread taking part in a layout phase. */
+typedef struct tlog_layout_worker {
+    /** @brief The phase. */
+    TLog_Layout_Phase* phase;
+    /** @brief Pool for the widgets' layout state, see @ref TLog_GetLayoutPool(). */
+    apr_pool_t* pool;
+    /** @brief The thread, or NULL if it couldn't be started. */
+    apr_thread_t* thread;
+} TLog_Layout_Worker;
+
 /** @brief TRUE if Tobylog is initialized, or FALSE else. */
 static bool isInitialized = false;
 
+/** @brief Backend Tobylog runs on. */
+static TLog_Backend* backend = NULL;
+
+/**
+ * @brief Scratch arena for a run's layout, cleared at every run's start.
+ * 
+ * The tables below are made from it for the run's number of widgets, so growing them doesn't
+ * leave outgrown blocks in the pool Tobylog was initialized with, run after run.
+ */
+static apr_pool_t* scratch = NULL;
+
+/** @brief Number of threads laying out the widgets at a run's start. */
+static unsigned int layoutThreads = 1;
+
+/** @brief Pool a layout worker thread takes layout state from, NULL for the scratch arena. */
+static _Thread_local apr_pool_t* threadLayoutPool = NULL;
+
 /** @brief Widget heights. */
 static apr_array_header_t* heights = NULL;
 
+/** @brief Widget prefered widths, to tell which widgets a new screen width changes. */
+static apr_array_header_t* preferedWidths = NULL;
+
 /**
- * @brief Terminates Tobylog.
+ * @brief Fenwick tree over the widget heights, to find a widget's row and the widget at a row in O(log n).
  * 
+ * Element i (element 0 is unused) holds the sum of the heights of widgets i - (i & -i) to i - 1.
+ */
+static apr_array_header_t* heightIndex = NULL;
+
+/** @brief Per widget, and for the terminating NULL, the index of the first focusable widget from it on, or -1. */
+static apr_array_header_t* nextFocusables = NULL;
+
+/** @brief Per widget, the index of the last focusable widget up to it, or -1. */
+static apr_array_header_t* prevFocusables = NULL;
+
+/**
+ * @brief Hash table of the widgets' indices, to find an invalidated widget in O(1).
+ *
+ * Open addressing with linear probing over a power of 2 of at least twice as many slots as widgets,
+ * -1 marks a free slot.
+ */
+static apr_array_header_t* widgetIndex = NULL;
+
+/** @brief The number of slots in @ref widgetIndex minus 1, masking a hash to a slot. */
+static size_t widgetIndexMask = 0;
+
+/** @brief Indices of the widgets taking in outside changes. */
+static apr_array_header_t* updaters = NULL;
+
+/** @brief Widgets to lay out again with the next frame. */
+static apr_array_header_t* invalidated = NULL;
+
+/** @brief Characters input since the last draw. */
+static apr_array_header_t* batch = NULL;
+
+/** @brief The current run's view. */
+static TLog_View view;
+
+/** @brief What's on screen. */
+static TLog_Shadow shadow;
+
+/** @brief Output statistics. */
+static TLog_Output_Stats stats;
+
+/**
+ * @brief Terminates Tobylog.
+ *
  * @param data Dummy
- * @return Always APR_SUCCESS 
+ * @return Always APR_SUCCESS
  */
 static apr_status_t terminate(void* data);
 
 /**
- * @brief Draws some of widget's lines.
+ * @brief Runs Tobylog with a list of widgets.
+ *
+ * @param widgets NULL-terminated array of widgets
+ * @param loop Event loop to wait in, or NULL
+ * @param loopInput Wether the backend's input is among the loop's file descriptors
+ * @return The result of the run
+ */
+static TLog_Result run(TLog_Widget** widgets, TLog_Loop* loop, bool loopInput);
+
+/**
+ * @brief Clears the scratch arena and makes the tables for a run from it.
+ * 
+ * @param count Number of widgets
+ * @return TRUE on success, or FALSE on error
+ */
+static bool makeTables(int count);
+
+/**
+ * @brief Returns a widget's prefered width, timing the call for the statistics.
+ * 
+ * @param widget The widget
+ * @return The widget's prefered width
+ */
+static uint32_t getPreferedWidth(TLog_Widget* widget);
+
+/**
+ * @brief Lays out a widget for a maximum width, timing the call for the statistics.
+ * 
+ * @param widget The widget
+ * @param maxWidth Maximum width
+ * @param screenHeight Screen height
+ * @return The widget's height, or 0 on error
+ */
+static uint32_t layOut(TLog_Widget* widget, uint32_t maxWidth, uint32_t screenHeight);
+
+/**
+ * @brief Asks every widget for its prefered width, or lays every widget out.
+ * 
+ * With more than one layout thread, the widgets are spread over the threads, each taking the next
+ * widget left when done with one, so a few large widgets don't hold up the others.
+ * 
+ * @param widgets Widgets
+ * @param count Number of widgets
+ * @param measure Wether to ask for prefered widths (true) or lay out (false)
+ * @param maxWidth Maximum width to lay out for
+ * @param screenHeight Screen height to lay out for
+ * @param results Where to store each widget's prefered width or height, in order
+ */
+static void layOutAll(TLog_Widget** widgets, int count, bool measure, uint32_t maxWidth, uint32_t screenHeight,
+        uint32_t* results);
+
+/**
+ * @brief Takes widgets of a layout phase until none is left.
+ * 
+ * @param phase The phase
+ */
+static void runPhase(TLog_Layout_Phase* phase);
+
+/**
+ * @brief Takes part in a layout phase on a thread of its own.
+ * 
+ * @param thread The thread
+ * @param data The worker
+ * @return Always NULL
+ */
+static void* APR_THREAD_FUNC runWorker(apr_thread_t* thread, void* data);
+
+/**
+ * @brief Lays out the widgets again for the screen's new size and redraws the screen.
+ * 
+ * Only widgets whose width changes are laid out again, i.e. those whose prefered width exceeds
+ * the old or the new maximum width. The row at the screen's top stays there if possible.
+ * 
+ * @param focus The focused widget
+ * @param focusY Where to store the focused widget's first row
+ * @param cursorX Where to store the cursor X position in widget space, if the focused widget was laid out again
+ * @param cursorY Where to store the cursor Y position in widget space, if the focused widget was laid out again
+ * @return TRUE on success, or FALSE on error
+ */
+static bool resize(TLog_Widget** focus, uint64_t* focusY, uint32_t* cursorX, uint32_t* cursorY);
+
+/**
+ * @brief Sizes the shadow to the screen and blanks it.
+ * 
+ * @param width Screen width
+ * @param height Screen height
+ * @return TRUE on success, or FALSE on error
+ */
+static bool resetShadow(uint32_t width, uint32_t height);
+
+/**
+ * @brief Appends a character to the line being drawn, if it fits the screen.
+ * 
+ * Wide characters take two cells, zero width characters join the cell before.
+ * 
+ * @param ch The character
+ * @param len Length of the character in bytes
+ * @param width Number of columns the character takes
+ */
+static void putCell(const char* ch, size_t len, size_t width);
+
+/**
+ * @brief Sets the backend's attribute if it differs.
+ * 
+ * @param attribute The attribute
+ */
+static void setAttribute(TLog_Attribute attribute);
+
+/**
+ * @brief Starts drawing a line.
+ * 
+ * Until the line is committed, draw.h functions draw to the line instead of the screen.
+ */
+static void beginLine(void);
+
+/**
+ * @brief Writes the cells of a drawn line that differ from what's on screen.
+ * 
+ * @param row Screen row to put the line in
+ * @return TRUE if the line differed, or FALSE if it was on screen already
+ */
+static bool commitLine(uint32_t row);
+
+/**
+ * @brief Writes cells at the backend's cursor.
+ * 
+ * @param cells First cell to write
+ * @param count Number of cells to write
+ */
+static void writeCells(const TLog_Shadow_Cell* cells, uint32_t count);
+
+/**
+ * @brief Scrolls the screen and its shadow.
+ * 
+ * @param lines Number of rows to scroll up (positive) or down (negative)
+ */
+static void scrollScreen(int lines);
+
+/**
+ * @brief Makes the frame visible and updates the output statistics.
+ */
+static void flushFrame(void);
+
+/**
+ * @brief Sends the batched characters to a widget.
  * 
+ * @param widget The widget
+ * @param cursorX Where to store the cursor X position in widget space, if characters were sent
+ * @param cursorY Where to store the cursor Y position in widget space, if characters were sent
+ * @param dirtyStart Index of first dirty line, extended by lines the characters made dirty
+ * @param dirtyEnd Index after last dirty line, extended by lines the characters made dirty
+ */
+static void putBatch(TLog_Widget** widget, uint32_t* cursorX, uint32_t* cursorY,
+        uint32_t* dirtyStart, uint32_t* dirtyEnd);
+
+/**
+ * @brief Extends a range of dirty lines by another one.
+ * 
+ * @param dirtyStart Index of first dirty line
+ * @param dirtyEnd Index after last dirty line
+ * @param start Index of first dirty line to add
+ * @param end Index after last dirty line to add
+ */
+static void mergeDirty(uint32_t* dirtyStart, uint32_t* dirtyEnd, uint32_t start, uint32_t end);
+
+/**
+ * @brief Updates the widgets taking in outside changes and draws their dirty lines.
+ *
+ * @return TRUE if any lines were dirty, or FALSE else
+ */
+static bool updateWidgets(void);
+
+/**
+ * @brief Lays out the invalidated widgets again and draws them.
+ *
+ * @return TRUE if any widgets were invalidated, or FALSE else
+ */
+static bool layOutInvalidated(void);
+
+/**
+ * @brief Returns a widget's height.
+ *
+ * @param widget The widget
+ * @return The widget's height
+ */
+static uint32_t getHeight(TLog_Widget** widget);
+
+/**
+ * @brief Builds the height index from the widget heights.
+ */
+static void indexHeights(void);
+
+/**
+ * @brief Changes a widget's height, keeping the height index up to date.
+ *
+ * @param widget The widget
+ * @param height The new height
+ */
+static void setHeight(TLog_Widget** widget, uint32_t height);
+
+/**
+ * @brief Returns a widget's first row.
+ *
+ * @param widget The widget
+ * @return The row of the widget's first line
+ */
+static uint64_t getWidgetY(TLog_Widget** widget);
+
+/**
+ * @brief Finds the widget holding a row.
+ *
+ * @param row The row
+ * @param widgetY Where to store the row of the widget's first line
+ * @return The widget, or the terminating NULL if the row is below all widgets
+ */
+static TLog_Widget** findWidget(uint64_t row, uint64_t* widgetY);
+
+/**
+ * @brief Finds the first or last focusable widget whose first line is on screen.
+ *
+ * @param first TRUE to find the first such widget, or FALSE to find the last
+ * @param widgetY Where to store the row of the widget's first line
+ * @return The widget, or NULL if no focusable widget starts on screen
+ */
+static TLog_Widget** getFocusableOnScreen(bool first, uint64_t* widgetY);
+
+/**
+ * @brief Builds the tables of next and previous focusable widgets.
+ */
+static void indexFocusables(void);
+
+/**
+ * @brief Builds the hash table of the widgets' indices.
+ */
+static void indexWidgets(void);
+
+/**
+ * @brief Finds a widget among the run's widgets.
+ *
+ * @param widget The widget
+ * @return The widget's first place in the widget array, or NULL if it isn't run
+ */
+static TLog_Widget** lookUpWidget(TLog_Widget* widget);
+
+/**
+ * @brief Returns the hash table slot to start looking for a widget at.
+ *
+ * @param widget The widget
+ * @return The slot's index
+ */
+static size_t hashWidget(TLog_Widget* widget);
+
+/**
+ * @brief Draws those of a widget's lines that are on screen.
+ *
  * @param widget The widget whose lines to draw
- * @param buffer The buffer to be used to temporarily store each line
- * @param widgetY The widget's Y position in screen space
+ * @param widgetY The widget's first row
  * @param fromY The index of the first line to draw
  * @param toY The index after the last line to draw
- * @param screenHeight The screen's height
- * @return TRUE if all lines fit the screen, or FALSE else
  */
-static bool drawLines(TLog_Widget* widget, uint32_t widgetY, uint32_t fromY, uint32_t toY, uint32_t screenHeight);
+static void drawLines(TLog_Widget** widget, uint64_t widgetY, uint32_t fromY, uint32_t toY);
 
 /**
- * @brief Derives an action value from an ncurses input.
- * 
- * @param input ncurses input
- * @param action Where to put the action value
- * @return TRUE if an action value was derived, or FALSE else 
+ * @brief Draws those of some rows that are on screen.
+ *
+ * Rows below the last widget are cleared.
+ *
+ * @param fromRow The first row to draw
+ * @param toRow The row after the last row to draw
  */
-static bool getAction(int input, TLog_Widget_Action* action);
+static void drawRows(uint64_t fromRow, uint64_t toRow);
 
-// TODO Document
-static bool getPrevFocusableWidget(TLog_Widget** widgets, TLog_Widget** start, TLog_Widget*** prev);
+/**
+ * @brief Scrolls the view, drawing the rows scrolled in.
+ *
+ * @param top The row to show at the screen's top, will be clamped to keep the screen filled
+ */
+static void scrollTo(uint64_t top);
 
-// TODO Document
-static void getNextFocusableWidget(TLog_Widget** start, TLog_Widget*** next);
+/**
+ * @brief Scrolls the view as little as possible to show some rows.
+ *
+ * If there are more rows than fit the screen, the first ones are shown.
+ *
+ * @param fromRow The first row to show
+ * @param toRow The row after the last row to show
+ */
+static void reveal(uint64_t fromRow, uint64_t toRow);
+
+/**
+ * @brief Scrolls the view to a focused widget.
+ *
+ * The widget is shown completely if it fits the screen, else its cursor's line is shown.
+ *
+ * @param widget The focused widget
+ * @param widgetY The widget's first row
+ * @param cursorY The cursor's Y position in widget space
+ */
+static void revealFocus(TLog_Widget** widget, uint64_t widgetY, uint32_t cursorY);
 
-// TODO Document
-static void scrollUpToWidget(TLog_Widget** widgets, uint32_t screenHeight,
-        TLog_Widget*** currentWidget, uint32_t* currentWidgetY, TLog_Widget** targetWidget);
+/**
+ * @brief Moves the screen's cursor to a widget's cursor, or as close as possible if that's off screen.
+ *
+ * @param widgetY The widget's first row
+ * @param cursorX The cursor's X position in widget space
+ * @param cursorY The cursor's Y position in widget space
+ */
+static void placeCursor(uint64_t widgetY, uint32_t cursorX, uint32_t cursorY);
+
+/**
+ * @brief Finds the last focusable widget up to a widget.
+ *
+ * @param start The widget to search from
+ * @param prev Where to store the focusable widget
+ * @return TRUE if a focusable widget was found, or FALSE else
+ */
+static bool getPrevFocusableWidget(TLog_Widget** start, TLog_Widget*** prev);
 
-// TODO Document
-static void scrollDownToWidget(TLog_Widget** widgets, uint32_t screenHeight,
-        TLog_Widget*** currentWidget, uint32_t* currentWidgetY, TLog_Widget** targetWidget);
+/**
+ * @brief Finds the first focusable widget from a widget on.
+ *
+ * @param start The widget, or the terminating NULL, to search from
+ * @param next Where to store the focusable widget, NULL if there is none
+ */
+static void getNextFocusableWidget(TLog_Widget** start, TLog_Widget*** next);
 
 TLog_Result TLog_Init(apr_pool_t* pool) {
+    if (isInitialized) {
+        return TLOG_RESULT_OK;
+    }
+
+    TLog_Backend* terminal = TLog_Terminal_Create(pool);
+    return terminal ? TLog_InitWithBackend(pool, terminal) : TLOG_RESULT_FAIL;
+}
+
+TLog_Result TLog_InitWithBackend(apr_pool_t* pool, TLog_Backend* newBackend) {
     if (isInitialized) {
         goto success;
     }
 
-    if (!initscr()) {
+    if (!newBackend) {
         goto fail;
     }
 
-    cbreak();
-    keypad(stdscr, TRUE);
-    noecho();
-    scrollok(stdscr, TRUE);
+    if (apr_pool_create(&scratch, pool) != APR_SUCCESS) {
+        goto fail;
+    }
 
-    heights = apr_array_make(pool, DEFAULT_WIDGET_COUNT, sizeof(uint32_t));
-    if (!heights) {
+    if (!newBackend->data->start(newBackend)) {
         goto fail;
     }
 
+    backend = newBackend;
     isInitialized = true;
+    memset(&stats, 0, sizeof(stats));
+    if (backend->data->getBytesWritten) {
+        stats.backendBytes = backend->data->getBytesWritten(backend);
+    }
     apr_pool_cleanup_register(pool, NULL, terminate, apr_pool_cleanup_null);
     success:
     return TLOG_RESULT_OK;
@@ -96,69 +587,155 @@ TLog_Result TLog_Init(apr_pool_t* pool) {
 }
 
 TLog_Result TLog_Run(TLog_Widget** widgets) {
+    return TLog_RunLoop(widgets, NULL);
+}
+
+TLog_Result TLog_RunLoop(TLog_Widget** widgets, TLog_Loop* loop) {
+    if (!isInitialized) {
+        return TLOG_RESULT_FAIL;
+    }
+
+    /* Wait for input along with the loop's file descriptors, if the backend can */
+    int inputFd = loop && backend->data->getFd ? backend->data->getFd(backend) : -1;
+    if (inputFd >= 0 && !TLog_Loop_AddFd(loop, inputFd, NULL, NULL)) {
+        return TLOG_RESULT_FAIL;
+    }
+
+    view.loop = loop;
+    TLog_Result result = run(widgets, loop, inputFd >= 0);
+
+    if (inputFd >= 0) {
+        TLog_Loop_RemoveFd(loop, inputFd);
+    }
+    view.widgets = NULL;
+
+    /* Let widgets stop what they started for the run, e.g. worker threads, before nobody wakes up anymore */
+    apr_pool_clear(scratch);
+    view.loop = NULL;
+
+    return result;
+}
+
+apr_pool_t* TLog_GetLayoutPool(void) {
+    if (!isInitialized) {
+        return NULL;
+    }
+    return threadLayoutPool ? threadLayoutPool : scratch;
+}
+
+void TLog_SetLayoutThreads(unsigned int threads) {
+    if (threads == 0) {
+        long processors = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = processors > 0 ? (unsigned int) processors : 1;
+    }
+    layoutThreads = threads;
+}
+
+void TLog_Wakeup(void) {
+    /* Without a loop, widgets are updated every few milliseconds anyway */
+    TLog_Loop* loop = view.loop;
+    if (loop) {
+        TLog_Loop_Wakeup(loop);
+    }
+}
+
+void TLog_Invalidate(TLog_Widget* widget) {
+    if (isInitialized && view.widgets && widget) {
+        APR_ARRAY_PUSH(invalidated, TLog_Widget*) = widget;
+    }
+}
+
+static TLog_Result run(TLog_Widget** widgets, TLog_Loop* loop, bool loopInput) {
     uint32_t screenWidth, screenHeight;
     uint32_t maxWidth;
     TLog_Widget** currentWidget;
     TLog_Widget** nextWidget;
-    uint32_t currentWidgetY; // in screen space
+    uint64_t currentWidgetY;
     uint32_t cursorX, cursorY;
 
-    if (!isInitialized) {
-        goto fail;
-    }
-
     if (!widgets) {
         goto immediate_success;
     }
 
+    int count = 0;
+    for (; widgets[count]; ++count);
+    if (!makeTables(count)) {
+        goto fail;
+    }
+
     /************** Widget Size Calculation **************/
 
-    screenWidth = COLS;
-    screenHeight = LINES;
+    backend->data->getSize(backend, &screenWidth, &screenHeight);
+    if (!resetShadow(screenWidth, screenHeight)) {
+        goto fail;
+    }
+
+    layOutAll(widgets, count, true, 0, 0, (uint32_t*) preferedWidths->elts);
+    preferedWidths->nelts = count;
 
     maxWidth = 0;
-    for (TLog_Widget** iter = widgets; *iter; ++iter) {
-        uint32_t widgetWidth = (*iter)->data->getPreferedWidth(*iter);
+    for (int i = 0; i < count; ++i) {
+        uint32_t widgetWidth = APR_ARRAY_IDX(preferedWidths, i, uint32_t);
         maxWidth = widgetWidth > maxWidth ? widgetWidth : maxWidth;
     }
+
+    view.widgets = widgets;
+    view.screenHeight = screenHeight;
+    view.preferedWidth = maxWidth;
     maxWidth = screenWidth - 1 < maxWidth ? screenWidth - 1 : maxWidth;
+    view.maxWidth = maxWidth;
+    view.height = 0;
+
+    layOutAll(widgets, count, false, maxWidth, screenHeight, (uint32_t*) heights->elts);
+    heights->nelts = count;
 
-    apr_array_clear(heights);
-    for (TLog_Widget** iter = widgets; *iter; ++iter) {
-        uint32_t height = (*iter)->data->setMaximumWidth(*iter, maxWidth, screenHeight);
+    for (int i = 0; i < count; ++i) {
+        uint32_t height = APR_ARRAY_IDX(heights, i, uint32_t);
         if (height == 0) {
             goto fail;
-        } else if (height > screenHeight) {
-            goto finished_cancel;
         }
+        view.height += height;
 
-        APR_ARRAY_PUSH(heights, uint32_t) = height;
+        if (widgets[i]->data->update) {
+            APR_ARRAY_PUSH(updaters, int) = i;
+        }
     }
+    indexHeights();
+    indexWidgets();
+    indexFocusables();
 
     /************** Initial Draw **************/
 
-    attrset(A_NORMAL);
-    clear();
-    for (currentWidget = widgets, currentWidgetY = 0; *currentWidget; ++currentWidget) {
-        uint32_t height = APR_ARRAY_IDX(heights, currentWidget - widgets, uint32_t);
-        if (!drawLines(*currentWidget, currentWidgetY, 0, height, screenHeight)) {
-            break;
-        }
-        currentWidgetY += height;
+    /* Let widgets take in what's there already, they're drawn completely anyway */
+    for (int i = 0; i < updaters->nelts; ++i) {
+        TLog_Widget* widget = widgets[APR_ARRAY_IDX(updaters, i, int)];
+        uint32_t start, end;
+        widget->data->update(widget, &start, &end);
     }
 
+    view.top = 0;
+    view.topWidget = widgets;
+    view.topWidgetY = 0;
+
+    backend->data->setAttribute(backend, TLOG_ATTRIBUTE_NORMAL);
+    shadow.attribute = TLOG_ATTRIBUTE_NORMAL;
+    backend->data->clear(backend);
+    drawRows(0, screenHeight);
+
     /************** Find Focusable Widget **************/
 
     currentWidget = widgets;
     currentWidgetY = 0;
     getNextFocusableWidget(currentWidget, &nextWidget);
     if (nextWidget) {
-        scrollDownToWidget(widgets, screenHeight, &currentWidget, &currentWidgetY, nextWidget);
+        currentWidget = nextWidget;
+        currentWidgetY = getWidgetY(currentWidget);
         (*currentWidget)->data->setFocus(*currentWidget, 1, &cursorX, &cursorY);
-        move(currentWidgetY + cursorY, cursorX);
+        revealFocus(currentWidget, currentWidgetY, cursorY);
+        placeCursor(currentWidgetY, cursorX, cursorY);
     }
 
-    refresh();
+    flushFrame();
 
     if (!nextWidget) {
         goto finished_success;
@@ -166,156 +743,1045 @@ TLog_Result TLog_Run(TLog_Widget** widgets) {
 
     /************** Action **************/
 
-    while (true) {
-        uint32_t dirtyStart = 0;
-        uint32_t dirtyEnd = 0;
+    bool waiting = true;
+    bool pasting = false;
+    bool resized = false;
+    uint32_t dirtyStart = 0;
+    uint32_t dirtyEnd = 0;
 
-        int input = getch();
+    while (true) {
+        TLog_Input input;
         TLog_Widget_Action action;
-        if (input >= 32 && input <= 126 && (*currentWidget)->data->putChar) {
-            (*currentWidget)->data->putChar(*currentWidget, (char) input, &cursorX, &cursorY, &dirtyStart, &dirtyEnd);
-        } else if (getAction(input, &action) && 
-                (!(*currentWidget)->data->putAction
-                        || !(*currentWidget)->data->putAction(*currentWidget, action, &cursorX, &cursorY, &dirtyStart, &dirtyEnd))) {
-            goto take_action;
+
+        /* Apply all pending input before drawing, and the whole of a paste */
+        bool waited = waiting || pasting;
+        int timeout = 0;
+        if (waited && loopInput && !pasting) {
+            /* Sleep until input or anything else in the loop comes in, then take all input there is */
+            TLog_Loop_Wait(loop, -1);
+        } else if (waited) {
+            if (loop && !pasting) {
+                TLog_Loop_Wait(loop, 0);
+            }
+            timeout = pasting || (updaters->nelts == 0 && !loop) ? -1 : UPDATE_INTERVAL;
+        }
+        backend->data->getInput(backend, timeout, &input);
+        waiting = false;
+        if (TLog_Stats_Enabled && input.type != TLOG_INPUT_NONE && input.type != TLOG_INPUT_END) {
+            TLog_Stats_AddInput();
+        }
+        if (input.type == TLOG_INPUT_CHAR) {
+            if ((*currentWidget)->data->putChar) {
+                APR_ARRAY_PUSH(batch, char) = input.ch;
+            }
+            continue;
+        } else if (input.type == TLOG_INPUT_PASTE_START || input.type == TLOG_INPUT_PASTE_END) {
+            pasting = input.type == TLOG_INPUT_PASTE_START;
+            continue;
+        } else if (input.type == TLOG_INPUT_RESIZE) {
+            /* Resizes come in bursts while the window is dragged, only the last size is laid out for */
+            resized = true;
+            continue;
+        } else if (input.type == TLOG_INPUT_END) {
+            goto finished_cancel;
+        } else if (input.type == TLOG_INPUT_ACTION && pasting) {
+            /* Line breaks and tabs of pasted text are text, for widgets taking text to keep or drop */
+            bool tab = input.action == TLOG_WIDGET_ACTION_TAB;
+            if ((tab || input.action == TLOG_WIDGET_ACTION_RETURN) && (*currentWidget)->data->putText) {
+                APR_ARRAY_PUSH(batch, char) = tab ? '\t' : '\n';
+            }
+            continue;
+        } else if (input.type == TLOG_INPUT_ACTION) {
+            putBatch(currentWidget, &cursorX, &cursorY, &dirtyStart, &dirtyEnd);
+
+            /* Actions apply to what's on screen, so lay out for its size first */
+            if (resized) {
+                if (!resize(currentWidget, &currentWidgetY, &cursorX, &cursorY)) {
+                    goto fail;
+                }
+                resized = false;
+                dirtyStart = dirtyEnd = 0;
+            }
+
+            uint32_t actionDirtyStart = 0;
+            uint32_t actionDirtyEnd = 0;
+            action = input.action;
+            if (!(*currentWidget)->data->putAction
+                    || !(*currentWidget)->data->putAction(*currentWidget, action,
+                            &cursorX, &cursorY, &actionDirtyStart, &actionDirtyEnd)) {
+                goto take_action;
+            }
+            mergeDirty(&dirtyStart, &dirtyEnd, actionDirtyStart, actionDirtyEnd);
+            continue;
+        } else if (input.type != TLOG_INPUT_NONE) {
+            /* Other input is ignored */
+            continue;
+        }
+
+        putBatch(currentWidget, &cursorX, &cursorY, &dirtyStart, &dirtyEnd);
+
+        /* Without input, only changes from outside need a new frame */
+        bool changed = false;
+        if (resized) {
+            if (!resize(currentWidget, &currentWidgetY, &cursorX, &cursorY)) {
+                goto fail;
+            }
+            resized = false;
+            dirtyStart = dirtyEnd = 0;
+            changed = true;
+        }
+        /* Updates may invalidate their widgets, which are laid out again right away */
+        changed = updateWidgets() || changed;
+        if (layOutInvalidated()) {
+            currentWidgetY = getWidgetY(currentWidget);
+            changed = true;
+        }
+        if (!changed && waited) {
+            waiting = true;
+            continue;
         }
 
-        drawLines(*currentWidget, currentWidgetY, dirtyStart, dirtyEnd, screenHeight);
+        /* The widget may have been scrolled away, so bring its cursor back first */
+        reveal(currentWidgetY + cursorY, currentWidgetY + cursorY + 1);
+        drawLines(currentWidget, currentWidgetY, dirtyStart, dirtyEnd);
+        dirtyStart = dirtyEnd = 0;
 
-        move(currentWidgetY + cursorY, cursorX);
-        refresh();
+        placeCursor(currentWidgetY, cursorX, cursorY);
+        flushFrame();
+        waiting = true;
         continue;
 
         take_action:
+        /* Show what was applied before the action */
+        if (dirtyStart < dirtyEnd) {
+            reveal(currentWidgetY + cursorY, currentWidgetY + cursorY + 1);
+            drawLines(currentWidget, currentWidgetY, dirtyStart, dirtyEnd);
+            dirtyStart = dirtyEnd = 0;
+        }
+
         if (action == TLOG_WIDGET_ACTION_RETURN) {
             goto finished_success;
         } else if (action == TLOG_WIDGET_ACTION_ESC) {
             goto finished_cancel;
         } else if (action == TLOG_WIDGET_ACTION_UP) {
             TLog_Widget** prevWidget;
-            if (currentWidget > widgets && getPrevFocusableWidget(widgets, currentWidget - 1, &prevWidget)) {
-                scrollUpToWidget(widgets, screenHeight,
-                        &currentWidget, &currentWidgetY, prevWidget);
+            if (currentWidget > widgets && getPrevFocusableWidget(currentWidget - 1, &prevWidget)) {
+                uint64_t prevWidgetY = getWidgetY(prevWidget);
+
+                /* Jump to widgets at most a screen away, scroll line by line towards those further away */
+                if (prevWidgetY + getHeight(prevWidget) + view.screenHeight > view.top) {
+                    currentWidget = prevWidget;
+                    currentWidgetY = prevWidgetY;
+                    (*currentWidget)->data->setFocus(*currentWidget, 0, &cursorX, &cursorY);
+                    revealFocus(currentWidget, currentWidgetY, cursorY);
+                } else {
+                    scrollTo(view.top - 1);
+                }
+            } else if (view.top > 0) {
+                scrollTo(view.top - 1);
             }
-            (*currentWidget)->data->setFocus(*currentWidget, 0, &cursorX, &cursorY);
-            move(currentWidgetY + cursorY, cursorX);
+            placeCursor(currentWidgetY, cursorX, cursorY);
         } else if (action == TLOG_WIDGET_ACTION_DOWN) {
             getNextFocusableWidget(currentWidget + 1, &nextWidget);
             if (nextWidget) {
-                scrollDownToWidget(widgets, screenHeight,
-                        &currentWidget, &currentWidgetY, nextWidget);
+                uint64_t nextWidgetY = getWidgetY(nextWidget);
+
+                /* Jump to widgets at most a screen away, scroll line by line towards those further away */
+                if (nextWidgetY < view.top + 2 * (uint64_t) view.screenHeight) {
+                    currentWidget = nextWidget;
+                    currentWidgetY = nextWidgetY;
+                    (*currentWidget)->data->setFocus(*currentWidget, 1, &cursorX, &cursorY);
+                    revealFocus(currentWidget, currentWidgetY, cursorY);
+                } else {
+                    scrollTo(view.top + 1);
+                }
+            } else {
+                scrollTo(view.top + 1);
+            }
+            placeCursor(currentWidgetY, cursorX, cursorY);
+        } else if (action == TLOG_WIDGET_ACTION_PAGE_UP || action == TLOG_WIDGET_ACTION_PAGE_DOWN) {
+            bool down = action == TLOG_WIDGET_ACTION_PAGE_DOWN;
+            if (down) {
+                scrollTo(view.top + view.screenHeight);
+            } else {
+                scrollTo(view.top > view.screenHeight ? view.top - view.screenHeight : 0);
             }
-            (*currentWidget)->data->setFocus(*currentWidget, 1, &cursorX, &cursorY);
-            move(currentWidgetY + cursorY, cursorX);
-        }
-        refresh();
-    }
 
-    finished_success:
-    immediate_success:
-    return TLOG_RESULT_OK;
+            /* Take the focus along if the cursor was scrolled away */
+            uint64_t cursorRow = currentWidgetY + cursorY;
+            if (cursorRow < view.top || cursorRow >= view.top + view.screenHeight) {
+                uint64_t focusableY;
+                TLog_Widget** focusable = getFocusableOnScreen(down, &focusableY);
+                if (focusable) {
+                    currentWidget = focusable;
+                    currentWidgetY = focusableY;
+                    (*currentWidget)->data->setFocus(*currentWidget, down, &cursorX, &cursorY);
+                }
+            }
+            placeCursor(currentWidgetY, cursorX, cursorY);
+        } else if (action == TLOG_WIDGET_ACTION_HOME || action == TLOG_WIDGET_ACTION_END) {
+            bool home = action == TLOG_WIDGET_ACTION_HOME;
+            TLog_Widget** target = NULL;
+            if (home) {
+                getNextFocusableWidget(widgets, &target);
+            } else if (!getPrevFocusableWidget(widgets + heights->nelts - 1, &target)) {
+                target = NULL;
+            }
 
-    finished_cancel:
+            if (target) {
+                currentWidget = target;
+                currentWidgetY = getWidgetY(currentWidget);
+                (*currentWidget)->data->setFocus(*currentWidget, home, &cursorX, &cursorY);
+
+                /* Show the very top or bottom, unless the cursor isn't there */
+                uint64_t cursorRow = currentWidgetY + cursorY;
+                if (home && cursorRow < view.screenHeight) {
+                    scrollTo(0);
+                } else if (!home && cursorRow + view.screenHeight >= view.height) {
+                    scrollTo(view.height);
+                } else {
+                    revealFocus(currentWidget, currentWidgetY, cursorY);
+                }
+            }
+            placeCursor(currentWidgetY, cursorX, cursorY);
+        } else if (action == TLOG_WIDGET_ACTION_TAB || action == TLOG_WIDGET_ACTION_SHIFT_TAB) {
+            /* Cycle through the focusable widgets, wrapping around at the ends */
+            bool forward = action == TLOG_WIDGET_ACTION_TAB;
+            TLog_Widget** target = NULL;
+            if (forward) {
+                getNextFocusableWidget(currentWidget + 1, &target);
+                if (!target) {
+                    getNextFocusableWidget(widgets, &target);
+                }
+            } else if ((currentWidget == widgets || !getPrevFocusableWidget(currentWidget - 1, &target))
+                    && !getPrevFocusableWidget(widgets + heights->nelts - 1, &target)) {
+                target = NULL;
+            }
+
+            if (target) {
+                currentWidget = target;
+                currentWidgetY = getWidgetY(currentWidget);
+                (*currentWidget)->data->setFocus(*currentWidget, forward, &cursorX, &cursorY);
+                revealFocus(currentWidget, currentWidgetY, cursorY);
+            }
+            placeCursor(currentWidgetY, cursorX, cursorY);
+        }
+        flushFrame();
+        waiting = true;
+    }
+
+    finished_success:
+    immediate_success:
+    return TLOG_RESULT_OK;
+
+    finished_cancel:
     return TLOG_RESULT_CANCEL;
 
     fail:
     return TLOG_RESULT_FAIL;
 }
 
+void TLog_GetOutputStats(size_t* frames, size_t* lastFrameBytes, size_t* totalBytes) {
+    if (frames) {
+        *frames = stats.frames;
+    }
+    if (lastFrameBytes) {
+        *lastFrameBytes = stats.lastFrameBytes;
+    }
+    if (totalBytes) {
+        *totalBytes = stats.totalBytes;
+    }
+}
+
+void TLog_Draw_Text(const char* text, size_t len) {
+    const char* end = text + len;
+
+    while (text < end) {
+        unsigned char b = *text;
+        if (b >= 0x20 && b < 0x7f) {
+            putCell(text++, 1, 1);
+            continue;
+        }
+
+        const char* next;
+        size_t width = TLog_UTF8_CharWidth(text, end, &next);
+
+        /* Control characters (C0, DEL and C1) would control the terminal, so they are dropped */
+        bool control = b < 0x80 || (b == 0xc2 && next - text == 2 && (unsigned char) text[1] < 0xa0);
+        if (!control) {
+            putCell(text, next - text, width);
+        }
+        text = next;
+    }
+}
+
+void TLog_Draw_Fill(char ch, uint32_t count) {
+    for (; count > 0 && shadow.lineLen < shadow.width; --count) {
+        putCell(&ch, 1, 1);
+    }
+}
+
+void TLog_Draw_SetAttribute(TLog_Attribute attribute) {
+    shadow.lineAttribute = attribute;
+}
+
 static apr_status_t terminate(void* data) {
     UNUSED(data);
     isInitialized = false;
-    endwin();
+    backend->data->stop(backend);
+    backend = NULL;
+
+    free(shadow.cells);
+    free(shadow.line);
+    free(shadow.text);
+    memset(&shadow, 0, sizeof(shadow));
     return APR_SUCCESS;
 }
 
-static bool drawLines(TLog_Widget* widget, uint32_t widgetY, uint32_t fromY, uint32_t toY, uint32_t screenHeight) {
-    for (uint32_t y = fromY; y < toY; ++y) {
-        uint32_t screenY = widgetY + y;
+static bool makeTables(int count) {
+    /* Drop the last run's tables, and whatever widgets took from the arena */
+    apr_pool_clear(scratch);
+
+    heights = apr_array_make(scratch, count, sizeof(uint32_t));
+    preferedWidths = apr_array_make(scratch, count, sizeof(uint32_t));
+    heightIndex = apr_array_make(scratch, count + 1, sizeof(uint64_t));
+    int slots = 2;
+    while (slots < 2 * count) {
+        slots *= 2;
+    }
+    widgetIndex = apr_array_make(scratch, slots, sizeof(int));
+    widgetIndexMask = slots - 1;
+    nextFocusables = apr_array_make(scratch, count + 1, sizeof(int));
+    prevFocusables = apr_array_make(scratch, count, sizeof(int));
+    updaters = apr_array_make(scratch, count < DEFAULT_WIDGET_COUNT ? count : DEFAULT_WIDGET_COUNT, sizeof(int));
+    invalidated = apr_array_make(scratch, DEFAULT_WIDGET_COUNT, sizeof(TLog_Widget*));
+    batch = apr_array_make(scratch, INIT_BATCH_CAPACITY, sizeof(char));
+
+    return heights && preferedWidths && heightIndex && widgetIndex && nextFocusables && prevFocusables
+            && updaters && invalidated && batch;
+}
+
+static uint32_t getPreferedWidth(TLog_Widget* widget) {
+    if (!TLog_Stats_Enabled) {
+        return widget->data->getPreferedWidth(widget);
+    }
+
+    uint64_t start = TLog_Stats_Now();
+    uint32_t width = widget->data->getPreferedWidth(widget);
+    TLog_Stats_AddLayout(widget->data, TLog_Stats_Now() - start);
+    return width;
+}
+
+static uint32_t layOut(TLog_Widget* widget, uint32_t maxWidth, uint32_t screenHeight) {
+    if (!TLog_Stats_Enabled) {
+        return widget->data->setMaximumWidth(widget, maxWidth, screenHeight);
+    }
+
+    uint64_t start = TLog_Stats_Now();
+    uint32_t height = widget->data->setMaximumWidth(widget, maxWidth, screenHeight);
+    TLog_Stats_AddLayout(widget->data, TLog_Stats_Now() - start);
+    return height;
+}
+
+static void layOutAll(TLog_Widget** widgets, int count, bool measure, uint32_t maxWidth, uint32_t screenHeight,
+        uint32_t* results) {
+    unsigned int threads = layoutThreads < (unsigned int) count ? layoutThreads : (unsigned int) count;
+    TLog_Layout_Worker* workers = threads > 1 ? apr_palloc(scratch, sizeof(TLog_Layout_Worker) * threads) : NULL;
+    if (!workers) {
+        for (int i = 0; i < count; ++i) {
+            results[i] = measure ? getPreferedWidth(widgets[i]) : layOut(widgets[i], maxWidth, screenHeight);
+        }
+        return;
+    }
+
+    TLog_Layout_Phase phase;
+    phase.widgets = widgets;
+    phase.count = count;
+    phase.measure = measure;
+    phase.maxWidth = maxWidth;
+    phase.screenHeight = screenHeight;
+    phase.results = results;
+    phase.ns = TLog_Stats_Enabled ? apr_palloc(scratch, sizeof(uint64_t) * count) : NULL;
+    apr_atomic_set32(&phase.next, 0);
+
+    /* Pools aren't thread-safe, so each worker gets its own, made here as making one changes its parent */
+    for (unsigned int i = 1; i < threads; ++i) {
+        workers[i].phase = &phase;
+        workers[i].thread = NULL;
+        if (apr_pool_create(&workers[i].pool, scratch) == APR_SUCCESS
+                && apr_thread_create(&workers[i].thread, NULL, runWorker, &workers[i], workers[i].pool)
+                        != APR_SUCCESS) {
+            workers[i].thread = NULL;
+        }
+    }
+
+    /* This thread takes part too, and does all the work if no thread could be started */
+    runPhase(&phase);
+
+    for (unsigned int i = 1; i < threads; ++i) {
+        if (workers[i].thread) {
+            apr_status_t status;
+            apr_thread_join(&status, workers[i].thread);
+        }
+    }
+
+    /* The statistics aren't thread-safe, so the calls are counted in order once all are done */
+    if (phase.ns) {
+        for (int i = 0; i < count; ++i) {
+            TLog_Stats_AddLayout(widgets[i]->data, phase.ns[i]);
+        }
+    }
+}
+
+static void runPhase(TLog_Layout_Phase* phase) {
+    for (;;) {
+        apr_uint32_t i = apr_atomic_inc32(&phase->next);
+        if (i >= (apr_uint32_t) phase->count) {
+            break;
+        }
+
+        TLog_Widget* widget = phase->widgets[i];
+        uint64_t start = phase->ns ? TLog_Stats_Now() : 0;
+        if (phase->measure) {
+            phase->results[i] = widget->data->getPreferedWidth(widget);
+        } else {
+            phase->results[i] = widget->data->setMaximumWidth(widget, phase->maxWidth, phase->screenHeight);
+        }
+        if (phase->ns) {
+            phase->ns[i] = TLog_Stats_Now() - start;
+        }
+    }
+}
+
+static void* APR_THREAD_FUNC runWorker(apr_thread_t* thread, void* data) {
+    TLog_Layout_Worker* worker = data;
 
-        if (screenY >= screenHeight) {
+    threadLayoutPool = worker->pool;
+    runPhase(worker->phase);
+    threadLayoutPool = NULL;
+
+    apr_thread_exit(thread, APR_SUCCESS);
+    return NULL;
+}
+
+static bool resize(TLog_Widget** focus, uint64_t* focusY, uint32_t* cursorX, uint32_t* cursorY) {
+    uint32_t screenWidth, screenHeight;
+    backend->data->getSize(backend, &screenWidth, &screenHeight);
+    if (!resetShadow(screenWidth, screenHeight)) {
+        return false;
+    }
+
+    uint32_t oldWidth = view.maxWidth;
+    uint32_t maxWidth = screenWidth - 1 < view.preferedWidth ? screenWidth - 1 : view.preferedWidth;
+    TLog_Widget** anchor = view.topWidget;
+    uint64_t anchorOffset = view.top - view.topWidgetY;
+
+    view.screenHeight = screenHeight;
+    view.maxWidth = maxWidth;
+
+    bool focusLaidOut = false;
+    for (int i = 0; i < heights->nelts; ++i) {
+        /* Widgets no wider than both widths look the same at either */
+        uint32_t preferedWidth = APR_ARRAY_IDX(preferedWidths, i, uint32_t);
+        uint32_t oldEffective = preferedWidth < oldWidth ? preferedWidth : oldWidth;
+        uint32_t newEffective = preferedWidth < maxWidth ? preferedWidth : maxWidth;
+        if (oldEffective == newEffective) {
+            continue;
+        }
+
+        TLog_Widget** widget = view.widgets + i;
+        uint32_t height = layOut(*widget, maxWidth, screenHeight);
+        if (height == 0) {
             return false;
         }
+        if (height != getHeight(widget)) {
+            setHeight(widget, height);
+        }
+        focusLaidOut = focusLaidOut || widget == focus;
+    }
 
-        attrset(A_NORMAL);
-        move(screenY, 0);
-        widget->data->drawLine(widget, y);
+    /* Keep the row at the screen's top, or the last row of its widget if that got shorter */
+    uint64_t top = view.top;
+    if (*anchor) {
+        uint32_t anchorHeight = getHeight(anchor);
+        top = getWidgetY(anchor) + (anchorOffset < anchorHeight ? anchorOffset : anchorHeight - 1);
+    }
+    uint64_t maxTop = view.height > screenHeight ? view.height - screenHeight : 0;
+    view.top = top < maxTop ? top : maxTop;
+    view.topWidget = findWidget(view.top, &view.topWidgetY);
 
-        attrset(A_NORMAL);
-        clrtoeol();
+    *focusY = getWidgetY(focus);
+    if (focusLaidOut) {
+        /* The cursor may have moved with the widget's width, the widget still knows where it is */
+        (*focus)->data->setFocus(*focus, true, cursorX, cursorY);
     }
 
+    /* The terminal's content is garbled after a resize, so draw everything on screen */
+    backend->data->setAttribute(backend, TLOG_ATTRIBUTE_NORMAL);
+    shadow.attribute = TLOG_ATTRIBUTE_NORMAL;
+    backend->data->clear(backend);
+    drawRows(view.top, view.top + screenHeight);
+
     return true;
 }
 
-static bool getAction(int input, TLog_Widget_Action* action) {
-    if (input == '\n') {
-        *action = TLOG_WIDGET_ACTION_RETURN;
-    } else if (input == 0x1b) {
-        *action = TLOG_WIDGET_ACTION_ESC;
-    } else if (input == KEY_BACKSPACE) {
-        *action = TLOG_WIDGET_ACTION_BACKSPACE;
-    } else if (input == KEY_UP) {
-        *action = TLOG_WIDGET_ACTION_UP;
-    } else if (input == KEY_DOWN) {
-        *action = TLOG_WIDGET_ACTION_DOWN;
-    } else if (input == KEY_LEFT) {
-        *action = TLOG_WIDGET_ACTION_LEFT;
-    } else if (input == KEY_RIGHT) {
-        *action = TLOG_WIDGET_ACTION_RIGHT;
+static bool resetShadow(uint32_t width, uint32_t height) {
+    if (width != shadow.width || height != shadow.height) {
+        size_t count = (size_t) width * height;
+        TLog_Shadow_Cell* cells = realloc(shadow.cells, sizeof(TLog_Shadow_Cell) * count);
+        if (!cells) {
+            return false;
+        }
+        shadow.cells = cells;
+
+        TLog_Shadow_Cell* line = realloc(shadow.line, sizeof(TLog_Shadow_Cell) * width);
+        if (!line) {
+            return false;
+        }
+        shadow.line = line;
+
+        char* text = realloc(shadow.text, (size_t) width * MAX_CELL_LEN + MAX_CELL_LEN);
+        if (!text) {
+            return false;
+        }
+        shadow.text = text;
+
+        shadow.width = width;
+        shadow.height = height;
+    }
+
+    memset(shadow.cells, 0, sizeof(TLog_Shadow_Cell) * width * height);
+
+    return true;
+}
+
+static void putCell(const char* ch, size_t len, size_t width) {
+    TLog_Shadow_Cell* cell;
+
+    if (width == 0) {
+        /* Join the character before, as long as it has room */
+        uint32_t x = shadow.lineLen;
+        if (x > 1 && shadow.line[x - 1].len == CONTINUATION_LEN) {
+            --x;
+        }
+        if (x > 0) {
+            cell = &shadow.line[x - 1];
+            if (cell->len == 0) {
+                cell->ch[0] = ' ';
+                cell->len = 1;
+            }
+            if (cell->len + len <= MAX_CELL_LEN) {
+                memcpy(&cell->ch[cell->len], ch, len);
+                cell->len += len;
+            }
+        }
+    } else if (shadow.lineLen + width <= shadow.width) {
+        cell = &shadow.line[shadow.lineLen++];
+        memset(cell, 0, sizeof(TLog_Shadow_Cell));
+        /* Normal spaces are blank, as is what was never drawn to */
+        if (len != 1 || *ch != ' ' || shadow.lineAttribute != TLOG_ATTRIBUTE_NORMAL) {
+            memcpy(cell->ch, ch, len);
+            cell->len = len;
+            cell->attribute = shadow.lineAttribute;
+        }
+
+        if (width == 2) {
+            cell = &shadow.line[shadow.lineLen++];
+            memset(cell, 0, sizeof(TLog_Shadow_Cell));
+            cell->len = CONTINUATION_LEN;
+            cell->attribute = shadow.lineAttribute;
+        }
     } else {
+        /* A wide character at the screen's edge is cut off completely */
+        for (; shadow.lineLen < shadow.width; ++shadow.lineLen) {
+            memset(&shadow.line[shadow.lineLen], 0, sizeof(TLog_Shadow_Cell));
+        }
+    }
+}
+
+static void setAttribute(TLog_Attribute attribute) {
+    if (attribute != shadow.attribute) {
+        backend->data->setAttribute(backend, attribute);
+        shadow.attribute = attribute;
+    }
+}
+
+static void beginLine(void) {
+    shadow.lineLen = 0;
+    shadow.lineAttribute = TLOG_ATTRIBUTE_NORMAL;
+}
+
+static bool commitLine(uint32_t row) {
+    TLog_Shadow_Cell* old = &shadow.cells[(size_t) row * shadow.width];
+    TLog_Shadow_Cell* new = shadow.line;
+    uint32_t width = shadow.width;
+
+    /* The line's rest is blank */
+    memset(&new[shadow.lineLen], 0, sizeof(TLog_Shadow_Cell) * (width - shadow.lineLen));
+    if (memcmp(old, new, sizeof(TLog_Shadow_Cell) * width) == 0) {
         return false;
     }
+
+    uint32_t newEnd = shadow.lineLen;
+    for (; newEnd > 0 && new[newEnd - 1].len == 0; --newEnd);
+
+    uint32_t x = 0;
+    while (true) {
+        for (; x < width && memcmp(&old[x], &new[x], sizeof(TLog_Shadow_Cell)) == 0; ++x);
+        if (x == width) {
+            break;
+        }
+
+        /* Wide characters are written whole */
+        if (x > 0 && (old[x].len == CONTINUATION_LEN || new[x].len == CONTINUATION_LEN)) {
+            --x;
+        }
+
+        /* Take in short runs of unchanged cells, as rewriting them is cheaper than moving over them */
+        uint32_t runEnd = x + 1;
+        for (uint32_t i = runEnd, same = 0; i < width && same < MIN_SKIP; ++i) {
+            if (memcmp(&old[i], &new[i], sizeof(TLog_Shadow_Cell)) == 0) {
+                ++same;
+            } else {
+                same = 0;
+                runEnd = i + 1;
+            }
+        }
+
+        for (; runEnd < width && (old[runEnd].len == CONTINUATION_LEN || new[runEnd].len == CONTINUATION_LEN);
+                ++runEnd);
+
+        backend->data->move(backend, row, x);
+        if (runEnd > newEnd) {
+            /* The run reaches into the blank rest, so clear it instead */
+            if (x < newEnd) {
+                writeCells(&new[x], newEnd - x);
+            }
+            setAttribute(TLOG_ATTRIBUTE_NORMAL);
+            backend->data->clearToEol(backend);
+            break;
+        }
+        writeCells(&new[x], runEnd - x);
+        x = runEnd;
+    }
+
+    memcpy(old, new, sizeof(TLog_Shadow_Cell) * width);
     return true;
 }
 
-static bool getPrevFocusableWidget(TLog_Widget** widgets, TLog_Widget** start, TLog_Widget*** prev) {
-    while (1) {
-        if ((*start)->data->setFocus) {
-            *prev = start;
-            return true;
-        } else if (start == widgets) {
-            return false;
+static void writeCells(const TLog_Shadow_Cell* cells, uint32_t count) {
+    char* text = shadow.text;
+    char* end = text;
+    for (uint32_t i = 0; i < count; ++i) {
+        /* The terminal moves past both cells of a wide character */
+        if (cells[i].len == CONTINUATION_LEN) {
+            continue;
+        }
+        if (cells[i].attribute != shadow.attribute) {
+            if (end > text) {
+                backend->data->addText(backend, text, end - text);
+                end = text;
+            }
+            setAttribute(cells[i].attribute);
         }
-        --start;
+        if (cells[i].len > 0) {
+            memcpy(end, cells[i].ch, MAX_CELL_LEN);
+            end += cells[i].len;
+        } else {
+            *end++ = ' ';
+        }
+    }
+    if (end > text) {
+        backend->data->addText(backend, text, end - text);
     }
 }
 
-static void getNextFocusableWidget(TLog_Widget** start, TLog_Widget*** next) {
-    for (*next = start;
-            **next && !(**next)->data->setFocus;
-            ++(*next));
-}
-
-static void scrollUpToWidget(TLog_Widget** widgets, uint32_t screenHeight,
-        TLog_Widget*** currentWidget, uint32_t* currentWidgetY, TLog_Widget** targetWidget) {
-    while (*currentWidget > targetWidget) {
-        --(*currentWidget);
-        uint32_t height = APR_ARRAY_IDX(heights, *currentWidget - widgets, uint32_t);
-
-        if (height > *currentWidgetY) {
-            int todo = height - *currentWidgetY;
-            scrl(-todo);
-            *currentWidgetY = 0;
-            drawLines(**currentWidget, *currentWidgetY, 0, height, screenHeight);
+static void scrollScreen(int lines) {
+    size_t width = shadow.width;
+    size_t height = shadow.height;
+    size_t count = lines < 0 ? (size_t) -lines : (size_t) lines;
+
+    backend->data->scroll(backend, lines);
+
+    if (lines > 0) {
+        memmove(shadow.cells, &shadow.cells[count * width],
+                sizeof(TLog_Shadow_Cell) * (height - count) * width);
+        memset(&shadow.cells[(height - count) * width], 0, sizeof(TLog_Shadow_Cell) * count * width);
+    } else if (lines < 0) {
+        memmove(&shadow.cells[count * width], shadow.cells,
+                sizeof(TLog_Shadow_Cell) * (height - count) * width);
+        memset(shadow.cells, 0, sizeof(TLog_Shadow_Cell) * count * width);
+    }
+}
+
+static void flushFrame(void) {
+    uint64_t start = TLog_Stats_Enabled ? TLog_Stats_Now() : 0;
+    backend->data->flush(backend);
+    uint64_t end = TLog_Stats_Enabled ? TLog_Stats_Now() : 0;
+
+    ++stats.frames;
+    if (backend->data->getBytesWritten) {
+        size_t backendBytes = backend->data->getBytesWritten(backend);
+        stats.lastFrameBytes = backendBytes - stats.backendBytes;
+        stats.totalBytes += stats.lastFrameBytes;
+        stats.backendBytes = backendBytes;
+    }
+
+    if (TLog_Stats_Enabled) {
+        TLog_Stats_AddFrame(end - start, backend->data->getBytesWritten ? stats.lastFrameBytes : 0);
+    }
+}
+
+static void putBatch(TLog_Widget** widget, uint32_t* cursorX, uint32_t* cursorY,
+        uint32_t* dirtyStart, uint32_t* dirtyEnd) {
+    if (batch->nelts == 0) {
+        return;
+    }
+
+    uint32_t start = 0;
+    uint32_t end = 0;
+    if ((*widget)->data->putText) {
+        (*widget)->data->putText(*widget, batch->elts, batch->nelts, cursorX, cursorY, &start, &end);
+        mergeDirty(dirtyStart, dirtyEnd, start, end);
+    } else {
+        for (int i = 0; i < batch->nelts; ++i) {
+            (*widget)->data->putChar(*widget, APR_ARRAY_IDX(batch, i, char), cursorX, cursorY, &start, &end);
+            mergeDirty(dirtyStart, dirtyEnd, start, end);
+        }
+    }
+
+    apr_array_clear(batch);
+}
+
+static void mergeDirty(uint32_t* dirtyStart, uint32_t* dirtyEnd, uint32_t start, uint32_t end) {
+    if (start >= end) {
+        return;
+    } else if (*dirtyStart >= *dirtyEnd) {
+        *dirtyStart = start;
+        *dirtyEnd = end;
+    } else {
+        *dirtyStart = start < *dirtyStart ? start : *dirtyStart;
+        *dirtyEnd = end > *dirtyEnd ? end : *dirtyEnd;
+    }
+}
+
+static bool updateWidgets(void) {
+    bool dirty = false;
+
+    for (int i = 0; i < updaters->nelts; ++i) {
+        TLog_Widget** widget = view.widgets + APR_ARRAY_IDX(updaters, i, int);
+        uint32_t start = 0;
+        uint32_t end = 0;
+        (*widget)->data->update(*widget, &start, &end);
+        if (start < end) {
+            drawLines(widget, getWidgetY(widget), start, end);
+            dirty = true;
+        }
+    }
+
+    return dirty;
+}
+
+static bool layOutInvalidated(void) {
+    if (invalidated->nelts == 0) {
+        return false;
+    }
+
+    bool resized = false;
+    for (int i = 0; i < invalidated->nelts; ++i) {
+        TLog_Widget** iter = lookUpWidget(APR_ARRAY_IDX(invalidated, i, TLog_Widget*));
+        if (!iter) {
+            continue;
+        }
+
+        /* Keep the old height if the widget fails to lay out */
+        uint32_t height = layOut(*iter, view.maxWidth, view.screenHeight);
+        if (height > 0 && height != getHeight(iter)) {
+            setHeight(iter, height);
+            resized = true;
         } else {
-            *currentWidgetY -= height;
+            drawLines(iter, getWidgetY(iter), 0, getHeight(iter));
+        }
+    }
+    apr_array_clear(invalidated);
+
+    if (resized) {
+        /* Rows below moved, so keep the top row and draw the whole screen */
+        uint64_t maxTop = view.height > view.screenHeight ? view.height - view.screenHeight : 0;
+        view.top = view.top < maxTop ? view.top : maxTop;
+        view.topWidget = findWidget(view.top, &view.topWidgetY);
+        drawRows(view.top, view.top + view.screenHeight);
+    }
+
+    return true;
+}
+
+static uint32_t getHeight(TLog_Widget** widget) {
+    return APR_ARRAY_IDX(heights, widget - view.widgets, uint32_t);
+}
+
+static void indexHeights(void) {
+    int count = heights->nelts;
+
+    apr_array_clear(heightIndex);
+    APR_ARRAY_PUSH(heightIndex, uint64_t) = 0;
+    for (int i = 0; i < count; ++i) {
+        APR_ARRAY_PUSH(heightIndex, uint64_t) = APR_ARRAY_IDX(heights, i, uint32_t);
+    }
+
+    /* Add each node to its parent, which covers it and the nodes before */
+    uint64_t* sums = (uint64_t*) heightIndex->elts;
+    for (int i = 1; i <= count; ++i) {
+        int parent = i + (i & -i);
+        if (parent <= count) {
+            sums[parent] += sums[i];
+        }
+    }
+}
+
+static void setHeight(TLog_Widget** widget, uint32_t height) {
+    int index = widget - view.widgets;
+    uint64_t delta = (uint64_t) height - APR_ARRAY_IDX(heights, index, uint32_t);
+
+    /* Sums wrap around like the delta, so they come out right when it's negative */
+    APR_ARRAY_IDX(heights, index, uint32_t) = height;
+    uint64_t* sums = (uint64_t*) heightIndex->elts;
+    for (int i = index + 1; i < heightIndex->nelts; i += i & -i) {
+        sums[i] += delta;
+    }
+    view.height += delta;
+}
+
+static uint64_t getWidgetY(TLog_Widget** widget) {
+    const uint64_t* sums = (const uint64_t*) heightIndex->elts;
+    uint64_t widgetY = 0;
+    for (size_t i = widget - view.widgets; i > 0; i &= i - 1) {
+        widgetY += sums[i];
+    }
+    return widgetY;
+}
+
+static TLog_Widget** findWidget(uint64_t row, uint64_t* widgetY) {
+    const uint64_t* sums = (const uint64_t*) heightIndex->elts;
+    size_t count = heights->nelts;
+    size_t step = 1;
+    while (step * 2 <= count) {
+        step *= 2;
+    }
+
+    /* Descend the tree, counting the widgets ending at or above the row */
+    size_t index = 0;
+    uint64_t y = 0;
+    for (; step > 0; step /= 2) {
+        if (index + step <= count && y + sums[index + step] <= row) {
+            index += step;
+            y += sums[index];
+        }
+    }
+
+    *widgetY = y;
+    return view.widgets + index;
+}
+
+static TLog_Widget** getFocusableOnScreen(bool first, uint64_t* widgetY) {
+    uint64_t screenEnd = view.top + view.screenHeight < view.height ? view.top + view.screenHeight : view.height;
+    TLog_Widget** widget;
+    uint64_t y;
+
+    if (view.top >= screenEnd) {
+        return NULL;
+    }
+
+    if (first) {
+        widget = findWidget(view.top, &y);
+        getNextFocusableWidget(y < view.top ? widget + 1 : widget, &widget);
+        if (!widget) {
+            return NULL;
+        }
+    } else if (!getPrevFocusableWidget(findWidget(screenEnd - 1, &y), &widget)) {
+        return NULL;
+    }
+
+    y = getWidgetY(widget);
+    if (y < view.top || y >= screenEnd) {
+        return NULL;
+    }
+
+    *widgetY = y;
+    return widget;
+}
+
+static void indexFocusables(void) {
+    int count = heights->nelts;
+
+    apr_array_clear(prevFocusables);
+    int prev = -1;
+    for (int i = 0; i < count; ++i) {
+        if (view.widgets[i]->data->setFocus) {
+            prev = i;
         }
+        APR_ARRAY_PUSH(prevFocusables, int) = prev;
+    }
+
+    /* Fill the next focusables backwards, starting at the terminating NULL */
+    apr_array_clear(nextFocusables);
+    for (int i = 0; i <= count; ++i) {
+        APR_ARRAY_PUSH(nextFocusables, int) = -1;
+    }
+    int* nexts = (int*) nextFocusables->elts;
+    for (int i = count - 1; i >= 0; --i) {
+        nexts[i] = view.widgets[i]->data->setFocus ? i : nexts[i + 1];
     }
 }
 
-static void scrollDownToWidget(TLog_Widget** widgets, uint32_t screenHeight,
-        TLog_Widget*** currentWidget, uint32_t* currentWidgetY, TLog_Widget** targetWidget) {
-    while (targetWidget > *currentWidget) {
-        *currentWidgetY += APR_ARRAY_IDX(heights, *currentWidget - widgets, uint32_t);
-        ++(*currentWidget);
-        uint32_t height = APR_ARRAY_IDX(heights, *currentWidget - widgets, uint32_t);
+static void indexWidgets(void) {
+    apr_array_clear(widgetIndex);
+    for (size_t i = 0; i <= widgetIndexMask; ++i) {
+        APR_ARRAY_PUSH(widgetIndex, int) = -1;
+    }
 
-        if (*currentWidgetY + height > screenHeight) {
-            uint32_t todo = *currentWidgetY + height - screenHeight;
-            scrl(todo);
-            *currentWidgetY = screenHeight - height;
-            drawLines(**currentWidget, *currentWidgetY, 0, height, screenHeight);
+    /* A widget run twice is found at its first place, like a search from the top would */
+    int* indices = (int*) widgetIndex->elts;
+    for (int i = 0; i < heights->nelts; ++i) {
+        size_t slot = hashWidget(view.widgets[i]);
+        while (indices[slot] >= 0 && view.widgets[indices[slot]] != view.widgets[i]) {
+            slot = (slot + 1) & widgetIndexMask;
+        }
+        if (indices[slot] < 0) {
+            indices[slot] = i;
         }
     }
 }
+
+static TLog_Widget** lookUpWidget(TLog_Widget* widget) {
+    const int* indices = (const int*) widgetIndex->elts;
+
+    for (size_t slot = hashWidget(widget); indices[slot] >= 0; slot = (slot + 1) & widgetIndexMask) {
+        if (view.widgets[indices[slot]] == widget) {
+            return view.widgets + indices[slot];
+        }
+    }
+
+    return NULL;
+}
+
+static size_t hashWidget(TLog_Widget* widget) {
+    /* Multiplying by 2^64 divided by the golden ratio spreads the addresses' low bits to the upper ones */
+    uint64_t hash = (uint64_t) (uintptr_t) widget * UINT64_C(0x9e3779b97f4a7c15);
+    return (size_t) (hash >> 32) & widgetIndexMask;
+}
+
+static void drawLines(TLog_Widget** widget, uint64_t widgetY, uint32_t fromY, uint32_t toY) {
+    /* Clip to screen */
+    uint64_t screenEnd = view.top + view.screenHeight;
+    if (widgetY + fromY < view.top) {
+        fromY = view.top - widgetY < toY ? view.top - widgetY : toY;
+    }
+    if (widgetY + toY > screenEnd) {
+        toY = screenEnd > widgetY + fromY ? screenEnd - widgetY : fromY;
+    }
+
+    for (uint32_t y = fromY; y < toY; ++y) {
+        beginLine();
+        (*widget)->data->drawLine(*widget, y);
+        bool written = commitLine(widgetY + y - view.top);
+        if (TLog_Stats_Enabled) {
+            TLog_Stats_AddLine(written);
+        }
+    }
+}
+
+static void drawRows(uint64_t fromRow, uint64_t toRow) {
+    uint64_t screenEnd = view.top + view.screenHeight;
+    fromRow = fromRow > view.top ? fromRow : view.top;
+    toRow = toRow < screenEnd ? toRow : screenEnd;
+
+    /* Start at the widget holding the screen's top and skip to the first row */
+    TLog_Widget** widget = view.topWidget;
+    uint64_t widgetY = view.topWidgetY;
+    for (; *widget && widgetY + getHeight(widget) <= fromRow; ++widget) {
+        widgetY += getHeight(widget);
+    }
+
+    for (; *widget && widgetY < toRow; widgetY += getHeight(widget), ++widget) {
+        uint32_t fromY = fromRow > widgetY ? fromRow - widgetY : 0;
+        uint32_t toY = toRow - widgetY < getHeight(widget) ? toRow - widgetY : getHeight(widget);
+        drawLines(widget, widgetY, fromY, toY);
+    }
+
+    for (uint64_t row = widgetY > fromRow ? widgetY : fromRow; row < toRow; ++row) {
+        beginLine();
+        commitLine(row - view.top);
+    }
+}
+
+static void scrollTo(uint64_t top) {
+    uint64_t maxTop = view.height > view.screenHeight ? view.height - view.screenHeight : 0;
+    top = top < maxTop ? top : maxTop;
+    if (top == view.top) {
+        return;
+    }
+
+    uint64_t oldTop = view.top;
+    uint64_t distance = top > oldTop ? top - oldTop : oldTop - top;
+
+    view.top = top;
+    view.topWidget = findWidget(top, &view.topWidgetY);
+
+    if (distance >= view.screenHeight) {
+        /* Nothing on screen stays in place, but rows may happen to look alike */
+        drawRows(top, top + view.screenHeight);
+    } else if (top > oldTop) {
+        scrollScreen(distance);
+        drawRows(oldTop + view.screenHeight, top + view.screenHeight);
+    } else {
+        scrollScreen(-(int) distance);
+        drawRows(top, oldTop);
+    }
+}
+
+static void reveal(uint64_t fromRow, uint64_t toRow) {
+    if (toRow - fromRow > view.screenHeight) {
+        toRow = fromRow + view.screenHeight;
+    }
+
+    if (fromRow < view.top) {
+        scrollTo(fromRow);
+    } else if (toRow > view.top + view.screenHeight) {
+        scrollTo(toRow - view.screenHeight);
+    }
+}
+
+static void revealFocus(TLog_Widget** widget, uint64_t widgetY, uint32_t cursorY) {
+    uint32_t height = getHeight(widget);
+    if (height <= view.screenHeight) {
+        reveal(widgetY, widgetY + height);
+    } else {
+        reveal(widgetY + cursorY, widgetY + cursorY + 1);
+    }
+}
+
+static void placeCursor(uint64_t widgetY, uint32_t cursorX, uint32_t cursorY) {
+    uint64_t row = widgetY + cursorY;
+    if (row < view.top) {
+        backend->data->move(backend, 0, cursorX);
+    } else if (row >= view.top + view.screenHeight) {
+        backend->data->move(backend, view.screenHeight - 1, cursorX);
+    } else {
+        backend->data->move(backend, row - view.top, cursorX);
+    }
+}
+
+static bool getPrevFocusableWidget(TLog_Widget** start, TLog_Widget*** prev) {
+    int index = APR_ARRAY_IDX(prevFocusables, start - view.widgets, int);
+    if (index < 0) {
+        return false;
+    }
+    *prev = view.widgets + index;
+    return true;
+}
+
+static void getNextFocusableWidget(TLog_Widget** start, TLog_Widget*** next) {
+    int index = APR_ARRAY_IDX(nextFocusables, start - view.widgets, int);
+    *next = index < 0 ? NULL : view.widgets + index;
+}
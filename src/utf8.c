@@ -1,5 +1,94 @@
 #include "utf8.h"
 
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+/** @brief Defined if SSE2/AVX2 kernels are built (and chosen at runtime). */
+#define TLOG_UTF8_X86
+#include <immintrin.h>
+#endif
+
+#include "utf8_width.h"
+
+/** @brief TRUE if a byte starts a character, or FALSE if it continues one. */
+#define IS_LEAD(b) (((b) & 0xc0) != 0x80)
+
+/** @brief TRUE if a byte is a printable ASCII character. */
+#define IS_PRINTABLE(b) ((unsigned char) (b) - 0x20u < 0x5fu)
+
+/** @brief A 64 bit word with every byte set to b. */
+#define BYTES(b) (0x0101010101010101ull * (b))
+
+/**
+ * @brief Validates a single character.
+ * 
+ * @param ch The character's first byte
+ * @param end The byte after the last byte of the range
+ * @return The next character, or NULL if the character is malformed
+ */
+static const char* validateChar(const char* ch, const char* end);
+
+/**
+ * @brief Returns how many columns a character takes, see @ref TLog_UTF8_CharWidth().
+ * 
+ * @param ch The character's first byte
+ * @param end The byte after the last byte of the range
+ * @param next Where to store the next character's first byte
+ * @return Number of columns
+ */
+static inline size_t charWidth(const char* ch, const char* end, const char** next);
+
+/**
+ * @brief Checks 8 bytes for being printable ASCII characters.
+ * 
+ * @param ch First byte
+ * @return TRUE if all bytes are printable ASCII, or FALSE else
+ */
+static inline bool isPrintableWord(const char* ch);
+
+/**
+ * @brief Looks up a codepoint's width in @ref WIDTH_BLOCKS.
+ * 
+ * @param codepoint The codepoint
+ * @return Number of columns
+ */
+static inline size_t codepointWidth(uint32_t codepoint);
+
+/**
+ * @brief Finds the end of a run of printable ASCII characters, which take a column each.
+ * 
+ * @param start First byte of the range
+ * @param end The byte after the last byte of the range
+ * @return The first byte that isn't printable ASCII, or end
+ */
+static const char* asciiRun(const char* start, const char* end);
+
+static size_t countScalar(const char* start, const char* end);
+static const char* seekScalar(const char* start, const char* end, size_t n);
+static const char* findNewlineScalar(const char* start, const char* end, size_t* count);
+static bool validateScalar(const char* start, const char* end);
+static const char* asciiRunScalar(const char* start, const char* end);
+
+#ifdef TLOG_UTF8_X86
+static size_t countSSE2(const char* start, const char* end);
+static const char* seekSSE2(const char* start, const char* end, size_t n);
+static const char* findNewlineSSE2(const char* start, const char* end, size_t* count);
+static bool validateSSE2(const char* start, const char* end);
+static const char* asciiRunSSE2(const char* start, const char* end);
+
+static size_t countAVX2(const char* start, const char* end);
+static const char* seekAVX2(const char* start, const char* end, size_t n);
+static const char* findNewlineAVX2(const char* start, const char* end, size_t* count);
+static bool validateAVX2(const char* start, const char* end);
+static const char* asciiRunAVX2(const char* start, const char* end);
+
+/** @brief TRUE if the CPU runs the AVX2 kernels. */
+#define HAS_AVX2() (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt"))
+/** @brief TRUE if the CPU runs the SSE2 kernels. */
+#define HAS_SSE2() (__builtin_cpu_supports("sse2"))
+#endif
+
 char* TLog_UTF8_PrevChar(char* ch) {
     // The two most significant bits of a non-character-start-byte in UTF-8 are 10
     do {
@@ -21,3 +110,544 @@ char* TLog_UTF8_NextChar(char* ch) {
 size_t TLog_UTF8_CharLen(char* ch) {
     return TLog_UTF8_NextChar(ch) - ch;
 }
+
+size_t TLog_UTF8_Count(const char* start, const char* end) {
+#ifdef TLOG_UTF8_X86
+    if (HAS_AVX2()) {
+        return countAVX2(start, end);
+    } else if (HAS_SSE2()) {
+        return countSSE2(start, end);
+    }
+#endif
+    return countScalar(start, end);
+}
+
+const char* TLog_UTF8_Seek(const char* start, const char* end, size_t n) {
+#ifdef TLOG_UTF8_X86
+    if (HAS_AVX2()) {
+        return seekAVX2(start, end, n);
+    } else if (HAS_SSE2()) {
+        return seekSSE2(start, end, n);
+    }
+#endif
+    return seekScalar(start, end, n);
+}
+
+const char* TLog_UTF8_FindNewline(const char* start, const char* end, size_t* count) {
+#ifdef TLOG_UTF8_X86
+    if (HAS_AVX2()) {
+        return findNewlineAVX2(start, end, count);
+    } else if (HAS_SSE2()) {
+        return findNewlineSSE2(start, end, count);
+    }
+#endif
+    return findNewlineScalar(start, end, count);
+}
+
+bool TLog_UTF8_Validate(const char* start, const char* end) {
+#ifdef TLOG_UTF8_X86
+    if (HAS_AVX2()) {
+        return validateAVX2(start, end);
+    } else if (HAS_SSE2()) {
+        return validateSSE2(start, end);
+    }
+#endif
+    return validateScalar(start, end);
+}
+
+size_t TLog_UTF8_CharWidth(const char* ch, const char* end, const char** next) {
+    return charWidth(ch, end, next);
+}
+
+size_t TLog_UTF8_Width(const char* start, const char* end) {
+    size_t width = 0;
+    const char* ch = start;
+
+    while (ch < end) {
+        /* Take runs of printable ASCII at once, but only long ones, as guessing wrong is expensive */
+        if (end - ch >= 8 && isPrintableWord(ch)) {
+            const char* run = asciiRun(ch, end);
+            width += run - ch;
+            ch = run;
+        } else {
+            const char* next;
+            width += charWidth(ch, end, &next);
+            ch = next;
+        }
+    }
+
+    return width;
+}
+
+const char* TLog_UTF8_SkipASCII(const char* start, const char* end) {
+    return asciiRun(start, end);
+}
+
+const char* TLog_UTF8_SeekWidth(const char* start, const char* end, size_t width, size_t* taken) {
+    size_t columns = 0;
+    const char* ch = start;
+
+    while (ch < end) {
+        if (end - ch >= 8 && isPrintableWord(ch)) {
+            const char* run = asciiRun(ch, (size_t) (end - ch) > width - columns ? ch + (width - columns) : end);
+            columns += run - ch;
+            ch = run;
+            if (columns == width) {
+                /* Only zero width characters may follow */
+                if (ch == end || IS_PRINTABLE(*ch)) {
+                    break;
+                }
+            }
+            continue;
+        }
+
+        const char* next;
+        size_t charColumns = charWidth(ch, end, &next);
+        if (columns + charColumns > width) {
+            break;
+        }
+        columns += charColumns;
+        ch = next;
+    }
+
+    if (taken) {
+        *taken = columns;
+    }
+    return ch;
+}
+
+const char* TLog_UTF8_SeekWidthBackward(const char* start, const char* end, size_t width, size_t* taken) {
+    size_t columns = 0;
+    const char* ch = end;
+    const char* fit = end;
+
+    /* Text fields mostly hold ASCII, which fits byte by byte */
+    size_t ascii = (size_t) (end - start) < width ? (size_t) (end - start) : width;
+    if (asciiRun(end - ascii, end) == end) {
+        columns = ascii;
+        ch = fit = end - ascii;
+    }
+
+    while (ch > start) {
+        const char* prev = ch - 1;
+        while (prev > start && !IS_LEAD(*prev)) {
+            --prev;
+        }
+
+        const char* next;
+        size_t charColumns = charWidth(prev, end, &next);
+        if (columns + charColumns > width) {
+            break;
+        }
+        columns += charColumns;
+        ch = prev;
+
+        /* Zero width characters only fit together with the character they follow */
+        if (charColumns > 0 || ch == start) {
+            fit = ch;
+        }
+    }
+
+    if (taken) {
+        *taken = columns;
+    }
+    return fit;
+}
+
+static inline size_t charWidth(const char* ch, const char* end, const char** next) {
+    /* Lengths by a lead byte's upper 4 bits, and by length the lead byte's codepoint bits and excess bits */
+    static const uint8_t LENGTHS[16] = { 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 2, 2, 3, 4 };
+    static const uint8_t MASKS[5] = { 0, 0x7f, 0x1f, 0x0f, 0x07 };
+    static const uint8_t EXCESS[5] = { 0, 18, 12, 6, 0 };
+
+    const unsigned char* b = (const unsigned char*) ch;
+    size_t len = LENGTHS[b[0] >> 4];
+    uint32_t codepoint;
+
+    if ((size_t) (end - ch) >= 4) {
+        /* Decode 4 bytes and drop the excess, as branching by length would be mispredicted in mixed text */
+        codepoint = (uint32_t) (b[0] & MASKS[len]) << 18 | (uint32_t) (b[1] & 0x3f) << 12
+                | (uint32_t) (b[2] & 0x3f) << 6 | (uint32_t) (b[3] & 0x3f);
+        codepoint >>= EXCESS[len];
+    } else if ((size_t) (end - ch) >= len) {
+        codepoint = b[0] & MASKS[len];
+        for (size_t i = 1; i < len; ++i) {
+            codepoint = codepoint << 6 | (b[i] & 0x3f);
+        }
+    } else {
+        /* Cut off, show a replacement character */
+        *next = end;
+        return 1;
+    }
+
+    *next = ch + len;
+    return codepointWidth(codepoint);
+}
+
+static inline bool isPrintableWord(const char* ch) {
+    uint64_t w;
+    memcpy(&w, ch, sizeof(w));
+
+    /* Look for bytes of 0x80 and above, below 0x20 or equal to 0x7f */
+    uint64_t del = w ^ BYTES(0x7f);
+    return !((w | ((w - BYTES(0x20)) & ~w) | ((del - BYTES(0x01)) & ~del)) & BYTES(0x80));
+}
+
+static inline size_t codepointWidth(uint32_t codepoint) {
+    if (codepoint > 0x10ffff) {
+        return 1;
+    }
+    uint8_t bits = WIDTH_BLOCKS[WIDTH_INDEX[codepoint >> 8]][(codepoint & 0xff) >> 2];
+    return (bits >> ((codepoint & 3) * 2)) & 3;
+}
+
+static const char* asciiRun(const char* start, const char* end) {
+#ifdef TLOG_UTF8_X86
+    if (HAS_AVX2()) {
+        return asciiRunAVX2(start, end);
+    } else if (HAS_SSE2()) {
+        return asciiRunSSE2(start, end);
+    }
+#endif
+    return asciiRunScalar(start, end);
+}
+
+static const char* validateChar(const char* ch, const char* end) {
+    const unsigned char* b = (const unsigned char*) ch;
+    unsigned char low = 0x80;
+    unsigned char high = 0xbf;
+    size_t len;
+
+    if (b[0] < 0x80) {
+        return ch + 1;
+    } else if (b[0] < 0xc2) {
+        /* Stray continuation byte or overlong two byte sequence */
+        return NULL;
+    } else if (b[0] < 0xe0) {
+        len = 2;
+    } else if (b[0] < 0xf0) {
+        len = 3;
+        if (b[0] == 0xe0) {
+            low = 0xa0; /* Overlong */
+        } else if (b[0] == 0xed) {
+            high = 0x9f; /* Surrogates */
+        }
+    } else if (b[0] < 0xf5) {
+        len = 4;
+        if (b[0] == 0xf0) {
+            low = 0x90; /* Overlong */
+        } else if (b[0] == 0xf4) {
+            high = 0x8f; /* Beyond U+10FFFF */
+        }
+    } else {
+        return NULL;
+    }
+
+    if ((size_t) (end - ch) < len || b[1] < low || b[1] > high) {
+        return NULL;
+    }
+    for (size_t i = 2; i < len; ++i) {
+        if (IS_LEAD(b[i])) {
+            return NULL;
+        }
+    }
+
+    return ch + len;
+}
+
+/************** Scalar **************/
+
+static size_t countScalar(const char* start, const char* end) {
+    size_t count = 0;
+    for (const char* ch = start; ch < end; ++ch) {
+        count += IS_LEAD(*ch);
+    }
+    return count;
+}
+
+static const char* seekScalar(const char* start, const char* end, size_t n) {
+    for (const char* ch = start; ch < end; ++ch) {
+        if (IS_LEAD(*ch)) {
+            if (n == 0) {
+                return ch;
+            }
+            --n;
+        }
+    }
+    return end;
+}
+
+static const char* findNewlineScalar(const char* start, const char* end, size_t* count) {
+    const char* ch;
+    for (ch = start, *count = 0; ch < end && *ch != '\n'; ++ch) {
+        *count += IS_LEAD(*ch);
+    }
+    return ch;
+}
+
+static bool validateScalar(const char* start, const char* end) {
+    const char* ch = start;
+    while (ch < end) {
+        ch = validateChar(ch, end);
+        if (!ch) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static const char* asciiRunScalar(const char* start, const char* end) {
+    const char* ch = start;
+
+    for (; end - ch >= 8 && isPrintableWord(ch); ch += 8);
+
+    while (ch < end && IS_PRINTABLE(*ch)) {
+        ++ch;
+    }
+    return ch;
+}
+
+#ifdef TLOG_UTF8_X86
+
+/*
+ * A byte starts a character if it is ASCII or 0xc0 and above. Interpreted as signed
+ * that is every byte greater than (signed) 0xbf, i.e. -65.
+ */
+
+/************** SSE2 **************/
+
+__attribute__((target("sse2")))
+static size_t countSSE2(const char* start, const char* end) {
+    const __m128i limit = _mm_set1_epi8(-65);
+    const __m128i zero = _mm_setzero_si128();
+    size_t count = 0;
+    const char* ch = start;
+
+    while (end - ch >= 16) {
+        /* Byte counters overflow after 255 blocks */
+        size_t blocks = (end - ch) / 16;
+        blocks = blocks > 255 ? 255 : blocks;
+
+        __m128i acc = zero;
+        for (size_t i = 0; i < blocks; ++i, ch += 16) {
+            __m128i v = _mm_loadu_si128((const __m128i*) ch);
+            acc = _mm_sub_epi8(acc, _mm_cmpgt_epi8(v, limit));
+        }
+
+        __m128i sums = _mm_sad_epu8(acc, zero);
+        count += (size_t) _mm_cvtsi128_si32(sums) + (size_t) _mm_extract_epi16(sums, 4);
+    }
+
+    return count + countScalar(ch, end);
+}
+
+__attribute__((target("sse2")))
+static const char* seekSSE2(const char* start, const char* end, size_t n) {
+    const __m128i limit = _mm_set1_epi8(-65);
+    const char* ch;
+
+    for (ch = start; end - ch >= 16; ch += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*) ch);
+        unsigned int leads = _mm_movemask_epi8(_mm_cmpgt_epi8(v, limit));
+        size_t blockCount = __builtin_popcount(leads);
+        if (blockCount > n) {
+            for (; n > 0; --n) {
+                leads &= leads - 1;
+            }
+            return ch + __builtin_ctz(leads);
+        }
+        n -= blockCount;
+    }
+
+    return seekScalar(ch, end, n);
+}
+
+__attribute__((target("sse2")))
+static const char* findNewlineSSE2(const char* start, const char* end, size_t* count) {
+    const __m128i limit = _mm_set1_epi8(-65);
+    const __m128i newline = _mm_set1_epi8('\n');
+    const char* ch;
+    size_t tailCount;
+
+    for (ch = start, *count = 0; end - ch >= 16; ch += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*) ch);
+        unsigned int leads = _mm_movemask_epi8(_mm_cmpgt_epi8(v, limit));
+        unsigned int newlines = _mm_movemask_epi8(_mm_cmpeq_epi8(v, newline));
+        if (newlines) {
+            unsigned int index = __builtin_ctz(newlines);
+            *count += __builtin_popcount(leads & ((1u << index) - 1));
+            return ch + index;
+        }
+        *count += __builtin_popcount(leads);
+    }
+
+    ch = findNewlineScalar(ch, end, &tailCount);
+    *count += tailCount;
+    return ch;
+}
+
+__attribute__((target("sse2")))
+static bool validateSSE2(const char* start, const char* end) {
+    const char* ch = start;
+
+    while (ch < end) {
+        /* Skip ASCII blocks */
+        if (end - ch >= 16) {
+            __m128i v = _mm_loadu_si128((const __m128i*) ch);
+            unsigned int high = _mm_movemask_epi8(v);
+            if (!high) {
+                ch += 16;
+                continue;
+            }
+            ch += __builtin_ctz(high);
+        }
+
+        /* Validate the following run of non-ASCII characters */
+        do {
+            ch = validateChar(ch, end);
+            if (!ch) {
+                return false;
+            }
+        } while (ch < end && (*ch & 0x80));
+    }
+
+    return true;
+}
+
+__attribute__((target("sse2")))
+static const char* asciiRunSSE2(const char* start, const char* end) {
+    const __m128i control = _mm_set1_epi8(0x1f);
+    const __m128i del = _mm_set1_epi8(0x7f);
+    const char* ch;
+
+    /* Bytes of 0x80 and above are negative and fail the signed comparison */
+    for (ch = start; end - ch >= 16; ch += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*) ch);
+        unsigned int printable = _mm_movemask_epi8(_mm_andnot_si128(_mm_cmpeq_epi8(v, del), _mm_cmpgt_epi8(v, control)));
+        if (printable != 0xffff) {
+            return ch + __builtin_ctz(~printable);
+        }
+    }
+
+    return asciiRunScalar(ch, end);
+}
+
+/************** AVX2 **************/
+
+__attribute__((target("avx2")))
+static size_t countAVX2(const char* start, const char* end) {
+    const __m256i limit = _mm256_set1_epi8(-65);
+    const __m256i zero = _mm256_setzero_si256();
+    size_t count = 0;
+    const char* ch = start;
+
+    while (end - ch >= 32) {
+        /* Byte counters overflow after 255 blocks */
+        size_t blocks = (end - ch) / 32;
+        blocks = blocks > 255 ? 255 : blocks;
+
+        __m256i acc = zero;
+        for (size_t i = 0; i < blocks; ++i, ch += 32) {
+            __m256i v = _mm256_loadu_si256((const __m256i*) ch);
+            acc = _mm256_sub_epi8(acc, _mm256_cmpgt_epi8(v, limit));
+        }
+
+        uint64_t sums[4];
+        _mm256_storeu_si256((__m256i*) sums, _mm256_sad_epu8(acc, zero));
+        count += sums[0] + sums[1] + sums[2] + sums[3];
+    }
+
+    return count + countScalar(ch, end);
+}
+
+__attribute__((target("avx2,popcnt")))
+static const char* seekAVX2(const char* start, const char* end, size_t n) {
+    const __m256i limit = _mm256_set1_epi8(-65);
+    const char* ch;
+
+    for (ch = start; end - ch >= 32; ch += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i*) ch);
+        unsigned int leads = _mm256_movemask_epi8(_mm256_cmpgt_epi8(v, limit));
+        size_t blockCount = __builtin_popcount(leads);
+        if (blockCount > n) {
+            for (; n > 0; --n) {
+                leads &= leads - 1;
+            }
+            return ch + __builtin_ctz(leads);
+        }
+        n -= blockCount;
+    }
+
+    return seekScalar(ch, end, n);
+}
+
+__attribute__((target("avx2,popcnt")))
+static const char* findNewlineAVX2(const char* start, const char* end, size_t* count) {
+    const __m256i limit = _mm256_set1_epi8(-65);
+    const __m256i newline = _mm256_set1_epi8('\n');
+    const char* ch;
+    size_t tailCount;
+
+    for (ch = start, *count = 0; end - ch >= 32; ch += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i*) ch);
+        unsigned int leads = _mm256_movemask_epi8(_mm256_cmpgt_epi8(v, limit));
+        unsigned int newlines = _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, newline));
+        if (newlines) {
+            unsigned int index = __builtin_ctz(newlines);
+            *count += __builtin_popcount(leads & ((1u << index) - 1));
+            return ch + index;
+        }
+        *count += __builtin_popcount(leads);
+    }
+
+    ch = findNewlineScalar(ch, end, &tailCount);
+    *count += tailCount;
+    return ch;
+}
+
+__attribute__((target("avx2")))
+static bool validateAVX2(const char* start, const char* end) {
+    const char* ch = start;
+
+    while (ch < end) {
+        /* Skip ASCII blocks */
+        if (end - ch >= 32) {
+            __m256i v = _mm256_loadu_si256((const __m256i*) ch);
+            unsigned int high = _mm256_movemask_epi8(v);
+            if (!high) {
+                ch += 32;
+                continue;
+            }
+            ch += __builtin_ctz(high);
+        }
+
+        /* Validate the following run of non-ASCII characters */
+        do {
+            ch = validateChar(ch, end);
+            if (!ch) {
+                return false;
+            }
+        } while (ch < end && (*ch & 0x80));
+    }
+
+    return true;
+}
+
+__attribute__((target("avx2")))
+static const char* asciiRunAVX2(const char* start, const char* end) {
+    const __m256i control = _mm256_set1_epi8(0x1f);
+    const __m256i del = _mm256_set1_epi8(0x7f);
+    const char* ch;
+
+    for (ch = start; end - ch >= 32; ch += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i*) ch);
+        unsigned int printable = _mm256_movemask_epi8(_mm256_andnot_si256(_mm256_cmpeq_epi8(v, del), _mm256_cmpgt_epi8(v, control)));
+        if (printable != 0xffffffffu) {
+            return ch + __builtin_ctz(~printable);
+        }
+    }
+
+    return asciiRunScalar(ch, end);
+}
+
+#endif
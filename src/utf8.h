@@ -8,6 +8,7 @@
 #define TLOG_SRC_UTF8_H
 
 #include <stdlib.h>
+#include <stdbool.h>
 
 // TODO Document
 char* TLog_UTF8_PrevChar(char* ch);
@@ -18,4 +19,100 @@ char* TLog_UTF8_NextChar(char* ch);
 // TODO Document
 size_t TLog_UTF8_CharLen(char* ch);
 
+/**
+ * @brief Counts the codepoints in a range.
+ * 
+ * @param start First byte of the range
+ * @param end The byte after the last byte of the range
+ * @return Number of codepoints in the range
+ */
+size_t TLog_UTF8_Count(const char* start, const char* end);
+
+/**
+ * @brief Finds a codepoint in a range.
+ * 
+ * @param start First byte of the range
+ * @param end The byte after the last byte of the range
+ * @param n Index of the codepoint to find
+ * @return The codepoint's first byte, or end if the range holds n codepoints or less
+ */
+const char* TLog_UTF8_Seek(const char* start, const char* end, size_t n);
+
+/**
+ * @brief Finds the next newline in a range.
+ * 
+ * @param start First byte of the range
+ * @param end The byte after the last byte of the range
+ * @param count Where to store the number of codepoints before the newline
+ * @return The newline, or end if the range holds none
+ */
+const char* TLog_UTF8_FindNewline(const char* start, const char* end, size_t* count);
+
+/**
+ * @brief Returns how many columns a character takes on a terminal.
+ * 
+ * East Asian wide and fullwidth characters take 2 columns, combining marks, other
+ * zero width characters and control characters (including newlines) take none,
+ * and everything else takes 1.
+ * 
+ * @param ch The character's first byte
+ * @param end The byte after the last byte of the range
+ * @param next Where to store the next character's first byte
+ * @return Number of columns
+ */
+size_t TLog_UTF8_CharWidth(const char* ch, const char* end, const char** next);
+
+/**
+ * @brief Counts the columns a range takes on a terminal.
+ * 
+ * @param start First byte of the range
+ * @param end The byte after the last byte of the range
+ * @return Number of columns
+ */
+size_t TLog_UTF8_Width(const char* start, const char* end);
+
+/**
+ * @brief Skips printable ASCII characters, which take a column each.
+ * 
+ * @param start First byte of the range
+ * @param end The byte after the last byte of the range
+ * @return The first byte that isn't a printable ASCII character, or end
+ */
+const char* TLog_UTF8_SkipASCII(const char* start, const char* end);
+
+/**
+ * @brief Finds the end of the longest start of a range that fits some columns.
+ * 
+ * Zero width characters following the last fitting character are included.
+ * 
+ * @param start First byte of the range
+ * @param end The byte after the last byte of the range
+ * @param width Number of columns
+ * @param taken Where to store the number of columns taken, or NULL
+ * @return The first character that doesn't fit, or end if the whole range fits
+ */
+const char* TLog_UTF8_SeekWidth(const char* start, const char* end, size_t width, size_t* taken);
+
+/**
+ * @brief Finds the start of the longest end of a range that fits some columns.
+ * 
+ * Zero width characters whose preceding character doesn't fit are excluded.
+ * 
+ * @param start First byte of the range
+ * @param end The byte after the last byte of the range
+ * @param width Number of columns
+ * @param taken Where to store the number of columns taken, or NULL
+ * @return The first fitting character, or end if none fits
+ */
+const char* TLog_UTF8_SeekWidthBackward(const char* start, const char* end, size_t width, size_t* taken);
+
+/**
+ * @brief Checks a range for being well-formed UTF-8.
+ * 
+ * @param start First byte of the range
+ * @param end The byte after the last byte of the range
+ * @return TRUE if the range is well-formed, or FALSE else
+ */
+bool TLog_UTF8_Validate(const char* start, const char* end);
+
 #endif